@@ -31,14 +31,24 @@
 #include "cmd/main.hpp"
 #include "img/image.hpp"
 #include "io/filestream.hpp"
+#include "io/mappedstream.hpp"
 #include "img/component.hpp"
 #include "std/stdio.hpp"
 #include "std/stdarg.hpp"
 #include "std/stdlib.hpp"
+#include "std/string.hpp"
+#include "std/errno.hpp"
 #include "ctrafo/colortransformer.hpp"
+#include "ctrafo/colortables.hpp"
 #include "global/exceptions.hpp"
 #include "ssim/ssimIndex.hpp"
+#include "ssim/ssimStream.hpp"
 #include "vif/vifIndex.hpp"
+#include "moments/recursivemoments.hpp"
+#include "global/cpu.hpp"
+#include "global/threadpool.hpp"
+#include "wavelet/lineslab.hpp"
+#include "wavelet/bandarena.hpp"
 #include <math.h>
 ///
 
@@ -78,8 +88,12 @@ struct Settings {
   char *m_pcInputName_1;
   
 
-  // The second input file name. This should be a ppm/pgm file. 
-  char *m_pcInputName_2;
+  // The second input file names. These should be ppm/pgm files. If more than
+  // one is given, all are compared against the first one.
+  char **m_ppcInputNames_2;
+  //
+  // The number of second input files.
+  int   m_iCandidates;
   
   // The number of CPUs to run in parallel
   int  ncpus;
@@ -108,23 +122,68 @@ struct Settings {
   //
   // Masking exponent if any. Default would be a masking exponent of 2.
   double m_dMasking;
+  //
+  // The manifest of image pairs for the batch mode, "-" for stdin.
+  char *m_pcBatch;
+  //
+  // Write the batch results as JSON lines instead of CSV?
+  bool json;
+  //
+  // Stream the scales into the SSIM computation instead of keeping them?
+  bool stream;
+  //
+  // Reduce color images to their luma while reading them?
+  bool luma;
+  //
+  // The color space color images are compared in.
+  ColorTransformer::ColorSpace space;
+  //
+  // The size of the SSIM window, and the standard deviation of the gaussian.
+  ULONG window;
+  double sigma;
+  //
+  // Compute the moments by the recursive filter instead of the window?
+  bool recursive;
+  //
+  // Report the deviation of the recursive filter from the window?
+  bool validate;
+  //
+  // Use a uniform window whose moments are computed by running sums?
+  bool box;
 public:
   Settings(void)
     : Log(false),
-      m_pcInputName_1(NULL), m_pcInputName_2(NULL),
+      m_pcInputName_1(NULL), m_ppcInputNames_2(NULL), m_iCandidates(0),
       ncpus(1), bylevel(false), vif(false),
       linear(false), nowavelet(false),
       m_pcMask(NULL), m_pcError(NULL),
-      m_dMasking(2.0)
+      m_dMasking(2.0), m_pcBatch(NULL), json(false), stream(false),
+      luma(false), space(ColorTransformer::YCbCr),
+      window(ssimIndex::WindowSize), sigma(ssimIndex::DefaultSigma),
+      recursive(false), validate(false), box(false)
   { 
   }
   //
+  // Return the window and how the SSIM computes its moments.
+  ssimIndex::WindowFilter FilterOf(void) const
+  {
+    if (box)
+      return ssimIndex::Box;
+    if (recursive)
+      return ssimIndex::Recursive;
+    return ssimIndex::Gaussian;
+  }
+  //
   ~Settings(void)
   {
+    int i;
     delete[] m_pcInputName_1;
-    delete[] m_pcInputName_2;
+    for(i = 0;i < m_iCandidates;i++)
+      delete[] m_ppcInputNames_2[i];
+    delete[] m_ppcInputNames_2;
     delete[] m_pcMask;
     delete[] m_pcError;
+    delete[] m_pcBatch;
   }
   //
   // Print the usage rules for this program.
@@ -152,8 +211,19 @@ void Settings::Usage(const char *progname)
 	 "\t[-err file] \t: create an image showing the error distribution\n"
 	 "\t[-lin]      \t: compute the (m)ssim as linear value, not in dB as by default\n"
 	 "\t[-nowav]    \t: compute a single scale ssim instead of multiscale mssim\n"
+	 "\t[-simd ext] \t: restrict the instruction set to scalar,sse4.2,avx2 or avx512\n"
+	 "\t[-batch file]\t: compare the image pairs listed in file instead of infile1,infile2\n"
+	 "\t[-json]     \t: write batch results as JSON lines instead of CSV\n"
+	 "\t[-stream]   \t: keep only the image rows covered by the window, for very large images\n"
+	 "\t[-luma]     \t: compare the luma of color images only\n"
+	 "\t[-space cs] \t: compare color images in ycbcr (default), linear, itp or luv\n"
+	 "\t[-win size] \t: use a size x size SSIM window, default is 11\n"
+	 "\t[-sigma val]\t: set the standard deviation of the window, default is 1.06\n"
+	 "\t[-iir]      \t: approximate the window by a recursive filter, for large windows\n"
+	 "\t[-iircheck] \t: report the deviation of the recursive filter from the window\n"
+	 "\t[-box size] \t: use a uniform size x size window instead of the gaussian\n"
 	 "\tinfile1:\t the original file name.\n"
-	 "\tinfile2:\t the distorted file name.\n"
+	 "\tinfile2:\t the distorted file name, or several of them to compare against infile1.\n"
 	 "%s currently understands .ppm and .pgm files.default:ssim\n",
 	 progname,progname);
 }
@@ -167,6 +237,7 @@ void Settings::ParseArgs(int argc,char **argv)
   const char *arg;
   const char *progname = argv[0];
   bool failure = false;
+  bool haswindow = false,hassigma = false; // -win or -sigma given?
   
   //do I need this??
   argc--;
@@ -225,8 +296,98 @@ void Settings::ParseArgs(int argc,char **argv)
 	  failure = true;
 	  break;
 	}
+      } else if (!strcmp(arg,"-batch")) {
+	if (argv[0] && m_pcBatch == NULL) {
+	  m_pcBatch = new char[strlen(argv[0]) + 1];
+	  strcpy(m_pcBatch,argv[0]);
+	  argc--;
+	  argv++;
+	} else {
+	  failure = true;
+	  break;
+	}
+      } else if (!strcmp(arg,"-json")) {
+	json    = true;
+      } else if (!strcmp(arg,"-stream")) {
+	stream  = true;
+      } else if (!strcmp(arg,"-luma")) {
+	luma    = true;
+      } else if (!strcmp(arg,"-space")) {
+	if (argv[0] && ColorTransformer::ParseColorSpace(argv[0],space)) {
+	  argc--;
+	  argv++;
+	} else {
+	  fprintf(stderr,"-space requires one of ycbcr, linear, itp or luv\n");
+	  failure = true;
+	  break;
+	}
+      } else if (!strcmp(arg,"-win")) {
+	if (argv[0]) {
+	  char *end;
+	  long size = strtol(argv[0],&end,10);
+	  if (*end || size < 3 || size > 255 || (size & 1) == 0) {
+	    fprintf(stderr,"window size must be an odd number between 3 and 255\n");
+	    failure = true;
+	    break;
+	  }
+	  window    = size;
+	  haswindow = true;
+	  argc--;
+	  argv++;
+	} else {
+	  failure = true;
+	  break;
+	}
+      } else if (!strcmp(arg,"-sigma")) {
+	if (argv[0]) {
+	  char *end;
+	  sigma = strtod(argv[0],&end);
+	  if (*end || sigma <= 0.0) {
+	    fprintf(stderr,"sigma must be a positive numeric argument\n");
+	    failure = true;
+	    break;
+	  }
+	  hassigma = true;
+	  argc--;
+	  argv++;
+	} else {
+	  failure = true;
+	  break;
+	}
+      } else if (!strcmp(arg,"-box")) {
+	if (argv[0]) {
+	  char *end;
+	  long size = strtol(argv[0],&end,10);
+	  if (*end || size < 2 || size > 255) {
+	    fprintf(stderr,"box window size must be a number between 2 and 255\n");
+	    failure = true;
+	    break;
+	  }
+	  window = size;
+	  box    = true;
+	  argc--;
+	  argv++;
+	} else {
+	  failure = true;
+	  break;
+	}
+      } else if (!strcmp(arg,"-iir")) {
+	recursive = true;
+      } else if (!strcmp(arg,"-iircheck")) {
+	validate  = true;
       } else if (!strcmp(arg,"-log")) {
 	// always on, only for backwards compatibility
+      } else if (!strcmp(arg,"-simd")) {
+	CPU::Extension ext;
+	if (argv[0] && CPU::ParseExtension(argv[0],ext)) {
+	  CPU::LimitExtension(ext);
+	  argc--;
+	  argv++;
+	} else {
+	  fprintf(stderr,"-simd requires one of scalar, sse4.2, avx2 or avx512\n");
+	  failure = true;
+	  break;
+	}
       } else if (!strcmp(arg,"-CC")) {
 	if (argv[0]) {
 	  ncpus = atoi(argv[0]);
@@ -248,19 +409,546 @@ void Settings::ParseArgs(int argc,char **argv)
     }
  }
     
- // Exactly two arguments must be left:
- // the 2 input files' name.
- if (failure || argc != 2) {
+ // Streaming is only available for SSIM, and without the error map
+ // which is as large as the images.
+ if (stream && (vif || m_pcError))
+   failure = true;
+ //
+ // The recursive filter requires the rows beyond the window, and
+ // is only defined for larger deviations.
+ if ((recursive || validate) && (stream || sigma < RecursiveMoments::MinSigma)) {
+   if (sigma < RecursiveMoments::MinSigma)
+     fprintf(stderr,"the recursive filter requires a sigma of at least %g\n",RecursiveMoments::MinSigma);
+   failure = true;
+ }
+ //
+ // The validation compares a single pair of images by SSIM.
+ if (validate && (vif || m_pcBatch))
+   failure = true;
+ //
+ // The uniform window has no gaussian to size or to approximate by
+ // the recursive filter, and VIF uses its own window.
+ if (box && (haswindow || hassigma || recursive || validate || vif)) {
+   fprintf(stderr,"-box cannot be combined with -win, -sigma, -iir, -iircheck or -vif\n");
+   failure = true;
+ }
+ //
+ // In batch mode, the images come from the manifest.
+ if (m_pcBatch) {
+   if (failure || argc != 0 || m_pcError) {
+     Usage(progname);
+     exit(10);
+   }
+   return;
+ }
+ //
+ // At least two arguments must be left: the reference and
+ // the distorted images. Error maps are only available for
+ // a single distorted image.
+ if (failure || argc < 2 || (argc > 2 && m_pcError)) {
    Usage(progname);
    exit(10);
  }
  //
- m_pcInputName_1  = new char[strlen(argv[0]) + 1];
- m_pcInputName_2 = new char[strlen(argv[1]) + 1];
+ m_pcInputName_1   = new char[strlen(argv[0]) + 1];
+ m_ppcInputNames_2 = new char *[argc - 1];
  //
  // copy the names over.
  strcpy(m_pcInputName_1,argv[0]);
- strcpy(m_pcInputName_2,argv[1]);
+ for(m_iCandidates = 0;m_iCandidates < argc - 1;m_iCandidates++) {
+   const char *name = argv[m_iCandidates + 1];
+   m_ppcInputNames_2[m_iCandidates] = new char[strlen(name) + 1];
+   strcpy(m_ppcInputNames_2[m_iCandidates],name);
+ }
+}
+///
+
+/// TransformImage
+// Check whether the image is color. If so, run a color transformation
+// into the given space the indices work in, using up to ncpus CPUs.
+static void TransformImage(class Image &img,int ncpus,ColorTransformer::ColorSpace space)
+{
+  switch(img.ComponentCountOf()) {
+  case 1:
+    // gray-scale, fine.
+    break;
+  case 3:
+    {
+      class ColorTransformer trafo(space);
+      //
+      trafo.ForwardsTransform(&img,ncpus);
+    }
+    break;
+  default:
+    Throw(NotImplemented,"main","unsupported number of components, cannot compare images.\n");
+    break;
+  }
+}
+///
+
+/// CheckDimensions
+// Ensure that the two images can be compared, i.e. their components
+// all have the same dimensions.
+static void CheckDimensions(const class Image &img1,const class Image &img2)
+{
+  int i;
+  //
+  //Wir muessen hier dafuer sorgen, dass die BIlder dieselbe Dimensionen haben
+  //
+  if (img1.ComponentCountOf() != img2.ComponentCountOf()) {
+    Throw(InvalidParameter,"main","Component counts differ, cannot compare images.\n");
+  }
+  // ensure that the image components all have the same
+  // dimensions. Can't handle other images in imco otherwise.
+  for(i = 0;i < img1.ComponentCountOf(); i++) {
+    if (!(img1.ComponentOf(i).WidthOf()  == img2.ComponentOf(i).WidthOf() &&
+	  img1.ComponentOf(i).HeightOf() == img2.ComponentOf(i).HeightOf())) {
+      Throw(InvalidParameter,"main","Component dimensions differ, cannot compare images.\n");
+    }
+  }
+}
+///
+
+/// LoadImage
+// Load an image from the given file and decompose it into the number of
+// scales required, using up to ncpus CPUs.
+static void LoadImage(const char *name,class Image &img,const struct Settings &settings,int ncpus)
+{
+  class MappedStream map;
+  // Note that MSSIM requires five stages.
+  UBYTE declevels = (settings.nowavelet)?(1):(5);
+  //
+  // Map the file if possible, read it through a buffer otherwise.
+  if (map.OpenForRead(name)) {
+    img.LoadPNM(&map,declevels,settings.vif,ncpus,settings.luma);
+    map.Close();
+  } else {
+    class FileStream in;
+    //
+    in.OpenForRead(name);
+    img.LoadPNM(&in,declevels,settings.vif,ncpus,settings.luma);
+    in.Close();
+  }
+}
+///
+
+/// LoadJob
+// Load an image and transform it to the working color space, as a job
+// of the thread pool. As exceptions cannot leave a job, a failure is
+// kept and re-thrown by the submitter.
+struct LoadJob : public ThreadJob {
+  //
+  const struct Settings *settings;
+  const char            *name;
+  class Image           *image;
+  int                    ncpus;
+  //
+  // The exception that aborted the load, if any.
+  CodecException        *error;
+  //
+  LoadJob(void)
+    : settings(NULL), name(NULL), image(NULL), ncpus(1), error(NULL)
+  { }
+  //
+  ~LoadJob(void)
+  {
+    delete error;
+  }
+  //
+  virtual void Run(void)
+  {
+    try {
+      LoadImage(name,*image,*settings,ncpus);
+      TransformImage(*image,ncpus,settings->space);
+    } catch(const CodecException &ce) {
+      error = new CodecException(ce);
+    }
+  }
+};
+///
+
+/// LoadImages
+// Load and transform the reference and the distorted image concurrently,
+// each of them again decomposing its components in parallel.
+static void LoadImages(const char *name1,class Image &img1,
+		       const char *name2,class Image &img2,const struct Settings &settings)
+{
+  struct LoadJob load[2];
+  class ThreadJob *jobs[2];
+  int i;
+  //
+  load[0].name     = name1;
+  load[0].image    = &img1;
+  load[1].name     = name2;
+  load[1].image    = &img2;
+  for(i = 0;i < 2;i++) {
+    load[i].settings = &settings;
+    load[i].ncpus    = settings.ncpus;
+    jobs[i]          = load + i;
+  }
+  ThreadPool::Execute(jobs,2,settings.ncpus);
+  //
+  for(i = 0;i < 2;i++) {
+    if (load[i].error)
+      throw CodecException(*load[i].error);
+  }
+  CheckDimensions(img1,img2);
+}
+///
+
+/// StreamImages
+// Compute the SSIM of two images without keeping their scales. Both
+// images are decomposed in lockstep, and their scales are streamed
+// into the SSIM computation row by row, using up to ncpus CPUs.
+static double StreamImages(const char *name1,const char *name2,const class ssimIndex &ssim,
+			   const struct Settings &settings,int ncpus,ColorTransformer::ColorSpace space)
+{
+  class MappedStream map1,map2;
+  class FileStream file1,file2;
+  class ByteStream *in1 = &map1;
+  class ByteStream *in2 = &map2;
+  class Image img1,img2;
+  // Note that MSSIM requires five stages.
+  UBYTE declevels = (settings.nowavelet)?(1):(5);
+  bool more;
+  //
+  // Map the files if possible, read them through a buffer otherwise.
+  if (!map1.OpenForRead(name1)) {
+    file1.OpenForRead(name1);
+    in1 = &file1;
+  }
+  if (!map2.OpenForRead(name2)) {
+    file2.OpenForRead(name2);
+    in2 = &file2;
+  }
+  img1.OpenPNM(in1,declevels,false,settings.luma);
+  img2.OpenPNM(in2,declevels,false,settings.luma);
+  CheckDimensions(img1,img2);
+  //
+  class ssimStream stream(ssim,img1,img2,space);
+  do {
+    // Both images have the same height, hence run out of rows together.
+    more = img1.PushRows(ncpus);
+    img2.PushRows(ncpus);
+    stream.Advance(ncpus);
+  } while(more);
+  //
+  return stream.ResultOf(settings.bylevel);
+}
+///
+
+/// ValidateRecursive
+// Report the deviation of the recursive filter from the window function
+// for a pair of images, for the moments and the SSIM. fir is the SSIM
+// computed by the window function.
+static void ValidateRecursive(const class Image &img1,const class Image &img2,double fir,
+			      const struct Settings &settings)
+{
+  class ssimIndex recursive(settings.m_dMasking,settings.window,settings.sigma,ssimIndex::Recursive);
+  Matrix<FLOAT> err; // no error map
+  double iir;
+  //
+  recursive.CompareMoments(img1,img2);
+  iir = recursive.ssimFactor(img1,img2,settings.ncpus,false,err);
+  if (!settings.linear) {
+    fir = -10.0 * log(1.0 - fir) / log(10.0);
+    iir = -10.0 * log(1.0 - iir) / log(10.0);
+  }
+  printf("window function: %g, recursive filter: %g, difference: %g\n",fir,iir,iir - fir);
+}
+///
+
+/// BatchPair
+// One line of the batch manifest, i.e. one pair of images to compare.
+// Pairs are run as jobs of the thread pool, the job slots and their
+// index objects are reused for all chunks of the manifest.
+struct BatchPair : public ThreadJob {
+  //
+  // The settings of the batch.
+  const struct Settings *settings;
+  //
+  // The quality indices, allocated once per slot.
+  class ssimIndex       *ssim;
+  class vifIndex        *vif;
+  //
+  // The fields of the manifest line, pointing into the line buffer.
+  const char *reference;
+  const char *distorted;
+  const char *tag;
+  //
+  // The color space of the pair, either that of the settings or the
+  // one given in the manifest line.
+  ColorTransformer::ColorSpace space;
+  //
+  // The manifest line.
+  char    line[4096];
+  //
+  // Whether the manifest line is well-formed. Malformed lines are
+  // reported as failed pairs without comparing anything.
+  bool    valid;
+  //
+  // The result of the comparison, and whether it succeeded.
+  double  result;
+  bool    success;
+  //
+  BatchPair(void)
+    : settings(NULL), ssim(NULL), vif(NULL),
+      reference(NULL), distorted(NULL), tag(NULL), space(ColorTransformer::YCbCr),
+      valid(false), result(0.0), success(false)
+  { }
+  //
+  ~BatchPair(void)
+  {
+    delete ssim;
+    delete vif;
+  }
+  //
+  // Split the manifest line into its fields. Returns false for
+  // empty lines and comments. Throws for malformed lines, the fields
+  // found are then kept for the report.
+  bool ParseLine(void);
+  //
+  // Compare the two images.
+  virtual void Run(void);
+};
+///
+
+/// BatchPair::ParseLine
+// Split the manifest line into its fields, separated by tabs or blanks.
+// The tag is optional and defaults to the name of the distorted image.
+// The line may start with "-space name" to select the color space of
+// this pair.
+bool BatchPair::ParseLine(void)
+{
+  char *fields[5];
+  char *p = line;
+  int first = 0;
+  int n;
+
+  space = settings->space;
+  for(n = 0;n < first + 3;n++) {
+    while(*p == ' ' || *p == '\t')
+      p++;
+    if (*p == '\0' || *p == '\n' || *p == '\r' || (n == 0 && *p == '#'))
+      break;
+    fields[n] = p;
+    // The tag extends to the end of the line.
+    while(*p && *p != '\n' && *p != '\r' && (n == first + 2 || (*p != ' ' && *p != '\t')))
+      p++;
+    if (*p)
+      *p++ = '\0';
+    if (n == 0 && !strcmp(fields[0],"-space"))
+      first = 2;
+  }
+  if (n == 0)
+    return false;
+  //
+  // The tag defaults to the distorted image, or whatever the line
+  // names if it is incomplete.
+  reference = (n > first)?(fields[first]):("");
+  distorted = (n > first + 1)?(fields[first + 1]):("");
+  tag       = (n > first + 2)?(fields[first + 2]):((n > first + 1)?(distorted):(fields[n - 1]));
+  //
+  if (first && (n < 2 || !ColorTransformer::ParseColorSpace(fields[1],space)))
+    Throw(InvalidParameter,"BatchPair::ParseLine","-space in batch manifest lines requires one of ycbcr, linear, itp or luv");
+  if (n < first + 2)
+    Throw(InvalidParameter,"BatchPair::ParseLine","batch manifest lines must contain a reference and a distorted image");
+  //
+  return true;
+}
+///
+
+/// BatchPair::Run
+// Compare the two images. Failures are reported, but do not abort the batch.
+void BatchPair::Run(void)
+{
+  success = false;
+  if (!valid)
+    return;
+  try {
+    //
+    // The pairs run in parallel already, hence each pair is loaded
+    // and compared by a single CPU.
+    if (settings->stream) {
+      if (ssim == NULL)
+	ssim = new class ssimIndex(settings->m_dMasking,settings->window,settings->sigma,settings->FilterOf());
+      result = StreamImages(reference,distorted,*ssim,*settings,1,space);
+    } else {
+      class Image img1,img2;
+      //
+      LoadImage(reference,img1,*settings,1);
+      LoadImage(distorted,img2,*settings,1);
+      CheckDimensions(img1,img2);
+      TransformImage(img1,1,space);
+      TransformImage(img2,1,space);
+      //
+      if (settings->vif) {
+	if (vif == NULL)
+	  vif = new class vifIndex;
+	result = vif->vifFactor(img1,img2,1,false);
+      } else {
+	Matrix<FLOAT> err; // no error map
+	if (ssim == NULL)
+	  ssim = new class ssimIndex(settings->m_dMasking,settings->window,settings->sigma,settings->FilterOf());
+	result = ssim->ssimFactor(img1,img2,1,false,err);
+      }
+    }
+    if (!settings->linear)
+      result = -10.0 * log(1.0 - result) / log(10.0);
+    success = true;
+  } catch(const CodecException &ce) {
+    class StdExceptionPrinter ep;
+    //
+    fprintf(stderr,"%s: ",tag);
+    ce.PrintException(ep);
+  }
+}
+///
+
+/// PrintField
+// Print a string as CSV field, or as JSON string.
+static void PrintField(FILE *out,const char *str,bool json)
+{
+  if (json) {
+    fputc('"',out);
+    for(;*str;str++) {
+      if (*str == '"' || *str == '\\') {
+	fprintf(out,"\\%c",*str);
+      } else if ((unsigned char)(*str) < 0x20) {
+	fprintf(out,"\\u%04x",*str);
+      } else {
+	fputc(*str,out);
+      }
+    }
+    fputc('"',out);
+  } else if (strpbrk(str,",\"\r\n")) {
+    // Needs quoting, quotes are doubled.
+    fputc('"',out);
+    for(;*str;str++) {
+      if (*str == '"')
+	fputc('"',out);
+      fputc(*str,out);
+    }
+    fputc('"',out);
+  } else {
+    fputs(str,out);
+  }
+}
+///
+
+/// PrintPair
+// Print the result of a pair as CSV or JSON line.
+static void PrintPair(FILE *out,const struct BatchPair &pair,bool json)
+{
+  if (json) {
+    fputs("{\"tag\":",out);
+    PrintField(out,pair.tag,true);
+    fputs(",\"reference\":",out);
+    PrintField(out,pair.reference,true);
+    fputs(",\"distorted\":",out);
+    PrintField(out,pair.distorted,true);
+    if (pair.success) {
+      fprintf(out,",\"value\":%.9g,\"status\":\"ok\"}\n",pair.result);
+    } else {
+      fputs(",\"value\":null,\"status\":\"failed\"}\n",out);
+    }
+  } else {
+    PrintField(out,pair.tag,false);
+    fputc(',',out);
+    PrintField(out,pair.reference,false);
+    fputc(',',out);
+    PrintField(out,pair.distorted,false);
+    if (pair.success) {
+      fprintf(out,",%.9g,ok\n",pair.result);
+    } else {
+      fputs(",,failed\n",out);
+    }
+  }
+}
+///
+
+/// RunBatch
+// Compare all image pairs listed in the manifest. Pairs are read in
+// chunks, each chunk is compared concurrently, and the results are
+// written in the order of the manifest. Returns the number of pairs
+// that could not be compared.
+static int RunBatch(const struct Settings &settings)
+{
+  enum {
+    ChunkSize = 256 // pairs compared concurrently
+  };
+  struct BatchPair *pairs = new struct BatchPair[ChunkSize];
+  class ThreadJob **jobs  = new class ThreadJob *[ChunkSize];
+  FILE *manifest          = stdin;
+  int failures            = 0;
+  int lineno              = 0;
+  bool eof                = false;
+  int n,i;
+
+  if (strcmp(settings.m_pcBatch,"-")) {
+    manifest = fopen(settings.m_pcBatch,"r");
+    if (manifest == NULL) {
+      delete[] jobs;
+      delete[] pairs;
+      ThrowIo("main","cannot open the batch manifest");
+    }
+  }
+  //
+  try {
+    if (!settings.json)
+      printf("tag,reference,distorted,value,status\n");
+    //
+    while(!eof) {
+      // Read the next chunk of pairs.
+      for(n = 0;n < ChunkSize;) {
+	pairs[n].settings = &settings;
+	if (fgets(pairs[n].line,sizeof(pairs[n].line),manifest) == NULL) {
+	  eof = true;
+	  break;
+	}
+	lineno++;
+	//
+	// A malformed line fails its pair, but not the batch.
+	try {
+	  pairs[n].valid = pairs[n].ParseLine();
+	} catch(const CodecException &ce) {
+	  class StdExceptionPrinter ep;
+	  //
+	  fprintf(stderr,"manifest line %d: ",lineno);
+	  ce.PrintException(ep);
+	  pairs[n].valid = false;
+	  jobs[n]        = pairs + n;
+	  n++;
+	  continue;
+	}
+	if (pairs[n].valid) {
+	  jobs[n] = pairs + n;
+	  n++;
+	}
+      }
+      //
+      ThreadPool::Execute(jobs,n,settings.ncpus);
+      for(i = 0;i < n;i++) {
+	PrintPair(stdout,pairs[i],settings.json);
+	if (!pairs[i].success)
+	  failures++;
+      }
+      fflush(stdout);
+    }
+  } catch(...) {
+    if (manifest != stdin)
+      fclose(manifest);
+    delete[] jobs;
+    delete[] pairs;
+    throw;
+  }
+  //
+  if (manifest != stdin)
+    fclose(manifest);
+  delete[] jobs;
+  delete[] pairs;
+
+  return failures;
 }
 ///
 
@@ -274,79 +962,76 @@ int main(int argc,char **argv)
     // parse off the command line arguments here.
     settings.ParseArgs(argc,argv);
     //
-    // Now check whether we encode or decode.
-    class FileStream in1,in2;
-    class Image img1,img2;
-    Matrix<FLOAT> err;
-    int i;
-    //
-    // Open the input stream for first image's reading.
-    in1.OpenForRead(settings.m_pcInputName_1);
-    //
-    // Open the input stream for second image's reading.
-    in2.OpenForRead(settings.m_pcInputName_2);
-    
-    
-    // Read the images from the files, and transform them
-    // on the way.
-    // Note that MSSIM requires five stages.
-    img1.LoadPNM(&in1,(settings.nowavelet)?(1):(5),settings.vif);
-    in1.Close();
-    img2.LoadPNM(&in2,(settings.nowavelet)?(1):(5),settings.vif);
-    in2.Close();
-    
-    //Wir muessen hier dafuer sorgen, dass die BIlder dieselbe Dimensionen haben
+    // Create the worker threads once, all scales and bands share them.
+    ThreadPool::CreatePool(settings.ncpus);
     //
-    if (img1.ComponentCountOf() != img2.ComponentCountOf()) {
-      Throw(InvalidParameter,"main","Component counts differ, cannot compare images.\n");
-    }
-    // ensure that the image components all have the same
-    // dimensions. Can't handle other images in imco otherwise.
-    for(i = 0;i < img1.ComponentCountOf(); i++) {
-      if (!(img1.ComponentOf(i).WidthOf()  == img2.ComponentOf(i).WidthOf() &&
-	    img1.ComponentOf(i).HeightOf() == img2.ComponentOf(i).HeightOf())) {
-	Throw(InvalidParameter,"main","Component dimensions differ, cannot compare images.\n");
-      }
+    // In batch mode, the pairs come from the manifest.
+    if (settings.m_pcBatch) {
+      int failures = RunBatch(settings);
+      ThreadPool::ReleasePool();
+      LineSlab::ReleaseCache();
+      BandArena::ReleaseCache();
+      ColorTables::ReleaseTables();
+      return (failures > 0)?(5):(0);
     }
     //
-    // Generate an error map?
-    if (settings.m_pcError) {
-      err.Allocate(img1.ComponentOf(0).WidthOf(),img1.ComponentOf(0).HeightOf());
-    }
+    // Now check whether we encode or decode.
+    class Image img1;
+    class vifIndex vif;
+    class ssimIndex ssim1(settings.m_dMasking,settings.window,settings.sigma,
+			  (settings.validate)?(ssimIndex::Gaussian):(settings.FilterOf()));
+    Matrix<FLOAT> err;
+    int c;
     //
-    // Check whether the image is color. If so, run a color transformation
-    // and perform the computation only on the Y plane.
-    switch(img1.ComponentCountOf()) {
-    case 1:
-      // gray-scale, fine.
-      break;
-    case 3:
-      {
-	class ColorTransformer trafo;
+    for(c = 0;c < settings.m_iCandidates;c++) {
+      class Image img2;
+      double psnr;
+      //
+      if (settings.stream) {
+	// The reference is streamed again for each distorted image, as
+	// its scales are not kept.
+	psnr = StreamImages(settings.m_pcInputName_1,settings.m_ppcInputNames_2[c],ssim1,
+			    settings,settings.ncpus,settings.space);
+      } else {
+	if (c == 0) {
+	  // Read the reference image along with the first distorted image,
+	  // and transform them on the way. The reference is loaded only once,
+	  // regardless of the number of distorted images it is compared against.
+	  LoadImages(settings.m_pcInputName_1,img1,settings.m_ppcInputNames_2[0],img2,settings);
+	  //
+	  // With more than one distorted image, keep the moments of the reference
+	  // such that only the moments of the distorted images are computed.
+	  if (settings.m_iCandidates > 1 && !settings.vif)
+	    ssim1.CacheReference(img1);
+	  //
+	  // Generate an error map?
+	  if (settings.m_pcError) {
+	    err.Allocate(img1.ComponentOf(0).WidthOf(),img1.ComponentOf(0).HeightOf());
+	  }
+	} else {
+	  LoadImage(settings.m_ppcInputNames_2[c],img2,settings,settings.ncpus);
+	  CheckDimensions(img1,img2);
+	  TransformImage(img2,settings.ncpus,settings.space);
+	}
 	//
-	trafo.ForwardsTransform(&img1);
-	trafo.ForwardsTransform(&img2);
+	if (settings.vif) {
+	  psnr = vif.vifFactor(img1,img2,settings.ncpus,settings.bylevel);
+	} else {
+	  psnr = ssim1.ssimFactor(img1,img2,settings.ncpus,settings.bylevel,err);
+	  if (settings.validate)
+	    ValidateRecursive(img1,img2,psnr,settings);
+	}
       }
-      break;
-    default:
-      Throw(NotImplemented,"main","unsupported number of components, cannot compare images.\n");
-      break;
-    }
-    //
-    double psnr;
-    
-    if (settings.vif) {
-      class vifIndex vif;
-      psnr = vif.vifFactor(img1,img2,settings.ncpus,settings.bylevel);
-      if (!settings.linear)
-	psnr = -10.0 * log(1.0 - psnr) / log(10.0);
-    } else {
-      class ssimIndex ssim1(settings.m_dMasking);
-      psnr = ssim1.ssimFactor(img1,img2,settings.ncpus,settings.bylevel,err);
       if (!settings.linear)
 	psnr = -10.0 * log(1.0 - psnr) / log(10.0);
+      //
+      // With several distorted images, tell which result is which.
+      if (settings.m_iCandidates > 1) {
+	printf("%s\t%g\n",settings.m_ppcInputNames_2[c],psnr);
+      } else {
+	printf("%g\n",psnr);
+      }
     }
-    printf("%g\n",psnr);
     //
     // Create the error map
     if (settings.m_pcError) {
@@ -368,8 +1053,16 @@ int main(int argc,char **argv)
     class StdExceptionPrinter ep;
     //
     ce.PrintException(ep);
+    ThreadPool::ReleasePool();
+    LineSlab::ReleaseCache();
+    BandArena::ReleaseCache();
+    ColorTables::ReleaseTables();
     return 5;
   }
+  ThreadPool::ReleasePool();
+  LineSlab::ReleaseCache();
+  BandArena::ReleaseCache();
+  ColorTables::ReleaseTables();
   return 0;
 }
 ///
@@ -0,0 +1,342 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+/// Includes
+#include "ctrafo/colorkernels.hpp"
+#include "std/math.hpp"
+#ifdef USE_X86_SIMD
+#include <immintrin.h>
+#endif
+///
+
+/// Scalar kernels
+// These are the reference implementations. The vector kernels use them
+// for the samples that do not fill a complete vector, hence they start
+// at sample x.
+
+/// LoadRange
+static void LoadRange(const FLOAT *src,ULONG x,ULONG count,DOUBLE *dst)
+{
+  for(;x < count;x++)
+    dst[x] = src[x];
+}
+///
+
+/// StoreRange
+static void StoreRange(const DOUBLE *src,ULONG x,ULONG count,FLOAT *dst)
+{
+  for(;x < count;x++)
+    dst[x] = FLOAT(src[x]);
+}
+///
+
+/// DecodeRange
+static void DecodeRange(const FLOAT *src,ULONG x,ULONG count,DOUBLE *dst,const DOUBLE *lut,ULONG max)
+{
+  for(;x < count;x++) {
+    DOUBLE v = src[x];
+    if (v <= 0.0) {
+      dst[x] = 0.0;
+    } else if (v >= max) {
+      dst[x] = 1.0;
+    } else {
+      dst[x] = lut[ULONG(v)];
+    }
+  }
+}
+///
+
+/// MultiplyRange
+static void MultiplyRange(DOUBLE *const *c,ULONG x,ULONG count,const DOUBLE *m)
+{
+  DOUBLE *c0 = c[0];
+  DOUBLE *c1 = c[1];
+  DOUBLE *c2 = c[2];
+
+  for(;x < count;x++) {
+    DOUBLE a = c0[x];
+    DOUBLE b = c1[x];
+    DOUBLE d = c2[x];
+    c0[x]    = m[0] * a + m[1] * b + m[2] * d;
+    c1[x]    = m[3] * a + m[4] * b + m[5] * d;
+    c2[x]    = m[6] * a + m[7] * b + m[8] * d;
+  }
+}
+///
+
+/// CompandRange
+static void CompandRange(DOUBLE *c,ULONG x,ULONG count,const DOUBLE *lut,ULONG scale)
+{
+  for(;x < count;x++) {
+    DOUBLE v = c[x];
+    DOUBLE a = fabs(v) * scale;
+    if (a > scale)
+      a = scale;
+    c[x] = (v >= 0.0)?(lut[ULONG(a)]):(-lut[ULONG(a)]);
+  }
+}
+///
+
+/// LoadScalar
+static void LoadScalar(const FLOAT *src,ULONG count,DOUBLE *dst)
+{
+  LoadRange(src,0,count,dst);
+}
+///
+
+/// StoreScalar
+static void StoreScalar(const DOUBLE *src,ULONG count,FLOAT *dst)
+{
+  StoreRange(src,0,count,dst);
+}
+///
+
+/// DecodeScalar
+static void DecodeScalar(const FLOAT *src,ULONG count,DOUBLE *dst,const DOUBLE *lut,ULONG max)
+{
+  DecodeRange(src,0,count,dst,lut,max);
+}
+///
+
+/// MultiplyScalar
+static void MultiplyScalar(DOUBLE *const *c,ULONG count,const DOUBLE *m)
+{
+  MultiplyRange(c,0,count,m);
+}
+///
+
+/// CompandScalar
+static void CompandScalar(DOUBLE *c,ULONG count,const DOUBLE *lut,ULONG scale)
+{
+  CompandRange(c,0,count,lut,scale);
+}
+///
+///
+
+#ifdef USE_X86_SIMD
+/// SSE4.2 kernels
+// SSE4.2 has no gathers, hence the table lookups use the scalar code.
+
+/// LoadSSE42
+__attribute__((target("sse4.2")))
+static void LoadSSE42(const FLOAT *src,ULONG count,DOUBLE *dst)
+{
+  ULONG x;
+
+  for(x = 0;x + 4 <= count;x += 4) {
+    __m128 v = _mm_loadu_ps(src + x);
+    _mm_storeu_pd(dst + x    ,_mm_cvtps_pd(v));
+    _mm_storeu_pd(dst + x + 2,_mm_cvtps_pd(_mm_movehl_ps(v,v)));
+  }
+  LoadRange(src,x,count,dst);
+}
+///
+
+/// StoreSSE42
+__attribute__((target("sse4.2")))
+static void StoreSSE42(const DOUBLE *src,ULONG count,FLOAT *dst)
+{
+  ULONG x;
+
+  for(x = 0;x + 4 <= count;x += 4) {
+    __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + x));
+    __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + x + 2));
+    _mm_storeu_ps(dst + x,_mm_movelh_ps(lo,hi));
+  }
+  StoreRange(src,x,count,dst);
+}
+///
+
+/// MultiplySSE42
+__attribute__((target("sse4.2")))
+static void MultiplySSE42(DOUBLE *const *c,ULONG count,const DOUBLE *m)
+{
+  DOUBLE *c0 = c[0];
+  DOUBLE *c1 = c[1];
+  DOUBLE *c2 = c[2];
+  __m128d m0 = _mm_set1_pd(m[0]),m1 = _mm_set1_pd(m[1]),m2 = _mm_set1_pd(m[2]);
+  __m128d m3 = _mm_set1_pd(m[3]),m4 = _mm_set1_pd(m[4]),m5 = _mm_set1_pd(m[5]);
+  __m128d m6 = _mm_set1_pd(m[6]),m7 = _mm_set1_pd(m[7]),m8 = _mm_set1_pd(m[8]);
+  ULONG x;
+
+  for(x = 0;x + 2 <= count;x += 2) {
+    __m128d a = _mm_loadu_pd(c0 + x);
+    __m128d b = _mm_loadu_pd(c1 + x);
+    __m128d d = _mm_loadu_pd(c2 + x);
+    _mm_storeu_pd(c0 + x,_mm_add_pd(_mm_add_pd(_mm_mul_pd(m0,a),_mm_mul_pd(m1,b)),_mm_mul_pd(m2,d)));
+    _mm_storeu_pd(c1 + x,_mm_add_pd(_mm_add_pd(_mm_mul_pd(m3,a),_mm_mul_pd(m4,b)),_mm_mul_pd(m5,d)));
+    _mm_storeu_pd(c2 + x,_mm_add_pd(_mm_add_pd(_mm_mul_pd(m6,a),_mm_mul_pd(m7,b)),_mm_mul_pd(m8,d)));
+  }
+  MultiplyRange(c,x,count,m);
+}
+///
+///
+
+/// AVX2 kernels
+// The table lookups gather four doubles at a time, indexed by the
+// truncated samples clipped to the table.
+
+/// LoadAVX2
+__attribute__((target("avx2")))
+static void LoadAVX2(const FLOAT *src,ULONG count,DOUBLE *dst)
+{
+  ULONG x;
+
+  for(x = 0;x + 4 <= count;x += 4) {
+    _mm256_storeu_pd(dst + x,_mm256_cvtps_pd(_mm_loadu_ps(src + x)));
+  }
+  LoadRange(src,x,count,dst);
+}
+///
+
+/// StoreAVX2
+__attribute__((target("avx2")))
+static void StoreAVX2(const DOUBLE *src,ULONG count,FLOAT *dst)
+{
+  ULONG x;
+
+  for(x = 0;x + 4 <= count;x += 4) {
+    _mm_storeu_ps(dst + x,_mm256_cvtpd_ps(_mm256_loadu_pd(src + x)));
+  }
+  StoreRange(src,x,count,dst);
+}
+///
+
+/// DecodeAVX2
+__attribute__((target("avx2")))
+static void DecodeAVX2(const FLOAT *src,ULONG count,DOUBLE *dst,const DOUBLE *lut,ULONG max)
+{
+  const __m256  top  = _mm256_set1_ps(FLOAT(max));
+  const __m256  last = _mm256_set1_ps(FLOAT(max - 1));
+  const __m256  zero = _mm256_setzero_ps();
+  const __m256d one  = _mm256_set1_pd(1.0);
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m256  v   = _mm256_loadu_ps(src + x);
+    __m256i idx = _mm256_cvttps_epi32(_mm256_max_ps(_mm256_min_ps(v,last),zero));
+    __m256i low = _mm256_castps_si256(_mm256_cmp_ps(v,zero,_CMP_LE_OQ));
+    __m256i hgh = _mm256_castps_si256(_mm256_cmp_ps(v,top ,_CMP_GE_OQ));
+    int i;
+    for(i = 0;i < 2;i++) {
+      __m128i ix = (i)?(_mm256_extracti128_si256(idx,1)):(_mm256_castsi256_si128(idx));
+      __m128i lx = (i)?(_mm256_extracti128_si256(low,1)):(_mm256_castsi256_si128(low));
+      __m128i hx = (i)?(_mm256_extracti128_si256(hgh,1)):(_mm256_castsi256_si128(hgh));
+      __m256d d  = _mm256_i32gather_pd(lut,ix,8);
+      d = _mm256_andnot_pd(_mm256_castsi256_pd(_mm256_cvtepi32_epi64(lx)),d);
+      d = _mm256_blendv_pd(d,one,_mm256_castsi256_pd(_mm256_cvtepi32_epi64(hx)));
+      _mm256_storeu_pd(dst + x + 4 * i,d);
+    }
+  }
+  DecodeRange(src,x,count,dst,lut,max);
+}
+///
+
+/// MultiplyAVX2
+__attribute__((target("avx2")))
+static void MultiplyAVX2(DOUBLE *const *c,ULONG count,const DOUBLE *m)
+{
+  DOUBLE *c0 = c[0];
+  DOUBLE *c1 = c[1];
+  DOUBLE *c2 = c[2];
+  __m256d m0 = _mm256_set1_pd(m[0]),m1 = _mm256_set1_pd(m[1]),m2 = _mm256_set1_pd(m[2]);
+  __m256d m3 = _mm256_set1_pd(m[3]),m4 = _mm256_set1_pd(m[4]),m5 = _mm256_set1_pd(m[5]);
+  __m256d m6 = _mm256_set1_pd(m[6]),m7 = _mm256_set1_pd(m[7]),m8 = _mm256_set1_pd(m[8]);
+  ULONG x;
+
+  for(x = 0;x + 4 <= count;x += 4) {
+    __m256d a = _mm256_loadu_pd(c0 + x);
+    __m256d b = _mm256_loadu_pd(c1 + x);
+    __m256d d = _mm256_loadu_pd(c2 + x);
+    _mm256_storeu_pd(c0 + x,_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m0,a),_mm256_mul_pd(m1,b)),
+					  _mm256_mul_pd(m2,d)));
+    _mm256_storeu_pd(c1 + x,_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m3,a),_mm256_mul_pd(m4,b)),
+					  _mm256_mul_pd(m5,d)));
+    _mm256_storeu_pd(c2 + x,_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m6,a),_mm256_mul_pd(m7,b)),
+					  _mm256_mul_pd(m8,d)));
+  }
+  MultiplyRange(c,x,count,m);
+}
+///
+
+/// CompandAVX2
+__attribute__((target("avx2")))
+static void CompandAVX2(DOUBLE *c,ULONG count,const DOUBLE *lut,ULONG scale)
+{
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  const __m256d top  = _mm256_set1_pd(DOUBLE(scale));
+  const __m256d zero = _mm256_setzero_pd();
+  ULONG x;
+
+  for(x = 0;x + 4 <= count;x += 4) {
+    __m256d v   = _mm256_loadu_pd(c + x);
+    __m256d a   = _mm256_min_pd(_mm256_mul_pd(_mm256_andnot_pd(sign,v),top),top);
+    __m256d d   = _mm256_i32gather_pd(lut,_mm256_cvttpd_epi32(a),8);
+    __m256d neg = _mm256_cmp_pd(v,zero,_CMP_LT_OQ);
+    _mm256_storeu_pd(c + x,_mm256_xor_pd(d,_mm256_and_pd(neg,sign)));
+  }
+  CompandRange(c,x,count,lut,scale);
+}
+///
+///
+#endif
+
+/// Kernel tables
+// AVX-512 would allow the compiler to contract the multiplications and
+// additions of the matrix multiply, which would break the bit-exactness
+// with the scalar code. As the transformation is bound by the memory
+// bandwidth anyhow, AVX-512 CPUs use the AVX2 kernels.
+static const ColorKernels ScalarKernels = {
+  &LoadScalar,&StoreScalar,&DecodeScalar,&MultiplyScalar,&CompandScalar
+};
+#ifdef USE_X86_SIMD
+static const ColorKernels SSE42Kernels = {
+  &LoadSSE42,&StoreSSE42,&DecodeScalar,&MultiplySSE42,&CompandScalar
+};
+static const ColorKernels AVX2Kernels = {
+  &LoadAVX2,&StoreAVX2,&DecodeAVX2,&MultiplyAVX2,&CompandAVX2
+};
+#endif
+///
+
+/// ColorKernels::KernelsOf
+// Return the kernels for the given extension.
+const ColorKernels &ColorKernels::KernelsOf(CPU::Extension ext)
+{
+#ifdef USE_X86_SIMD
+  switch(ext) {
+  case CPU::AVX512:
+  case CPU::AVX2:
+    return AVX2Kernels;
+  case CPU::SSE42:
+    return SSE42Kernels;
+  case CPU::Scalar:
+    break;
+  }
+#else
+  (void)ext;
+#endif
+  return ScalarKernels;
+}
+///
@@ -0,0 +1,94 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class collects the inner loops of the color transformation,
+** working on rows of samples rather than single pixels.
+*/
+
+#ifndef CTRAFO_COLORKERNELS_HPP
+#define CTRAFO_COLORKERNELS_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/cpu.hpp"
+///
+
+/// class ColorKernels
+// The color transformations run through a short pipeline of kernels on
+// chunks of pixels. The samples are first loaded into double precision
+// buffers, either directly or through a transfer function table, then
+// transformed by 3x3 matrices and further tables, and finally stored
+// back. Each kernel exists as scalar reference code, and as SSE4.2,
+// AVX2 and AVX-512 implementation, picked at run time for the widest
+// extension the CPU provides.
+//
+// The vector kernels compute in double precision as the scalar code,
+// and do not contract multiplications and additions, hence all
+// implementations are bit-exact.
+class ColorKernels {
+public:
+  //
+  // Widen count samples to double precision.
+  typedef void (*LoadFunc)(const FLOAT *src,ULONG count,DOUBLE *dst);
+  //
+  // Round count samples back to single precision.
+  typedef void (*StoreFunc)(const DOUBLE *src,ULONG count,FLOAT *dst);
+  //
+  // Map count samples through the table lut of max entries. Samples
+  // at or below zero map to zero, samples at or above max to one,
+  // others to the entry of their integer part.
+  typedef void (*DecodeFunc)(const FLOAT *src,ULONG count,DOUBLE *dst,
+			     const DOUBLE *lut,ULONG max);
+  //
+  // Multiply count pixels whose components are in c[0],c[1] and c[2]
+  // in place by the 3x3 matrix m, given in row-major order. Each
+  // output is computed as (m[0] * c0 + m[1] * c1) + m[2] * c2.
+  typedef void (*MultiplyFunc)(DOUBLE *const *c,ULONG count,const DOUBLE *m);
+  //
+  // Map count samples in place through an odd function tabulated in
+  // lut, which has scale + 1 entries for the arguments 0 to 1, i.e.
+  // c = sign(c) * lut[|c| * scale], with the argument truncated and
+  // clipped to the table.
+  typedef void (*CompandFunc)(DOUBLE *c,ULONG count,const DOUBLE *lut,ULONG scale);
+  //
+  LoadFunc     Load;
+  StoreFunc    Store;
+  DecodeFunc   Decode;
+  MultiplyFunc Multiply;
+  CompandFunc  Compand;
+  //
+  // Return the kernels for the given extension. If the extension is not
+  // supported by this build, the next narrower one is returned.
+  static const ColorKernels &KernelsOf(CPU::Extension ext);
+  //
+  // Return the kernels for the widest extension available.
+  static const ColorKernels &KernelsOf(void)
+  {
+    return KernelsOf(CPU::ExtensionOf());
+  }
+};
+///
+
+///
+#endif
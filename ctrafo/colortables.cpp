@@ -0,0 +1,174 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+/// Includes
+#include "ctrafo/colortables.hpp"
+#include "global/exceptions.hpp"
+#include "std/math.hpp"
+#include "std/assert.hpp"
+///
+
+/// Defines
+#define OUTPUT_GAMMA 1.0
+///
+
+/// Statics
+DOUBLE             *ColorTables::m_pdLMS      = NULL;
+DOUBLE             *ColorTables::m_pdCubeRoot = NULL;
+class ColorTables  *ColorTables::m_pTables[17];
+#ifndef NO_POSIX
+pthread_mutex_t     ColorTables::m_Lock       = PTHREAD_MUTEX_INITIALIZER;
+#endif
+///
+
+/// ColorTables::sRGBTransfer
+// The RGB->R'B'G' transfer function, for samples between zero and scale.
+DOUBLE ColorTables::sRGBTransfer(DOUBLE in,DOUBLE scale)
+{
+  if (in < 0.04045 * scale) {
+    // The linear region
+    return in / (12.92 * scale);
+  } else {
+    return pow((in / scale + 0.055) / 1.055,2.4);
+  }
+}
+///
+
+/// ColorTables::sRGBInverse
+// The inverse of the above, from linear values between zero and one.
+DOUBLE ColorTables::sRGBInverse(DOUBLE in)
+{
+  double kneeslope =  (1.055 * pow( 0.0031308, OUTPUT_GAMMA * 1./2.4 ) - 0.055) / 0.0031308;
+  
+  return (in <= 0.0031308 ? in * kneeslope : 1.055 * pow( in, OUTPUT_GAMMA * 1./2.4 ) - 0.055);
+}
+///
+
+/// ColorTables::LMSTransfer
+// The LMS to L'M'S' lookup function.
+DOUBLE ColorTables::LMSTransfer(DOUBLE in)
+{
+  return pow(in,0.43);
+}
+///
+
+/// ColorTables::CubeRoot
+// The nonlinearity of CIE L*.
+DOUBLE ColorTables::CubeRoot(DOUBLE in)
+{
+  return pow(in,1.0/3.0);
+}
+///
+
+/// ColorTables::Tabulate
+// Tabulate a function at the arguments 0 to 1 in steps of 1/CompandScale,
+// scaling its values.
+DOUBLE *ColorTables::Tabulate(DOUBLE (*f)(DOUBLE),DOUBLE scale)
+{
+  DOUBLE *lut = new DOUBLE[CompandScale + 1];
+  ULONG i;
+
+  for(i = 0;i <= CompandScale;i++) {
+    lut[i] = f(DOUBLE(i) / CompandScale) * scale;
+  }
+
+  return lut;
+}
+///
+
+/// ColorTables::ColorTables
+// Build the tables of the given bit depth. This is called with the
+// lock held, hence also builds the tables shared by all bit depths.
+ColorTables::ColorTables(UBYTE bits)
+  : m_ulMax(1UL << bits), m_pdDecode(NULL), m_pdEncode(NULL)
+{
+  ULONG i;
+  //
+  m_pdDecode = new DOUBLE[m_ulMax];
+  for(i = 0;i < m_ulMax;i++) {
+    m_pdDecode[i] = sRGBTransfer(i,m_ulMax - 1);
+  }
+  m_pdEncode = Tabulate(&sRGBInverse,m_ulMax - 1);
+  //
+  if (m_pdLMS == NULL)
+    m_pdLMS      = Tabulate(&LMSTransfer,1.0);
+  if (m_pdCubeRoot == NULL)
+    m_pdCubeRoot = Tabulate(&CubeRoot,1.0);
+}
+///
+
+/// ColorTables::~ColorTables
+ColorTables::~ColorTables(void)
+{
+  delete[] m_pdDecode;
+  delete[] m_pdEncode;
+}
+///
+
+/// ColorTables::TablesOf
+// Return the tables of the given bit depth, building them on the first
+// request.
+const class ColorTables &ColorTables::TablesOf(UBYTE bits)
+{
+  class ColorTables *tables;
+  //
+  if (bits == 0 || bits > 16)
+    Throw(OutOfRange,"ColorTables::TablesOf","the bit depth of the image is out of range");
+  //
+#ifndef NO_POSIX
+  pthread_mutex_lock(&m_Lock);
+#endif
+  if (m_pTables[bits] == NULL)
+    m_pTables[bits] = new class ColorTables(bits);
+  tables = m_pTables[bits];
+#ifndef NO_POSIX
+  pthread_mutex_unlock(&m_Lock);
+#endif
+  //
+  return *tables;
+}
+///
+
+/// ColorTables::ReleaseTables
+// Release the tables of all bit depths.
+void ColorTables::ReleaseTables(void)
+{
+  int i;
+  //
+#ifndef NO_POSIX
+  pthread_mutex_lock(&m_Lock);
+#endif
+  for(i = 0;i <= 16;i++) {
+    delete m_pTables[i];
+    m_pTables[i] = NULL;
+  }
+  delete[] m_pdLMS;
+  m_pdLMS      = NULL;
+  delete[] m_pdCubeRoot;
+  m_pdCubeRoot = NULL;
+#ifndef NO_POSIX
+  pthread_mutex_unlock(&m_Lock);
+#endif
+}
+///
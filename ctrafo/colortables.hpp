@@ -0,0 +1,140 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class keeps the lookup tables of the nonlinear steps of the
+** color transformations, built once per input bit depth and shared
+** by all threads and images.
+*/
+
+#ifndef CTRAFO_COLORTABLES_HPP
+#define CTRAFO_COLORTABLES_HPP
+
+/// Includes
+#include "global/types.hpp"
+#ifndef NO_POSIX
+extern "C" {
+#include <pthread.h>
+}
+#endif
+///
+
+/// class ColorTables
+// The tables of one input bit depth. The transfer function of sRGB is
+// tabulated for each sample value, all other nonlinearities take
+// arguments between zero and one and are tabulated in steps of
+// 1/CompandScale, such that they can be used by the Compand kernel.
+//
+// Tables are not created directly, but requested for a bit depth. They
+// remain valid until ReleaseTables is called, which must not happen
+// while transformations are running.
+class ColorTables {
+  //
+  // The number of sample values of the bit depth.
+  ULONG          m_ulMax;
+  //
+  // The sRGB to linear RGB transfer function, one entry per sample
+  // value.
+  DOUBLE        *m_pdDecode;
+  //
+  // The linear to sRGB transfer function, scaled to the sample range.
+  DOUBLE        *m_pdEncode;
+  //
+  // The tables that do not depend on the bit depth: the LMS to L'M'S'
+  // transfer function, and the cube root of CIE L*.
+  static DOUBLE *m_pdLMS;
+  static DOUBLE *m_pdCubeRoot;
+  //
+  // The tables of all bit depths requested so far.
+  static class ColorTables *m_pTables[17];
+  //
+#ifndef NO_POSIX
+  // Protects the tables while they are created.
+  static pthread_mutex_t m_Lock;
+#endif
+  //
+  // Build the tables of the given bit depth.
+  ColorTables(UBYTE bits);
+  //
+  ~ColorTables(void);
+  //
+  // Tabulate a function at the arguments 0 to 1 in steps of 1/CompandScale.
+  static DOUBLE *Tabulate(DOUBLE (*f)(DOUBLE),DOUBLE scale);
+  //
+  // The transfer functions.
+  static DOUBLE sRGBTransfer(DOUBLE in,DOUBLE scale);
+  static DOUBLE sRGBInverse(DOUBLE in);
+  static DOUBLE LMSTransfer(DOUBLE in);
+  static DOUBLE CubeRoot(DOUBLE in);
+  //
+public:
+  //
+  // The precision of the tables of the nonlinearities.
+  enum {
+    CompandScale = 1UL << 16
+  };
+  //
+  // Return the tables of the given bit depth, building them on the first
+  // request.
+  static const class ColorTables &TablesOf(UBYTE bits);
+  //
+  // Release the tables of all bit depths.
+  static void ReleaseTables(void);
+  //
+  // Return the number of sample values, i.e. the number of entries of
+  // the decoding table.
+  ULONG MaxOf(void) const
+  {
+    return m_ulMax;
+  }
+  //
+  // Return the sRGB decoding table, mapping sample values to linear
+  // RGB between zero and one.
+  const DOUBLE *DecodeOf(void) const
+  {
+    return m_pdDecode;
+  }
+  //
+  // Return the sRGB encoding table, mapping linear values between zero
+  // and one back to the sample range.
+  const DOUBLE *EncodeOf(void) const
+  {
+    return m_pdEncode;
+  }
+  //
+  // Return the LMS to L'M'S' table.
+  const DOUBLE *LMSOf(void) const
+  {
+    return m_pdLMS;
+  }
+  //
+  // Return the cube root table.
+  const DOUBLE *CubeRootOf(void) const
+  {
+    return m_pdCubeRoot;
+  }
+};
+///
+
+///
+#endif
@@ -29,20 +29,52 @@
 
 /// Includes
 #include "ctrafo/colortransformer.hpp"
+#include "ctrafo/colorkernels.hpp"
+#include "ctrafo/colortables.hpp"
 #include "img/component.hpp"
 #include "global/exceptions.hpp"
 #include "std/math.hpp"
+#include "std/string.hpp"
 #include "std/assert.hpp"
 ///
 
-/// Defines
-//#define LINEAR_YCBCR
-#define OUTPUT_GAMMA 1.0
+/// Transformation matrices
+// The 3x3 matrices of the linear steps of the transformations, in
+// row-major order.
+//
+// sRGB to YCbCr.
+static const DOUBLE YCbCrMatrix[9] = {
+   0.299,    0.587,    0.114,
+  -0.16875, -0.33126,  0.5,
+   0.5,     -0.41869, -0.08131
+};
+//
+// Linear sRGB to XYZ. Note that we need the D65 illuminant, which is the
+// illuminant of sRGB / Rec. 709.
+static const DOUBLE XYZMatrix[9] = {
+  0.412453, 0.357580, 0.180423,
+  0.212671, 0.715160, 0.072169,
+  0.019334, 0.119193, 0.950227
+};
+//
+// XYZ to LMS.
+static const DOUBLE LMSMatrix[9] = {
+   0.4002,  0.7075, -0.0807,
+  -0.2280,  1.1500,  0.0612,
+   0.0,     0.0,     0.9184
+};
+//
+// L'M'S' to IPT.
+static const DOUBLE IPTMatrix[9] = {
+  0.4,     0.4,     0.2,
+  4.4550, -4.8510,  0.3960,
+  0.8056,  0.3572, -1.1628
+};
 ///
 
 /// ColorTransformer::ColorTransformer
-ColorTransformer::ColorTransformer(void)
-  : m_pdLookup(NULL), m_pdLMS(NULL)
+ColorTransformer::ColorTransformer(ColorSpace space)
+  : m_Space(space), m_pTables(NULL)
 {
   
 }
@@ -51,234 +83,253 @@ ColorTransformer::ColorTransformer(void)
 /// ColorTransformer::~ColorTransformer
 ColorTransformer::~ColorTransformer(void)
 {
-  delete[] m_pdLookup;
+  // The tables are shared and released by the ColorTables class.
 }
 ///
 
-/// ColorTransformer::CreateLookup
-// Create the lookup table.
-void ColorTransformer::CreateLookup(ULONG scale)
+/// ColorTransformer::NameOf
+// Return a printable name of the color space.
+const char *ColorTransformer::NameOf(ColorSpace space)
 {
-  ULONG i;
-
-  if (m_pdLookup == NULL) {
-    m_pdLookup = new DOUBLE[scale];
-    
-    for(i = 0; i < scale;i++) {
-      m_pdLookup[i] = sRGBTransfer(i,scale - 1);
-    }
+  switch(space) {
+  case YCbCr:
+    return "ycbcr";
+  case LinearYCbCr:
+    return "linear";
+  case ITP:
+    return "itp";
+  case LUV:
+    return "luv";
   }
+  return "unknown";
 }
 ///
 
-/// ColorTransformer::CreateLMSLookup
-// Create the LMS lookup table.
-void ColorTransformer::CreateLMSLookup(ULONG scale)
+/// ColorTransformer::ParseColorSpace
+// Parse a color space name as returned by NameOf.
+bool ColorTransformer::ParseColorSpace(const char *name,ColorSpace &space)
 {
-  ULONG i;
+  int i;
 
-  if (m_pdLMS == NULL) {
-    m_pdLMS = new DOUBLE[scale];
-    for(i = 0;i < scale;i++) {
-      m_pdLMS[i] = LMSTransfer(DOUBLE(i) / (scale - 1));
+  for(i = YCbCr;i <= LUV;i++) {
+    if (!strcmp(name,NameOf(ColorSpace(i)))) {
+      space = ColorSpace(i);
+      return true;
     }
   }
+  return false;
 }
 ///
 
-/// ColorTransformer::ForwardsTransform
-void ColorTransformer::ForwardsTransform(class Matrix<FLOAT> &rm,class Matrix<FLOAT> &gm,class Matrix<FLOAT> &bm,
-					 ULONG max,ULONG lmsscale)
+/// ColorTransformer::TransformRows
+// Transform the rows y0 up to but excluding y1 of the three matrices in
+// place. The pixels are loaded in chunks into double precision buffers,
+// run through the kernels of the transformation and stored back.
+void ColorTransformer::TransformRows(class Matrix<FLOAT> &rm,class Matrix<FLOAT> &gm,class Matrix<FLOAT> &bm,
+				     ULONG y0,ULONG y1) const
 { 
-  ULONG xp,yp,width,height;
-#ifdef LINEAR_YCBCR
-  double kneeslope =  (1.055 * pow( 0.0031308, OUTPUT_GAMMA * 1./2.4 ) - 0.055) / 0.0031308;  //
-#endif
+  const ColorKernels &kernels = ColorKernels::KernelsOf();
+  DOUBLE buffer[6][ChunkSize];
+  DOUBLE *c[3] = {buffer[0],buffer[1],buffer[2]};
+  DOUBLE *d[3] = {buffer[3],buffer[4],buffer[5]};
+  FLOAT *row[3];
+  ULONG x,y,k,width,count;
+  ULONG max   = (m_pTables)?(m_pTables->MaxOf()):(0);
+  ULONG scale = ColorTables::CompandScale;
+  int i;
+  //
+  assert(m_Space == YCbCr || m_pTables);
   width  = rm.WidthOf();
-  height = rm.HeightOf();
   //
-  for(yp = 0;yp<height;yp++) {
-    for(xp = 0;xp<width;xp++) {
-      DOUBLE r,g,b;
-      // Get color values. (The slow way).
-      r  = rm.Get(xp,yp);
-      g  = gm.Get(xp,yp);
-      b  = bm.Get(xp,yp);
-      //
-#if defined(ITP)
-      DOUBLE x,y,z;
-      DOUBLE l,m,s,i,t,p;
-      //
-      // Clip overflows.
-      // First step: Transform sRGB to R'G'B'
-      if (r <= 0.0) {
-	r = 0;
-      } else if (r >= max) {
-	r = 1.0;
-      } else {
-	r = m_pdLookup[ULONG(r)];
-      }
-      if (g <= 0.0) {
-	g = 0;
-      } else if (g >= max) {
-	g = 1.0;
-      } else {
-	g = m_pdLookup[ULONG(g)];
-      }
-      if (b <= 0.0) {
-	b = 0;
-      } else if (b >= max) {
-	b = 1.0;
-      } else {
-	  b = m_pdLookup[ULONG(b)];
-      }
-      //
-      // Note that we need the D65 illuminant, which is the
-      // illuminant of sRGB / Rec. 709.
-      x  = 0.412453 * r + 0.357580 * g + 0.180423 * b;
-      y  = 0.212671 * r + 0.715160 * g + 0.072169 * b;
-      z  = 0.019334 * r + 0.119193 * g + 0.950227 * b;
-      //
-      // Convert from xyz to LMS. Yes, this could be done in one
-      // step, but for simplicity...
-      l  =  0.4002 * x + 0.7075 * y - 0.0807 * z;
-      m  = -0.2280 * x + 1.1500 * y + 0.0612 * z;
-      s  = 0.9184  * z;
-      //
-      // Nonlinear transformation into primed coordinates.
-      l *= lmsscale;
-      m *= lmsscale;
-      s *= lmsscale;
-      l  = (l >= 0.0)?(m_pdLMS[ULONG(l)]):(-m_pdLMS[ULONG(-l)]);
-      m  = (m >= 0.0)?(m_pdLMS[ULONG(m)]):(-m_pdLMS[ULONG(-m)]);
-      s  = (s >= 0.0)?(m_pdLMS[ULONG(s)]):(-m_pdLMS[ULONG(-s)]);
-      //
-      // Transfer again from lms to IPT
-      i  = 0.4    * l + 0.4    * m + 0.2    * s;
-      p  = 4.4550 * l - 4.8510 * m + 0.3960 * s;
-      t  = 0.8056 * l + 0.3572 * m - 1.1628 * s;
-      //
-      // Put the stuff back.
-      rm.Put(xp,yp,i);
-      gm.Put(xp,yp,p);
-      bm.Put(xp,yp,t);
-#elif defined(LUV)
-      //
-      // First convert sRGB->XYZ
-      DOUBLE x,y,z;
-      DOUBLE xn,yn,zn,n;
-      DOUBLE l,u,v;
-      DOUBLE un,vn;
-      //
-      // Clip overflows.
-      // First step: Transform sRGB to R'G'B'
-      if (r <= 0.0) {
-	r = 0;
-      } else if (r >= max) {
-	r = 1.0;
-      } else {
-	r = m_pdLookup[ULONG(r)];
-      }
-      if (g <= 0.0) {
-	g = 0;
-      } else if (g >= max) {
-	g = 1.0;
-      } else {
-	g = m_pdLookup[ULONG(g)];
+  for(y = y0;y < y1;y++) {
+    row[0] = &rm.At(0,y);
+    row[1] = &gm.At(0,y);
+    row[2] = &bm.At(0,y);
+    for(x = 0;x < width;x += count) {
+      count = width - x;
+      if (count > ChunkSize)
+	count = ChunkSize;
+      switch(m_Space) {
+      case YCbCr:
+	// Regular YCbCr
+	for(i = 0;i < 3;i++)
+	  kernels.Load(row[i] + x,count,c[i]);
+	kernels.Multiply(c,count,YCbCrMatrix);
+	break;
+      case LinearYCbCr:
+	// The chroma is that of regular YCbCr. The luma is computed from
+	// linear RGB, then transformed back to the sample range.
+	for(i = 0;i < 3;i++) {
+	  kernels.Decode(row[i] + x,count,d[i],m_pTables->DecodeOf(),max);
+	  kernels.Load(row[i] + x,count,c[i]);
+	}
+	kernels.Multiply(c,count,YCbCrMatrix);
+	kernels.Multiply(d,count,YCbCrMatrix);
+	kernels.Compand(d[0],count,m_pTables->EncodeOf(),scale);
+	memcpy(c[0],d[0],count * sizeof(DOUBLE));
+	break;
+      case ITP:
+	// First step: Transform sRGB to R'G'B', clipping overflows.
+	for(i = 0;i < 3;i++)
+	  kernels.Decode(row[i] + x,count,c[i],m_pTables->DecodeOf(),max);
+	//
+	// Convert to XYZ, and from there to LMS. Yes, this could be
+	// done in one step, but for simplicity...
+	kernels.Multiply(c,count,XYZMatrix);
+	kernels.Multiply(c,count,LMSMatrix);
+	//
+	// Nonlinear transformation into primed coordinates.
+	for(i = 0;i < 3;i++)
+	  kernels.Compand(c[i],count,m_pTables->LMSOf(),scale);
+	//
+	// Transfer again from lms to IPT
+	kernels.Multiply(c,count,IPTMatrix);
+	break;
+      case LUV:
+	// First convert sRGB->XYZ, clipping overflows.
+	for(i = 0;i < 3;i++)
+	  kernels.Decode(row[i] + x,count,c[i],m_pTables->DecodeOf(),max);
+	kernels.Multiply(c,count,XYZMatrix);
+	//
+	// The cube root of Y for L*.
+	memcpy(d[1],c[1],count * sizeof(DOUBLE));
+	kernels.Compand(d[1],count,m_pTables->CubeRootOf(),scale);
+	//
+	for(k = 0;k < count;k++) {
+	  DOUBLE X = c[0][k],Y = c[1][k],Z = c[2][k];
+	  DOUBLE xn,yn,zn,n;
+	  DOUBLE l,u,v;
+	  DOUBLE un,vn;
+	  //
+	  // Initialize with the D65 white-point.
+	  xn = 0.95056;
+	  yn = 1.0;
+	  zn = 1.089050;
+	  //
+	  // Compute L*,u*,v*
+	  l  = 116.0 * d[1][k] - 16.0;
+	  n  = (X + 15*Y + 3 * Z);
+	  // Color coordinates for black are arbitrary. Set them zero.
+	  u  = (n != 0.0)?(4 * X / n):(0.0);
+	  v  = (n != 0.0)?(9 * Y / n):(0.0);
+	  n  = (xn + 15 * yn + 3 * zn);
+	  un = 4 * xn / n;
+	  vn = 4 * yn / n;
+	  u  = 13 * l * (u - un);
+	  v  = 13 * l * (v - vn);
+	  
+	  assert(!isnan(l) && !isnan(u) && !isnan(v));
+	  
+	  c[0][k] = l;
+	  c[1][k] = u;
+	  c[2][k] = v;
+	}
+	break;
       }
-      if (b <= 0.0) {
-	b = 0;
-      } else if (b >= max) {
-	b = 1.0;
-      } else {
-	b = m_pdLookup[ULONG(b)];
-      }
-      //
-      // Note that we need the D65 illuminant, which is the
-      // illuminant of sRGB / Rec. 709.
-      x  = 0.412453 * r + 0.357580 * g + 0.180423 * b;
-      y  = 0.212671 * r + 0.715160 * g + 0.072169 * b;
-      z  = 0.019334 * r + 0.119193 * g + 0.950227 * b;
-      //
-      // Initialize with the D65 white-point.
-      xn = 0.95056;
-      yn = 1.0;
-      zn = 1.089050;
-      //
-      // Compute L*,u*,v*
-      l  = 116.0 * pow(y,1.0/3.0) - 16.0;
-      n  = (x + 15*y + 3 * z);
-      // Color coordinates for black are arbitrary. Set them zero.
-      u  = (n != 0.0)?(4 * x / n):(0.0);
-      v  = (n != 0.0)?(9 * y / n):(0.0);
-      n  = (xn + 15 * yn + 3 * zn);
-      un = 4 * xn / n;
-      vn = 4 * yn / n;
-      u  = 13 * l * (u - un);
-      v  = 13 * l * (v - vn);
-      
-      assert(!isnan(l) && !isnan(u) && !isnan(v));
-      
-      rm.Put(xp,yp,l);
-      gm.Put(xp,yp,u);
-      bm.Put(xp,yp,v);
-#elif defined(LINEAR_YCBCR)
-      DOUBLE yv,cb,cr;
-      DOUBLE rp,gp,bp;
-      //
-      r  /= 255.0;
-      g  /= 255.0;
-      b  /= 255.0;
-      // Linearized RGB/YCbCr
-      rp  = (r <= 0.04045 ? r / 12.92 : pow( (r + 0.055) / 1.055, 2.4));
-      gp  = (g <= 0.04045 ? g / 12.92 : pow( (g + 0.055) / 1.055, 2.4));
-      bp  = (b <= 0.04045 ? b / 12.92 : pow( (b + 0.055) / 1.055, 2.4));
-      //
-      // Transform to linear YCbCr, note that Y is in the *linear* domain.
-      yv =  0.299*rp   + 0.587  *gp + 0.114*bp;
-      cb = -0.16875*r  - 0.33126*g  + 0.5*b;
-      cr =  0.5*r      - 0.41869*g  - 0.08131*b;
-      yv = (yv <= 0.0031308 ? yv * kneeslope : 1.055 * pow( yv, OUTPUT_GAMMA * 1./2.4 ) - 0.055);
-      // Put the stuff back.
-      rm.Put(xp,yp,yv * 255.0);
-      gm.Put(xp,yp,cb * 255.0);
-      bm.Put(xp,yp,cr * 255.0);	
-#else
-      //
-      // Regular YCbCr
-      DOUBLE yv,cb,cr;
-      // Run the RGB->YCbCr transformation
-      yv =  0.299*r   + 0.587  *g + 0.114*b;
-      cb = -0.16875*r - 0.33126*g + 0.5*b;
-      cr =  0.5*r     - 0.41869*g - 0.08131*b;
       // Put the stuff back.
-      rm.Put(xp,yp,yv);
-      gm.Put(xp,yp,cb);
-      bm.Put(xp,yp,cr);
-#endif
+      for(i = 0;i < 3;i++)
+	kernels.Store(c[i],count,row[i] + x);
     }
   }
 }
 ///
 
+/// ColorTransformer::rowTask::Run
+// Transform a stripe of rows.
+void ColorTransformer::rowTask::Run(void)
+{
+  that->TransformRows(*rm,*gm,*bm,y0,y1);
+}
+///
+
+/// ColorTransformer::ForwardsTransform
+// Transform three matrices in place, split into stripes of rows that
+// are transformed in parallel on up to ncpus CPUs.
+void ColorTransformer::ForwardsTransform(class Matrix<FLOAT> &rm,class Matrix<FLOAT> &gm,class Matrix<FLOAT> &bm,
+					 int ncpus)
+{
+  ULONG height = rm.HeightOf();
+  ULONG stripes,s;
+  struct rowTask *tasks;
+  class ThreadJob **jobs;
+  //
+  stripes = (ULONG(ncpus) < height)?(ncpus):(height);
+  if (stripes <= 1) {
+    TransformRows(rm,gm,bm,0,height);
+    return;
+  }
+  //
+  tasks = new struct rowTask[stripes];
+  jobs  = new class ThreadJob *[stripes];
+  for(s = 0;s < stripes;s++) {
+    tasks[s].that = this;
+    tasks[s].rm   = &rm;
+    tasks[s].gm   = &gm;
+    tasks[s].bm   = &bm;
+    tasks[s].y0   = height * s / stripes;
+    tasks[s].y1   = height * (s + 1) / stripes;
+    jobs[s]       = tasks + s;
+  }
+  ThreadPool::Execute(jobs,stripes,ncpus);
+  delete[] jobs;
+  delete[] tasks;
+}
+///
+
 /// ColorTransformer::ForwardsTransform
 // Run a forwards transformation of the data
 // in case we have three or more components. 
 // Run it only on the first three.
-void ColorTransformer::ForwardsTransform(class Image *img)
+void ColorTransformer::ForwardsTransform(class Image *img,int ncpus)
 {
-  FLOAT scale;
   UWORD i,j;
-  ULONG width,height;
-  ULONG max = 0,lmsscale = 0;
   class Component *red,*green,*blue;
   UBYTE levels;
   //
+  if (!PrepareTransform(img))
+    return; // nothing to do.
+  //
+  // Get the components.
+  red    = &img->ComponentOf(0);
+  levels = img->ComponentOf(0).ScalesOf();
+  green  = &img->ComponentOf(1);
+  blue   = &img->ComponentOf(2);
+  //
+  // Now run the transformation process.
+  for(i = 1;i <= levels;i++) {
+    if (i == levels || red->KeepsSubbands() == false) {
+      Matrix<FLOAT> &rm = red->GetScale(i);
+      Matrix<FLOAT> &gm = green->GetScale(i);
+      Matrix<FLOAT> &bm = blue->GetScale(i);
+      ForwardsTransform(rm,gm,bm,ncpus);
+    } else {
+      for(j = 1;j < 3;j++) { 
+	Matrix<FLOAT> &rm = red->GetBand(i,j);
+	Matrix<FLOAT> &gm = green->GetBand(i,j);
+	Matrix<FLOAT> &bm = blue->GetBand(i,j);
+	ForwardsTransform(rm,gm,bm,ncpus);
+      }
+    }
+  }
+}
+///
+
+/// ColorTransformer::PrepareTransform
+// Prepare the forwards transformation of the given image: check its
+// components, create the lookup tables and define the weights of the
+// components. Returns false for grey-scale images.
+bool ColorTransformer::PrepareTransform(class Image *img)
+{
+  FLOAT scale;
+  UWORD i;
+  ULONG width,height;
+  class Component *red,*green,*blue;
+  //
   assert(img);
   if (img->ComponentCountOf() == 1) { 
     img->ComponentOf(0).NameOf()   = "Y";
     img->ComponentOf(0).WeightOf() = 1.0;
-    return; // nothing to do.
+    return false; // nothing to do.
   }
   if (img->ComponentCountOf() < 3)
     Throw(NotImplemented,"ColorTransformer::ForwardsTransform",
@@ -286,18 +337,14 @@ void ColorTransformer::ForwardsTransform(class Image *img)
   //
   // Get the components.
   red    = &img->ComponentOf(0);
-  levels = img->ComponentOf(0).ScalesOf();
   green  = &img->ComponentOf(1);
   blue   = &img->ComponentOf(2);
   assert(red && green && blue);
   //
-#if defined(LUV) || defined(ITP)
-  // Create the input lookup table to convert RGB to R'G'B'.
-  max = (1UL << red->BitDepthOf());
-  CreateLookup(max);
-  // Precision of 16 bit should be hopefully sufficient.
-  CreateLMSLookup(lmsscale = (1UL<<16));
-#endif
+  // Get the lookup tables for the bit depth of the input, they are
+  // built on first use only.
+  if (m_Space != YCbCr)
+    m_pTables = &ColorTables::TablesOf(red->BitDepthOf());
   //
   // Ok, here we have at least three components. Check for their scales. They
   // should be approximately equal.
@@ -315,42 +362,45 @@ void ColorTransformer::ForwardsTransform(class Image *img)
 	    "components have unequal dimensions, cannot transform");
   }
   //
-  // Now run the transformation process.
-  for(i = 1;i <= levels;i++) {
-    if (i == levels || red->KeepsSubbands() == false) {
-      Matrix<FLOAT> &rm = red->GetScale(i);
-      Matrix<FLOAT> &gm = green->GetScale(i);
-      Matrix<FLOAT> &bm = blue->GetScale(i);
-      ForwardsTransform(rm,gm,bm,max,lmsscale);
-    } else {
-      for(j = 1;j < 3;j++) { 
-	Matrix<FLOAT> &rm = red->GetBand(i,j);
-	Matrix<FLOAT> &gm = green->GetBand(i,j);
-	Matrix<FLOAT> &bm = blue->GetBand(i,j);
-	ForwardsTransform(rm,gm,bm,max,lmsscale);
-      }
-    }
-  }
-  img->ComponentOf(1).IsSigned() = true;
-  img->ComponentOf(2).IsSigned() = true; 
+  green->IsSigned() = true;
+  blue->IsSigned()  = true; 
   //
   // Define the weights - used from the current reference implementation.
-#if defined(ITP)
-  // TO BE DONE
-#elif defined(LINEAR_YCBCR)
-  img->ComponentOf(0).WeightOf() = 0.91;
-  img->ComponentOf(1).WeightOf() = 0.02;
-  img->ComponentOf(2).WeightOf() = 0.07;
-  img->ComponentOf(0).NameOf()   = "Y";
-  img->ComponentOf(1).NameOf()   = "Cb";
-  img->ComponentOf(2).NameOf()   = "Cr"; 
-#else
-  img->ComponentOf(0).WeightOf() = 0.95;
-  img->ComponentOf(1).WeightOf() = 0.02;
-  img->ComponentOf(2).WeightOf() = 0.03;
-  img->ComponentOf(0).NameOf()   = "Y";
-  img->ComponentOf(1).NameOf()   = "Cb";
-  img->ComponentOf(2).NameOf()   = "Cr";
-#endif      
+  switch(m_Space) {
+  case LinearYCbCr:
+    img->ComponentOf(0).WeightOf() = 0.91;
+    img->ComponentOf(1).WeightOf() = 0.02;
+    img->ComponentOf(2).WeightOf() = 0.07;
+    img->ComponentOf(0).NameOf()   = "Y";
+    img->ComponentOf(1).NameOf()   = "Cb";
+    img->ComponentOf(2).NameOf()   = "Cr";
+    break;
+  case ITP:
+    // No weights of its own yet, use those of YCbCr.
+    img->ComponentOf(0).WeightOf() = 0.95;
+    img->ComponentOf(1).WeightOf() = 0.02;
+    img->ComponentOf(2).WeightOf() = 0.03;
+    img->ComponentOf(0).NameOf()   = "I";
+    img->ComponentOf(1).NameOf()   = "P";
+    img->ComponentOf(2).NameOf()   = "T";
+    break;
+  case LUV:
+    img->ComponentOf(0).WeightOf() = 0.95;
+    img->ComponentOf(1).WeightOf() = 0.02;
+    img->ComponentOf(2).WeightOf() = 0.03;
+    img->ComponentOf(0).NameOf()   = "L";
+    img->ComponentOf(1).NameOf()   = "u";
+    img->ComponentOf(2).NameOf()   = "v";
+    break;
+  case YCbCr:
+    img->ComponentOf(0).WeightOf() = 0.95;
+    img->ComponentOf(1).WeightOf() = 0.02;
+    img->ComponentOf(2).WeightOf() = 0.03;
+    img->ComponentOf(0).NameOf()   = "Y";
+    img->ComponentOf(1).NameOf()   = "Cb";
+    img->ComponentOf(2).NameOf()   = "Cr";
+    break;
+  }
+  return true;
 }
 ///
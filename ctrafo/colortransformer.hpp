@@ -34,53 +34,94 @@
 #include "img/image.hpp"
 #include "std/math.hpp"
 #include "global/matrix.hpp"
+#include "global/threadpool.hpp"
 ///
 
 /// ColorTransformer
 // This class describes a simplistic color transformer
-// for RGB->YC_bC_r transformation.
+// for RGB->YC_bC_r transformation, or into one of the other
+// supported color spaces.
 class ColorTransformer {
+public:
   //
-  // The lookup table used for the transfer function lookup.
-  DOUBLE *m_pdLookup;
+  // The color spaces the indices may work in.
+  enum ColorSpace {
+    YCbCr,       // regular YCbCr
+    LinearYCbCr, // YCbCr with the luma computed from linear RGB
+    ITP,         // IPT, via the LMS space
+    LUV          // CIE L*u*v*
+  };
   //
-  // The lookup table for the LMS transfer function.
-  DOUBLE *m_pdLMS;
+private:
   //
-  // The RGB->R'B'G' transfer function
-  static DOUBLE sRGBTransfer(DOUBLE in,DOUBLE scale)
-  {
-    if (in < 0.04045 * scale) {
-      // The linear region
-      return in / (12.92 * scale);
-    } else {
-      return pow((in / scale + 0.055) / 1.055,2.4);
-    }
-  }
+  // The color space to transform to.
+  ColorSpace                m_Space;
   //
-  // The LMS to L'M'S' lookup function.
-  static DOUBLE LMSTransfer(DOUBLE in)
-  {
-    return pow(in,0.43);
-  }
+  // The lookup tables of the nonlinear steps, for the bit depth of
+  // the image the transformation is prepared for. These are shared,
+  // and not needed for regular YCbCr.
+  const class ColorTables  *m_pTables;
+  //
+  // The rows are transformed in chunks of this many pixels, which are
+  // kept in double precision buffers on the stack.
+  enum {
+    ChunkSize = 256
+  };
   //
-  // Create the lookup table.
-  void CreateLookup(ULONG scale);
+  // This structure transforms a stripe of rows of three matrices.
+  // Rows are independent, hence stripes can be transformed in parallel.
+  struct rowTask : public ThreadJob {
+    const class ColorTransformer *that;
+    class Matrix<FLOAT>          *rm,*gm,*bm;
+    ULONG                         y0,y1;
+    //
+    // Transform the rows.
+    virtual void Run(void);
+  };
   //
-  // Create the LMS lookup table.
-  void CreateLMSLookup(ULONG scale);
+  // Transform the rows y0 up to but excluding y1 of three matrices.
+  void TransformRows(class Matrix<FLOAT> &rm,class Matrix<FLOAT> &gm,class Matrix<FLOAT> &bm,
+		     ULONG y0,ULONG y1) const;
   //
-  // Transform a single matrix
+  // Transform three matrices in stripes of rows on up to ncpus CPUs.
   void ForwardsTransform(class Matrix<FLOAT> &rm,class Matrix<FLOAT> &gm,class Matrix<FLOAT> &bm,
-			 ULONG max,ULONG lmsscale);
+			 int ncpus);
   //
 public:
-  ColorTransformer(void);
+  ColorTransformer(ColorSpace space = YCbCr);
   ~ColorTransformer(void);
   //
+  // Return the color space to transform to, as lvalue.
+  ColorSpace &SpaceOf(void)
+  {
+    return m_Space;
+  }
+  //
+  // Return a printable name of the color space.
+  static const char *NameOf(ColorSpace space);
+  //
+  // Parse a color space name as returned by NameOf. Returns false if the
+  // name is not known.
+  static bool ParseColorSpace(const char *name,ColorSpace &space);
+  //
   // Forwards transform, i.e. RGB->YC_bC_r
-  // This touches only the first three components.
-  void ForwardsTransform(class Image *img);
+  // This touches only the first three components. The rows of the
+  // scales are transformed in parallel on up to ncpus CPUs.
+  void ForwardsTransform(class Image *img,int ncpus = 1);
+  //
+  // Prepare the forwards transformation of the given image without
+  // touching its scales, i.e. check its components and define their
+  // weights and names. Returns false if the image is grey-scale and
+  // requires no transformation.
+  bool PrepareTransform(class Image *img);
+  //
+  // Transform the three matrices of the first three components in
+  // place, once the transformation is prepared. This is used for
+  // images whose scales are streamed rather than kept.
+  void ForwardsTransform(class Matrix<FLOAT> &rm,class Matrix<FLOAT> &gm,class Matrix<FLOAT> &bm)
+  {
+    TransformRows(rm,gm,bm,0,rm.HeightOf());
+  }
 };
 ///
 
@@ -0,0 +1,118 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+/// Includes
+#include "global/cpu.hpp"
+#include "std/string.hpp"
+#include "std/stdlib.hpp"
+///
+
+/// Statics
+CPU::Extension CPU::m_Detected  = CPU::Scalar;
+CPU::Extension CPU::m_Limit     = CPU::AVX512;
+bool           CPU::m_bDetected = false;
+#ifndef NO_POSIX
+pthread_once_t CPU::m_DetectOnce = PTHREAD_ONCE_INIT;
+#endif
+///
+
+/// CPU::Detect
+// Run the CPUID based detection.
+CPU::Extension CPU::Detect(void)
+{
+#ifdef USE_X86_SIMD
+  __builtin_cpu_init();
+  //
+  // Note that the GNU runtime also checks whether the operating system
+  // saves the extended register state.
+  if (__builtin_cpu_supports("avx512f"))
+    return AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return AVX2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return SSE42;
+#endif
+  return Scalar;
+}
+///
+
+/// CPU::RunDetection
+// Run the detection and keep its result.
+void CPU::RunDetection(void)
+{
+  m_Detected  = Detect();
+  m_bDetected = true;
+}
+///
+
+/// CPU::ExtensionOf
+// Return the widest extension available on this CPU, and not excluded
+// by the user.
+CPU::Extension CPU::ExtensionOf(void)
+{
+  // The first kernel lookups may come from several threads of the pool,
+  // the detection must only run once and be complete for all of them.
+#ifndef NO_POSIX
+  pthread_once(&m_DetectOnce,&CPU::RunDetection);
+#else
+  if (!m_bDetected)
+    RunDetection();
+#endif
+  return (m_Detected < m_Limit)?(m_Detected):(m_Limit);
+}
+///
+
+/// CPU::NameOf
+// Return a printable name of the extension.
+const char *CPU::NameOf(Extension ext)
+{
+  switch(ext) {
+  case Scalar:
+    return "scalar";
+  case SSE42:
+    return "sse4.2";
+  case AVX2:
+    return "avx2";
+  case AVX512:
+    return "avx512";
+  }
+  return "unknown";
+}
+///
+
+/// CPU::ParseExtension
+// Parse an extension name as returned by NameOf.
+bool CPU::ParseExtension(const char *name,Extension &ext)
+{
+  int i;
+
+  for(i = Scalar;i <= AVX512;i++) {
+    if (!strcmp(name,NameOf(Extension(i)))) {
+      ext = Extension(i);
+      return true;
+    }
+  }
+  return false;
+}
+///
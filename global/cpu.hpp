@@ -0,0 +1,105 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+#ifndef GLOBAL_CPU_HPP
+#define GLOBAL_CPU_HPP
+
+/// Includes
+#include "global/types.hpp"
+#ifndef NO_POSIX
+#include <pthread.h>
+#endif
+///
+
+/// Defines
+// Vectorized kernels are compiled by means of the GNU target attributes,
+// hence require a GNU compatible compiler on an x86 CPU. They can be
+// disabled by defining NO_SIMD.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && !defined(NO_SIMD)
+#define USE_X86_SIMD 1
+#endif
+///
+
+/// class CPU
+// This class detects the vector extensions of the CPU we are running on,
+// such that the widest available kernel implementation can be picked at
+// run time. Detection happens once, on first request, even if the first
+// requests come from several threads at once.
+class CPU {
+public:
+  //
+  // The vector extensions we provide kernels for, ordered by width.
+  enum Extension {
+    Scalar = 0, // plain C++ code, the reference implementation
+    SSE42  = 1, // 128 bit SSE up to SSE 4.2
+    AVX2   = 2, // 256 bit AVX2
+    AVX512 = 3  // 512 bit AVX-512 foundation
+  };
+  //
+private:
+  //
+  // The extension found by the CPUID detection.
+  static Extension m_Detected;
+  //
+  // The widest extension the user allows to be used.
+  static Extension m_Limit;
+  //
+  // Set once the detection ran.
+  static bool      m_bDetected;
+#ifndef NO_POSIX
+  //
+  // Runs the detection exactly once.
+  static pthread_once_t m_DetectOnce;
+#endif
+  //
+  // Run the CPUID based detection.
+  static Extension Detect(void);
+  //
+  // Run the detection and keep its result.
+  static void RunDetection(void);
+  //
+public:
+  //
+  // Return the widest extension available on this CPU, and not excluded
+  // by the user.
+  static Extension ExtensionOf(void);
+  //
+  // Restrict the extensions to the given one, e.g. to run the scalar
+  // reference code on a vector capable CPU.
+  static void LimitExtension(Extension limit)
+  {
+    m_Limit = limit;
+  }
+  //
+  // Return a printable name of the extension.
+  static const char *NameOf(Extension ext);
+  //
+  // Parse an extension name as returned by NameOf. Returns false if the
+  // name is not known.
+  static bool ParseExtension(const char *name,Extension &ext);
+};
+///
+
+///
+#endif
@@ -98,27 +98,30 @@ public:
   }
   //
   // Allocator for a matrix with given dimensions.
+  // Rows are padded to cache lines, see EntriesPerRowOf.
   Matrix(ULONG w,ULONG h)
-    : MatrixBase(w * h * sizeof(Entry))
+    : MatrixBase(EntriesPerRowOf(w,sizeof(Entry)) * h * sizeof(Entry))
   { 
     assert(ElementTraits<Entry>::isValid);
     m_pEntries = static_cast<Entry *>(m_pMemory->m_pMem);
     m_ulWidth         = w;
     m_ulHeight        = h;
-    m_ulEntriesPerRow = w;
+    m_ulEntriesPerRow = EntriesPerRowOf(w,sizeof(Entry));
   }
   //
   // Allocate a matrix that has been empty before.
   void Allocate(ULONG width,ULONG height)
   {
+    ULONG stride = EntriesPerRowOf(width,sizeof(Entry));
+    //
     assert(m_pMemory == NULL);
     //
     // First get the memory
-    MatrixBase::Allocate(width * height * sizeof(Entry));
+    MatrixBase::Allocate(stride * height * sizeof(Entry));
     m_pEntries = static_cast<Entry *>(m_pMemory->m_pMem);
     m_ulWidth         = width;
     m_ulHeight        = height;
-    m_ulEntriesPerRow = width;
+    m_ulEntriesPerRow = stride;
   }
   //
   // Release the memory of a matrix explicitly.
@@ -180,6 +183,34 @@ public:
     m_ulHeight = h;
   }
   //
+  // Return the number of entries a matrix of the given dimensions takes
+  // when carved from a larger block of memory. Rows are padded as for an
+  // allocated matrix, and blocks that are a multiple of the alias size
+  // are padded by one more cache line.
+  static size_t SizeOf(ULONG w,ULONG h)
+  {
+    size_t entries = size_t(EntriesPerRowOf(w,sizeof(Entry))) * h;
+    //
+    if (entries > 0 && CacheLine % sizeof(Entry) == 0 && ((entries * sizeof(Entry)) & (AliasSize - 1)) == 0)
+      entries += CacheLine / sizeof(Entry);
+    //
+    return entries;
+  }
+  //
+  // Assign this matrix to a block of memory of another matrix, starting
+  // at the given number of entries behind its origin, then sharing the
+  // memory between the two. The block takes SizeOf(w,h) entries.
+  void Carve(Matrix<Entry> &o,size_t offset,ULONG w,ULONG h)
+  {
+    assert(offset + SizeOf(w,h) <= size_t(o.m_ulEntriesPerRow) * o.m_ulHeight);
+    //
+    MatrixBase::operator=(o);
+    m_pEntries = o.m_pEntries + offset;
+    m_ulEntriesPerRow = EntriesPerRowOf(w,sizeof(Entry));
+    m_ulWidth  = w;
+    m_ulHeight = h;
+  }
+  //
   // Get: Extract an element from the matrix
   Entry Get(ULONG x,ULONG y) const
   {
@@ -231,13 +262,15 @@ public:
   // old contents is lost. This only works for PODs.
   void DuplicateFrom(const Matrix<Entry> &o)
   {
-    Allocate(o.m_ulWidth * o.m_ulHeight * sizeof(Entry));
+    ULONG stride = EntriesPerRowOf(o.m_ulWidth,sizeof(Entry));
+    //
+    MatrixBase::Allocate(stride * o.m_ulHeight * sizeof(Entry));
     //
     m_ulWidth         = o.m_ulWidth;
     m_ulHeight        = o.m_ulHeight;
-    m_ulEntriesPerRow = o.m_ulWidth;
+    m_ulEntriesPerRow = stride;
     m_pEntries        = static_cast<Entry *>(m_pMemory->m_pMem);
-    if (o.m_ulWidth == o.m_ulEntriesPerRow) {
+    if (stride == o.m_ulWidth && o.m_ulWidth == o.m_ulEntriesPerRow) {
       memcpy(m_pEntries,o.m_pEntries,
 	     o.m_ulEntriesPerRow * o.m_ulHeight * sizeof(Entry));
     } else {
@@ -21,3 +21,47 @@
  **				thor@math.tu-berlin.de                             **
  **                                                                                **
  ************************************************************************************/
+
+/// Includes
+#include "global/matrixbase.hpp"
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES > 0
+#include <sys/mman.h>
+#endif
+///
+
+/// Statics
+ULONG MatrixBase::m_ulColor = 0;
+///
+
+/// MatrixBase::MemKeeper::MemKeeper
+// Allocate memory aligned to a cache line. Blocks larger than the alias
+// size are offset by a varying number of cache lines, otherwise the
+// blocks of two images of the same size would start at the same offset
+// to the page, and their rows would compete for the same cache sets.
+// Blocks of at least a huge page are aligned to huge pages, and the
+// kernel is advised to back them by transparent huge pages.
+MatrixBase::MemKeeper::MemKeeper(size_t size)
+  : m_pBase(NULL), m_pMem(NULL), m_ulRefCount(1)
+{
+  size_t align  = (size >= HugePageSize)?(HugePageSize):(CacheLine);
+  size_t offset = 0;
+  size_t addr;
+  //
+  if (size >= AliasSize)
+    offset = (__sync_add_and_fetch(&m_ulColor,1) % (AliasSize / CacheLine)) * CacheLine;
+  //
+  m_pBase = malloc(size + offset + align - 1);
+  if (m_pBase == NULL)
+    Throw(NoMem,"MemKeeper::MemKeeper","out of memory");
+  //
+  addr   = (size_t(m_pBase) + align - 1) & ~(align - 1);
+#if defined(MADV_HUGEPAGE)
+  if (align == HugePageSize)
+    madvise((void *)addr,(size + offset) & ~(align - 1),MADV_HUGEPAGE);
+#endif
+  m_pMem = (APTR)(addr + offset);
+}
+///
@@ -48,21 +48,20 @@ class MatrixBase {
   //
 protected:  
   // Memory management for the entry data. This holds the memory
-  // to be kept here.
+  // to be kept here. The memory is aligned to a cache line, and large
+  // blocks are offset by a varying number of cache lines, such that
+  // the same rows of matrices of equal size do not map to the same
+  // cache sets.
   struct MemKeeper {
+    APTR   m_pBase;      // what has been allocated
     APTR   m_pMem;       // where's the memory held?
     ULONG  m_ulRefCount; // reference counter
     //
-    MemKeeper(size_t size)
-      : m_pMem(malloc(size)), m_ulRefCount(1)
-    { 
-      if (m_pMem == NULL)
-	Throw(NoMem,"MemKeeper::MemKeeper","out of memory");
-    }
+    MemKeeper(size_t size);
     //
     ~MemKeeper(void)
     {
-      free(m_pMem);
+      free(m_pBase);
     }
   }   *m_pMemory;
   //
@@ -77,6 +76,35 @@ protected:
   // At least for consistency checking, we should.
   ULONG m_ulWidth,m_ulHeight;
   //
+  // The alignment of the memory and the rows.
+  enum {
+    CacheLine     = 64,
+    AliasSize     = 4096,    // distance of addresses mapping to the same L1 set
+    HugePageSize  = 1UL << 21
+  };
+  //
+  // The offset of the next large block, in cache lines.
+  static ULONG m_ulColor;
+  //
+  // Return the number of entries per row of a matrix of the given width
+  // whose entries have the given size. Rows are padded to full cache
+  // lines, and by one more if the row would be a multiple of the alias
+  // size.
+  static ULONG EntriesPerRowOf(ULONG width,size_t entrysize)
+  {
+    size_t bytes = width * entrysize;
+    //
+    // Entries that do not tile a cache line are not padded.
+    if (CacheLine % entrysize)
+      return width;
+    //
+    bytes = (bytes + CacheLine - 1) & ~size_t(CacheLine - 1);
+    if (bytes >= AliasSize && (bytes & (AliasSize - 1)) == 0)
+      bytes += CacheLine;
+    //
+    return bytes / entrysize;
+  }
+  //
   // Build a new matrix allocating the indicated amount of storage.
   MatrixBase(size_t size)
     : m_pMemory(new MemKeeper(size))
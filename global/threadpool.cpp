@@ -0,0 +1,248 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class implements a process wide pool of worker threads that
+** run jobs submitted by the quality indices.
+*/
+
+/// Includes
+#include "global/threadpool.hpp"
+#include "global/exceptions.hpp"
+#include "global/cpu.hpp"
+#include "std/assert.hpp"
+///
+
+/// Statics
+class ThreadPool *ThreadPool::m_pPool = NULL;
+///
+
+/// ThreadPool::ThreadPool
+// Create a pool with the given number of workers.
+ThreadPool::ThreadPool(int workers)
+#ifndef NO_POSIX
+  : m_pWorkers(NULL), m_iWorkers(0), m_pHead(NULL), m_pTail(NULL), m_bQuit(false)
+#endif
+{
+#ifndef NO_POSIX
+  pthread_mutex_init(&m_Lock,NULL);
+  pthread_cond_init(&m_Work,NULL);
+  pthread_cond_init(&m_Done,NULL);
+  //
+  m_pWorkers = new pthread_t[workers];
+  while(m_iWorkers < workers) {
+    if (pthread_create(m_pWorkers + m_iWorkers,NULL,&ThreadPool::pthread_entry,this))
+      break; // Run with what we have, the caller works as well.
+    m_iWorkers++;
+  }
+#else
+  (void)workers; // jobs are run by the caller
+#endif
+}
+///
+
+/// ThreadPool::~ThreadPool
+ThreadPool::~ThreadPool(void)
+{
+#ifndef NO_POSIX
+  int i;
+  //
+  pthread_mutex_lock(&m_Lock);
+  m_bQuit = true;
+  pthread_cond_broadcast(&m_Work);
+  pthread_mutex_unlock(&m_Lock);
+  //
+  for(i = 0;i < m_iWorkers;i++) {
+    pthread_join(m_pWorkers[i],NULL);
+  }
+  delete[] m_pWorkers;
+  //
+  pthread_cond_destroy(&m_Done);
+  pthread_cond_destroy(&m_Work);
+  pthread_mutex_destroy(&m_Lock);
+#endif
+}
+///
+
+/// ThreadPool::CreatePool
+// Create the process wide pool, able to run ncpus jobs in parallel.
+void ThreadPool::CreatePool(int ncpus)
+{
+  int workers = (ncpus > 1)?(ncpus - 1):(0);
+  //
+  // The pool is created by the main thread only, before any jobs
+  // are submitted.
+  assert(m_pPool == NULL);
+  //
+  if (m_pPool == NULL)
+    m_pPool = new class ThreadPool(workers);
+}
+///
+
+/// ThreadPool::ReleasePool
+// Release the process wide pool and terminate its workers.
+void ThreadPool::ReleasePool(void)
+{
+  delete m_pPool;
+  m_pPool = NULL;
+}
+///
+
+#ifndef NO_POSIX
+/// ThreadPool::Dequeue
+// Remove the first job from the queue. Must be called with the lock held.
+class ThreadJob *ThreadPool::Dequeue(void)
+{
+  class ThreadJob *job = m_pHead;
+
+  if (job) {
+    m_pHead = job->m_pNext;
+    if (m_pHead == NULL)
+      m_pTail = NULL;
+    job->m_pNext = NULL;
+  }
+  return job;
+}
+///
+
+/// ThreadPool::Complete
+// Run a job, then mark it as completed. Must be called with the lock held,
+// releases it while the job runs.
+void ThreadPool::Complete(class ThreadJob *job)
+{
+  pthread_mutex_unlock(&m_Lock);
+  job->Run();
+  pthread_mutex_lock(&m_Lock);
+  //
+  assert(*job->m_pulPending > 0);
+  if (--*job->m_pulPending == 0)
+    pthread_cond_broadcast(&m_Done);
+}
+///
+
+/// ThreadPool::pthread_entry
+// The entry point of the worker threads.
+void *ThreadPool::pthread_entry(void *arg)
+{
+  class ThreadPool *that = (class ThreadPool *)arg;
+  class ThreadJob *job;
+
+  pthread_mutex_lock(&that->m_Lock);
+  for(;;) {
+    if ((job = that->Dequeue())) {
+      that->Complete(job);
+    } else if (that->m_bQuit) {
+      break;
+    } else {
+      pthread_cond_wait(&that->m_Work,&that->m_Lock);
+    }
+  }
+  pthread_mutex_unlock(&that->m_Lock);
+
+  return NULL;
+}
+///
+#endif
+
+/// ThreadPool::Execute
+// Run the given jobs in parallel and return when all of them have
+// completed.
+void ThreadPool::Execute(class ThreadJob *const *jobs,int count)
+{
+  int i;
+#ifndef NO_POSIX
+  if (m_iWorkers > 0 && count > 1) {
+    ULONG pending = count;
+    class ThreadJob *job;
+    //
+    pthread_mutex_lock(&m_Lock);
+    for(i = 0;i < count;i++) {
+      jobs[i]->m_pulPending = &pending;
+      jobs[i]->m_pNext      = NULL;
+      if (m_pTail) {
+	m_pTail->m_pNext = jobs[i];
+      } else {
+	m_pHead = jobs[i];
+      }
+      m_pTail = jobs[i];
+    }
+    pthread_cond_broadcast(&m_Work);
+    //
+    // Participate in the work until our batch is done. Jobs of other
+    // batches may be run here as well, which is harmless.
+    while(pending > 0) {
+      if ((job = Dequeue())) {
+	Complete(job);
+      } else {
+	pthread_cond_wait(&m_Done,&m_Lock);
+      }
+    }
+    pthread_mutex_unlock(&m_Lock);
+    return;
+  }
+#endif
+  for(i = 0;i < count;i++) {
+    jobs[i]->Run();
+  }
+}
+///
+
+/// ThreadPool::Execute
+// Run the given jobs on at most ncpus CPUs.
+void ThreadPool::Execute(class ThreadJob *const *jobs,int count,int ncpus)
+{
+  if (ncpus > 1 && m_pPool) {
+    m_pPool->Execute(jobs,count);
+  } else {
+    int i;
+    for(i = 0;i < count;i++) {
+      jobs[i]->Run();
+    }
+  }
+}
+///
+
+/// ThreadPool::StripeHeightOf
+// Return the height of the horizontal stripes an image of the given
+// number of rows is partitioned into for parallel processing.
+ULONG ThreadPool::StripeHeightOf(ULONG rows,ULONG bytesperrow,ULONG halo)
+{
+  // The stripe and its halo take up to StripeBytes of input, which is
+  // fixed such that the partitioning and thus the result do not depend
+  // on the machine.
+  ULONG fit    = ULONG(StripeBytes) / ((bytesperrow > 0)?(bytesperrow):(1));
+  ULONG height = (fit > halo)?(fit - halo):(0);
+  //
+  // Spend at most a fraction of the time on the halo, even if this
+  // exceeds the budget for wide rows.
+  if (height < HaloRatio * halo)
+    height = HaloRatio * halo;
+  if (height < ULONG(MinStripeRows))
+    height = MinStripeRows;
+  if (height > rows)
+    height = rows;
+  if (height < 1)
+    height = 1;
+  return height;
+}
+///
@@ -0,0 +1,157 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class implements a process wide pool of worker threads that
+** run jobs submitted by the quality indices, such that threads are
+** only created once and not for every scale, component and band.
+*/
+
+#ifndef GLOBAL_THREADPOOL_HPP
+#define GLOBAL_THREADPOOL_HPP
+
+/// Includes
+#include "global/types.hpp"
+#ifndef NO_POSIX
+extern "C" {
+#include <pthread.h>
+}
+#endif
+///
+
+/// class ThreadJob
+// A unit of work that can be run by the thread pool. Derive from this
+// class and implement Run() to define what the job computes.
+class ThreadJob {
+  friend class ThreadPool;
+  //
+  // The next job in the queue of the pool.
+  class ThreadJob *m_pNext;
+  //
+  // The number of pending jobs of the batch this job belongs to.
+  ULONG           *m_pulPending;
+  //
+public:
+  ThreadJob(void)
+    : m_pNext(NULL), m_pulPending(NULL)
+  { }
+  //
+  virtual ~ThreadJob(void)
+  { }
+  //
+  // Perform the work of this job.
+  virtual void Run(void) = 0;
+};
+///
+
+/// class ThreadPool
+// The pool of worker threads. The pool is created once by the main
+// thread before any jobs are run, and the submitting thread participates
+// in running the jobs, hence a pool of n CPUs consists of n-1 workers
+// plus the caller.
+class ThreadPool {
+  //
+#ifndef NO_POSIX
+  // The worker threads.
+  pthread_t       *m_pWorkers;
+  //
+  // The number of worker threads.
+  int              m_iWorkers;
+  //
+  // Protects the queue and the pending counters.
+  pthread_mutex_t  m_Lock;
+  //
+  // Signalled when new jobs arrive in the queue, or the pool shuts down.
+  pthread_cond_t   m_Work;
+  //
+  // Signalled when a batch completed.
+  pthread_cond_t   m_Done;
+  //
+  // The queue of jobs not yet started.
+  class ThreadJob *m_pHead;
+  class ThreadJob *m_pTail;
+  //
+  // Set on destruction to terminate the workers.
+  bool             m_bQuit;
+  //
+  // The entry point of the worker threads.
+  static void *pthread_entry(void *arg);
+  //
+  // Remove the first job from the queue. Must be called with the lock held.
+  class ThreadJob *Dequeue(void);
+  //
+  // Run a job, then mark it as completed. Must be called with the lock held,
+  // releases it while the job runs.
+  void Complete(class ThreadJob *job);
+#endif
+  //
+  // The process wide pool.
+  static class ThreadPool *m_pPool;
+  //
+  // The input budget of a stripe in bytes, the least ratio of stripe
+  // height to halo, and the least stripe height.
+  enum {
+    StripeBytes   = 512 * 1024,
+    HaloRatio     = 4,
+    MinStripeRows = 16
+  };
+  //
+  // Create a pool with the given number of workers.
+  ThreadPool(int workers);
+  //
+public:
+  //
+  ~ThreadPool(void);
+  //
+  // Create the process wide pool, able to run ncpus jobs in parallel.
+  // This must be called from the main thread before any jobs are run,
+  // and only once until the pool is released. Without a pool, all jobs
+  // are run by the caller.
+  static void CreatePool(int ncpus);
+  //
+  // Release the process wide pool and terminate its workers.
+  static void ReleasePool(void);
+  //
+  // Run the given jobs in parallel and return when all of them have
+  // completed. The caller runs jobs as well, hence jobs may submit
+  // jobs themselves without risking a dead lock.
+  void Execute(class ThreadJob *const *jobs,int count);
+  //
+  // Run the given jobs on at most ncpus CPUs. For a single CPU, or if no
+  // pool has been created, the jobs are run in order by the caller. The
+  // pool is never created or replaced here, as this may be called from
+  // jobs running on the pool.
+  static void Execute(class ThreadJob *const *jobs,int count,int ncpus);
+  //
+  // Return the height of the horizontal stripes an image of the given
+  // number of rows is partitioned into for parallel processing. Each
+  // stripe additionally reads halo rows below its last row, the stripe
+  // height is selected such that the stripe input, bytesperrow per row,
+  // stays within a fixed budget, but at least HaloRatio times the halo.
+  // The height only depends on the arguments, never on the machine.
+  static ULONG StripeHeightOf(ULONG rows,ULONG bytesperrow,ULONG halo);
+};
+///
+
+///
+#endif
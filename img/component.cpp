@@ -29,13 +29,18 @@
 
 /// Includes
 #include "img/component.hpp"
+#include "wavelet/lineslab.hpp"
+#include "wavelet/bandarena.hpp"
 ///
 
 /// Component::Component
 // Build a new component with given dimensions.
-Component::Component(ULONG width,ULONG height,bool sign,UBYTE depth,FLOAT scale,UBYTE decdepth,bool keephp)
-  : m_Band(width,height,decdepth-1,keephp),
-    m_bIsSigned(sign), m_fMaxScale(scale), m_ucBitDepth(depth),
+Component::Component(ULONG width,ULONG height,bool sign,UBYTE depth,UBYTE fraction,FLOAT scale,
+		     UBYTE decdepth,bool keephp)
+  : m_pSlab(LineSlab::Acquire(width,decdepth-1,Band::LinesPerBand())),
+    m_pArena(NULL),
+    m_Band(width,height,decdepth-1,keephp,m_pSlab),
+    m_bIsSigned(sign), m_fMaxScale(scale), m_ucBitDepth(depth), m_ucFraction(fraction),
     m_dWeight(1.0), m_pcName("Y")
 {
 }
@@ -45,6 +50,23 @@ Component::Component(ULONG width,ULONG height,bool sign,UBYTE depth,FLOAT scale,
 // Release the component again.
 Component::~Component(void)
 {
+  // The bands no longer touch their lines, hence the slab can be
+  // recycled before they go.
+  LineSlab::Recycle(m_pSlab);
+  //
+  // The matrices of the bands keep the memory of the arena alive, and
+  // no longer change.
+  BandArena::Recycle(m_pArena);
+}
+///
+
+/// Component::AcquireArena
+// Acquire the arena for the matrices of the band hierarchy.
+void Component::AcquireArena(void)
+{
+  m_pArena = BandArena::Acquire(m_Band.WidthOf(),m_Band.HeightOf(),m_Band.ResolutionOf(),
+				m_Band.KeepsSubbands(),m_Band.IsStreaming());
+  m_Band.UseArena(m_pArena);
 }
 ///
 
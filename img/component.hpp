@@ -42,6 +42,15 @@
 // We also could support arbitrary data types, but that
 // just makes things more complicated.
 class Component {
+  //
+  // The slab providing the lines of the band hierarchy. This must be
+  // constructed before the bands.
+  class LineSlab *m_pSlab;
+  //
+  // The arena providing the matrices of the band hierarchy. This is
+  // acquired along with the first line, once it is known whether the
+  // bands stream their lines.
+  class BandArena *m_pArena;
   //
   // The hierarchy of bands in here.
   class Band  m_Band;
@@ -58,18 +67,27 @@ class Component {
   // The bit depth of this component, resulting in the above scale.
   UBYTE       m_ucBitDepth;
   //
+  // The number of fractional bits of the samples, included in the
+  // above bit depth and scale.
+  UBYTE       m_ucFraction;
+  //
   // The component weight in the final assignment/computation of the SSIM
   DOUBLE      m_dWeight;
   //
   // Name of this component.
   const char *m_pcName;
   //
+  // Acquire the arena for the matrices of the band hierarchy.
+  void AcquireArena(void);
+  //
 public:
   // Unlike the matrix, the component really
   // carries the data with it. Thus, we need to give
   // width and height if we want to handle components.
-  // Also requires the bit depth and the decomposition depth of the band in here.
-  Component(ULONG width,ULONG height,BOOL sign,UBYTE bitdepth,FLOAT scale,UBYTE decdepth,bool keephp);
+  // Also requires the bit depth, the number of fractional bits within it,
+  // and the decomposition depth of the band in here.
+  Component(ULONG width,ULONG height,BOOL sign,UBYTE bitdepth,UBYTE fraction,FLOAT scale,
+	    UBYTE decdepth,bool keephp);
   //
   // Ditto. Also destroys the matrix data.
   ~Component(void);
@@ -93,6 +111,13 @@ public:
     return m_ucBitDepth;
   }
   //
+  // Return the number of fractional bits of the samples, i.e. the
+  // samples are scaled by 1 << FractionOf() over those of the image.
+  UBYTE FractionOf(void) const
+  {
+    return m_ucFraction;
+  }
+  //
   bool KeepsSubbands(void) const
   {
     return m_Band.KeepsSubbands();
@@ -103,9 +128,20 @@ public:
   // line carries a sample.
   void PushLine(const class Line *line)
   {
+    if (m_pArena == NULL)
+      AcquireArena();
     m_Band.PushLine(line);
   }
   //
+  // Hand the lines of all scales to the given sink as soon as they are
+  // available instead of keeping them. The scales of the component are
+  // then not available. This must be called before the first line is
+  // pushed.
+  void StreamTo(class LineSink *sink)
+  {
+    m_Band.StreamTo(sink);
+  }
+  //
   // Return the dimensions of the component.
   ULONG WidthOf(void) const
   {
@@ -35,6 +35,7 @@
 #include "std/stdio.hpp"
 #include "std/math.hpp"
 #include "io/bytestream.hpp"
+#include "img/pixelkernels.hpp"
 ///
 
 /// logint2
@@ -56,7 +57,9 @@ static int logint2(unsigned int v)
 /// Image::Image
 // Create a new image
 Image::Image(void)
-  : m_usComponents(0), m_ppComponentArray(NULL), m_ppLineArray(NULL)
+  : m_usComponents(0), m_ppComponentArray(NULL), m_ppLineArray(NULL),
+    m_pInput(NULL), m_lWidth(0), m_lHeight(0), m_lPrecision(0), m_lRow(0),
+    m_ulRowBytes(0), m_pucRow(NULL), m_pUnpack(NULL)
 {
 }
 ///
@@ -74,11 +77,12 @@ Image::~Image(void)
   } 
   if (m_ppLineArray) {
     UWORD i;
-    for(i=0;i<m_usComponents;i++) {
+    for(i=0;i<m_usComponents * BlockLines;i++) {
       delete m_ppLineArray[i];
     }
     delete[] m_ppLineArray;
   }
+  delete[] m_pucRow;
 }
 ///
 
@@ -225,16 +229,37 @@ void Image::SkipComment(class ByteStream *in)
 }
 ///
 
+/// Image::pushTask::Run
+// Push a block of lines into the component.
+void Image::pushTask::Run(void)
+{
+  ULONG l;
+
+  for(l = 0;l < count;l++)
+    component->PushLine(lines[l]);
+}
+///
+
 /// Image::LoadPNM
 // Load an image from an already open (binary) PPM or PGM file
 // Throw in case the file should be invalid.
-void Image::LoadPNM(class ByteStream *input,UBYTE declevels,bool keephp)
+void Image::LoadPNM(class ByteStream *input,UBYTE declevels,bool keephp,int ncpus,bool luma)
+{
+  OpenPNM(input,declevels,keephp,luma);
+  while(PushRows(ncpus)) {
+  }
+}
+///
+
+/// Image::OpenPNM
+// Read the header of a (binary) PPM or PGM file and create the
+// components. The pixels are read by PushRows.
+void Image::OpenPNM(class ByteStream *input,UBYTE declevels,bool keephp,bool luma)
 {
   LONG data;
-  UWORD i;
+  UWORD i,samples;
   LONG width,height,precision;
-  LONG x,y;
-  UBYTE bits;
+  UBYTE bits,bytes,fraction;
   //
   assert(m_ppComponentArray == NULL);
   //
@@ -246,10 +271,13 @@ void Image::LoadPNM(class ByteStream *input,UBYTE declevels,bool keephp)
     Throw(InvalidParameter,"Image::LoadPNM","input image stream is no valid PNM file");
   data = input->Get();
   if (data == '6') {
-    // A color image. Allocate three components.
-    m_usComponents     = 3;
+    // A color image. Allocate three components, or only one if
+    // the pixels are reduced to their luma while reading.
+    samples            = 3;
+    m_usComponents     = (luma)?(1):(3);
   } else if (data == '5') {
     // A grey scale image. Allocate only one component.
+    samples            = 1;
     m_usComponents     = 1;
   } else {
     Throw(InvalidParameter,"Image::LoadPNM","input image is either invalid or an unsupported PNM type");
@@ -260,8 +288,8 @@ void Image::LoadPNM(class ByteStream *input,UBYTE declevels,bool keephp)
     m_ppComponentArray[i] = NULL;
   //
   // Initialize the line array.
-  m_ppLineArray      = new class Line*[m_usComponents];
-  for(i = 0;i<m_usComponents;i++)
+  m_ppLineArray      = new class Line*[m_usComponents * BlockLines];
+  for(i = 0;i<m_usComponents * BlockLines;i++)
     m_ppLineArray[i]      = NULL;
   //
   SkipComment(input);
@@ -295,39 +323,79 @@ void Image::LoadPNM(class ByteStream *input,UBYTE declevels,bool keephp)
   if (data != ' ' && data != '\n' && data != '\r' && data != '\t')
     Throw(InvalidParameter,"Image::LoadPNM","input image is not a valid PNM file");
   //
+  // Samples take two bytes if the maximum value does not fit into one.
+  // The luma keeps fractional bits where they fit, which scale the
+  // component.
+  bytes        = (precision > 255)?(2):(1);
+  fraction     = (samples != m_usComponents)?(PixelKernels::LumaFractionOf(bytes)):(0);
+  //
   // Now allocate the components.
   for(i=0;i<m_usComponents;i++) {
-    m_ppComponentArray[i] = new class Component(width,height,false,bits,FLOAT(precision),declevels,keephp);
-    m_ppLineArray[i]      = new class Line(width << 1); // requires twice the width, yuck!
+    m_ppComponentArray[i] = new class Component(width,height,false,bits + fraction,fraction,
+						FLOAT(precision << fraction),declevels,keephp);
+  }
+  for(i=0;i<m_usComponents * BlockLines;i++) {
+    m_ppLineArray[i]      = new class Line(width);
   }
   //
-  // Now read the data, component wise interleaved.
-  for(y=0;y<height;y++) {
-    for(x=0;x<width;x++) {
-      for(i=0;i<m_usComponents;i++) {
-	data = input->Get();
-	// Fall over if this is an EOF.
-	if (data == ByteStream::Eof)
-	  Throw(Eof,"Image::LoadPNM","unexpected EOF detected in input image");
-	//
-	if (bits > 8) {
-	  LONG dt = input->Get();
-	  if (dt == ByteStream::Eof)
-	    Throw(Eof,"Image::LoadPNM","unexpected EOF detected in input image");
-	  data = (data << 8) | dt;
-	}
-	//
-	if (data < 0 || data > precision)
-	  Throw(OutOfRange,"Image::LoadPNM","the input image contains invalid pixels");
-	//
-	// Insert the data. We could do that a bit faster with pointers, but
-	// so what...
-	m_ppLineArray[i]->At(x<<1) = data;
-      }
-    }
-    for(i=0;i<m_usComponents;i++) {
-      m_ppComponentArray[i]->PushLine(m_ppLineArray[i]);
+  // The data is read in blocks of rows, the component wise interleaved
+  // samples are unpacked into the lines.
+  m_pInput     = input;
+  m_lWidth     = width;
+  m_lHeight    = height;
+  m_lPrecision = precision;
+  m_lRow       = 0;
+  m_ulRowBytes = ULONG(width) * samples * bytes;
+  if (samples != m_usComponents) {
+    m_pUnpack  = PixelKernels::KernelsOf().LumaOf(bytes);
+  } else {
+    m_pUnpack  = PixelKernels::KernelsOf().UnpackOf(m_usComponents,bytes);
+  }
+  m_pucRow     = new UBYTE[m_ulRowBytes];
+}
+///
+
+/// Image::PushRows
+// Read the next block of rows from the stream and push them into the
+// components. Returns false if all rows have been pushed.
+bool Image::PushRows(int ncpus)
+{
+  LONG lines = (m_lHeight - m_lRow < BlockLines)?(m_lHeight - m_lRow):(BlockLines);
+  LONG l;
+  UWORD i;
+  WORD *dst[3];
+  struct pushTask tasks[3];
+  class ThreadJob *jobs[3];
+  //
+  if (lines <= 0)
+    return false;
+  //
+  // Rows are taken directly from the stream buffer if they are in
+  // there in one piece, as for mapped files, and copied otherwise.
+  for(l=0;l<lines;l++) {
+    const UBYTE *src = m_pInput->ReadInPlace(m_ulRowBytes);
+    if (src == NULL) {
+      if (m_pInput->Read(m_pucRow,m_ulRowBytes) != LONG(m_ulRowBytes))
+	Throw(Eof,"Image::LoadPNM","unexpected EOF detected in input image");
+      src = m_pucRow;
     }
+    //
+    for(i=0;i<m_usComponents;i++)
+      dst[i] = m_ppLineArray[i * BlockLines + l]->Origin();
+    if (m_pUnpack(src,m_lWidth,dst) > m_lPrecision)
+      Throw(OutOfRange,"Image::LoadPNM","the input image contains invalid pixels");
   }
+  //
+  // The block is then pushed into the components, one task per component.
+  for(i = 0;i<m_usComponents;i++) {
+    tasks[i].component = m_ppComponentArray[i];
+    tasks[i].lines     = m_ppLineArray + i * BlockLines;
+    tasks[i].count     = lines;
+    jobs[i]            = tasks + i;
+  }
+  ThreadPool::Execute(jobs,m_usComponents,ncpus);
+  m_lRow += lines;
+  //
+  return m_lRow < m_lHeight;
 }
 ///
@@ -33,6 +33,8 @@
 /// Includes
 #include "global/types.hpp"
 #include "std/assert.hpp"
+#include "global/threadpool.hpp"
+#include "img/pixelkernels.hpp"
 ///
 
 /// Forwards
@@ -53,9 +55,47 @@ class Image {
   // An array of components.
   class Component **m_ppComponentArray;
   //
-  // An array of lines. They are temporaries.
+  // An array of lines. They are temporaries, a block of lines
+  // per component.
   class Line      **m_ppLineArray;
   //
+  // The number of lines read in one go, before they are pushed
+  // into the components.
+  enum {
+    BlockLines = 16
+  };
+  //
+  // The stream the pixels are read from while the image is loaded.
+  class ByteStream *m_pInput;
+  //
+  // Dimensions and maximum sample value of the image being loaded.
+  LONG             m_lWidth;
+  LONG             m_lHeight;
+  LONG             m_lPrecision;
+  //
+  // The next row to be read from the stream.
+  LONG             m_lRow;
+  //
+  // The number of bytes of a row in the stream, and a buffer for one
+  // row in case the stream cannot provide it in place.
+  ULONG            m_ulRowBytes;
+  UBYTE           *m_pucRow;
+  //
+  // Unpacks the interleaved samples of a row into the lines.
+  PixelKernels::UnpackFunc m_pUnpack;
+  //
+  // This structure pushes a block of lines into a component. The
+  // components run their wavelet decomposition independently, hence
+  // one task per component can run in parallel.
+  struct pushTask : public ThreadJob {
+    class Component   *component;
+    class Line *const *lines;
+    ULONG              count;
+    //
+    // Push the lines.
+    virtual void Run(void);
+  };
+  //
   // Service (not required elsewhere): Read an ascii string from the input file,
   // encoding a number. This number gets returned. Throws on error.
   LONG ReadNumber(class ByteStream *from);
@@ -96,8 +136,23 @@ public:
   // Load an image from an already open (binary) PPM or PGM file
   // Throw in case the file should be invalid.
   // Wavelet-transform while loading, requires the number of levels
-  // of the transformation.
-  void LoadPNM(class ByteStream *input,UBYTE levels,bool keelhighpasses);
+  // of the transformation. The components are transformed in parallel
+  // on up to ncpus CPUs. If luma is set, color images are reduced
+  // to their luma while reading, and only a single component is
+  // created for them.
+  void LoadPNM(class ByteStream *input,UBYTE levels,bool keelhighpasses,int ncpus = 1,bool luma = false);
+  //
+  // Start loading an image from an already open (binary) PPM or PGM
+  // file: read the header and create the components, but no pixels yet.
+  // The pixels are then read by PushRows below, which allows to attach
+  // line sinks to the components in between. The stream must remain
+  // open until all rows are pushed. The luma flag is that of LoadPNM.
+  void OpenPNM(class ByteStream *input,UBYTE levels,bool keephighpasses,bool luma = false);
+  //
+  // Read the next block of rows from the stream and push them into the
+  // components, on up to ncpus CPUs. Returns false if all rows have been
+  // pushed.
+  bool PushRows(int ncpus = 1);
 };
 ///
 
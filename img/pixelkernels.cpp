@@ -0,0 +1,678 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+/// Includes
+#include "img/pixelkernels.hpp"
+#ifdef USE_X86_SIMD
+#include <immintrin.h>
+#endif
+///
+
+/// Scalar kernels
+// These are the reference implementations. The vector kernels use the
+// scalar kernels for the pixels that do not fill a complete vector,
+// hence the scalar kernels start at pixel x and return the maximum of
+// the given maximum and the samples they unpacked.
+
+/// Grey8Range
+static UWORD Grey8Range(const UBYTE *src,ULONG x,ULONG count,WORD *const *dst,UWORD max)
+{
+  WORD *d = dst[0];
+
+  for(;x < count;x++) {
+    UWORD v = src[x];
+    d[x]    = v;
+    if (v > max)
+      max = v;
+  }
+
+  return max;
+}
+///
+
+/// Grey16Range
+static UWORD Grey16Range(const UBYTE *src,ULONG x,ULONG count,WORD *const *dst,UWORD max)
+{
+  WORD *d = dst[0];
+
+  for(;x < count;x++) {
+    UWORD v = (src[x << 1] << 8) | src[(x << 1) + 1];
+    d[x]    = v;
+    if (v > max)
+      max = v;
+  }
+
+  return max;
+}
+///
+
+/// RGB8Range
+static UWORD RGB8Range(const UBYTE *src,ULONG x,ULONG count,WORD *const *dst,UWORD max)
+{
+  UWORD c;
+
+  for(;x < count;x++) {
+    for(c = 0;c < 3;c++) {
+      UWORD v   = src[x * 3 + c];
+      dst[c][x] = v;
+      if (v > max)
+	max = v;
+    }
+  }
+
+  return max;
+}
+///
+
+/// RGB16Range
+static UWORD RGB16Range(const UBYTE *src,ULONG x,ULONG count,WORD *const *dst,UWORD max)
+{
+  UWORD c;
+
+  for(;x < count;x++) {
+    for(c = 0;c < 3;c++) {
+      const UBYTE *s = src + x * 6 + (c << 1);
+      UWORD v        = (s[0] << 8) | s[1];
+      dst[c][x]      = v;
+      if (v > max)
+	max = v;
+    }
+  }
+
+  return max;
+}
+///
+
+/// Luma weights
+// The luma of the YCbCr transformation, Y = 0.299 R + 0.587 G + 0.114 B,
+// in 16-bit fixed point. The weights add up to one, hence the luma does
+// not exceed the maximum of its samples, and the weighted sum of 16-bit
+// samples fits into 32 bits. The luma of 8-bit samples keeps fractional
+// bits, and is thus shifted down by less.
+enum {
+  LumaR      = 19595,
+  LumaG      = 38470,
+  LumaB      = 7471,
+  LumaShift  = 16,
+  Luma8Shift = LumaShift - PixelKernels::Luma8Fraction
+};
+///
+
+/// Luma8Range
+static UWORD Luma8Range(const UBYTE *src,ULONG x,ULONG count,WORD *const *dst,UWORD max)
+{
+  WORD *d = dst[0];
+
+  for(;x < count;x++) {
+    ULONG r = src[x * 3 + 0];
+    ULONG g = src[x * 3 + 1];
+    ULONG b = src[x * 3 + 2];
+    d[x]    = (r * LumaR + g * LumaG + b * LumaB + (1UL << (Luma8Shift - 1))) >> Luma8Shift;
+    if (r > max)
+      max = r;
+    if (g > max)
+      max = g;
+    if (b > max)
+      max = b;
+  }
+
+  return max;
+}
+///
+
+/// Luma16Range
+static UWORD Luma16Range(const UBYTE *src,ULONG x,ULONG count,WORD *const *dst,UWORD max)
+{
+  WORD *d = dst[0];
+
+  for(;x < count;x++) {
+    const UBYTE *s = src + x * 6;
+    ULONG r = (s[0] << 8) | s[1];
+    ULONG g = (s[2] << 8) | s[3];
+    ULONG b = (s[4] << 8) | s[5];
+    d[x]    = (r * LumaR + g * LumaG + b * LumaB + (1UL << (LumaShift - 1))) >> LumaShift;
+    if (r > max)
+      max = r;
+    if (g > max)
+      max = g;
+    if (b > max)
+      max = b;
+  }
+
+  return max;
+}
+///
+
+/// Grey8Scalar
+static UWORD Grey8Scalar(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  return Grey8Range(src,0,count,dst,0);
+}
+///
+
+/// Grey16Scalar
+static UWORD Grey16Scalar(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  return Grey16Range(src,0,count,dst,0);
+}
+///
+
+/// RGB8Scalar
+static UWORD RGB8Scalar(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  return RGB8Range(src,0,count,dst,0);
+}
+///
+
+/// RGB16Scalar
+static UWORD RGB16Scalar(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  return RGB16Range(src,0,count,dst,0);
+}
+///
+
+/// Luma8Scalar
+static UWORD Luma8Scalar(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  return Luma8Range(src,0,count,dst,0);
+}
+///
+
+/// Luma16Scalar
+static UWORD Luma16Scalar(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  return Luma16Range(src,0,count,dst,0);
+}
+///
+///
+
+#ifdef USE_X86_SIMD
+/// SSE4.2 kernels
+// The vector kernels zero-extend the samples to 16-bit lanes and keep
+// the maximum per lane, which is reduced at the end of the row. RGB
+// samples are gathered by byte shuffles, one per component and load.
+
+/// MaxOf128
+// Reduce the lane-wise maximum to a scalar.
+__attribute__((target("sse4.2")))
+static inline UWORD MaxOf128(__m128i max)
+{
+  max = _mm_max_epu16(max,_mm_srli_si128(max,8));
+  max = _mm_max_epu16(max,_mm_srli_si128(max,4));
+  max = _mm_max_epu16(max,_mm_srli_si128(max,2));
+
+  return UWORD(_mm_extract_epi16(max,0));
+}
+///
+
+/// Luma128
+// Compute the luma of four pixels whose samples are in 32-bit lanes,
+// shifted down by the given shift.
+__attribute__((target("sse4.2")))
+static inline __m128i Luma128(__m128i r,__m128i g,__m128i b,int shift)
+{
+  __m128i y = _mm_add_epi32(_mm_mullo_epi32(r,_mm_set1_epi32(LumaR)),
+			    _mm_mullo_epi32(g,_mm_set1_epi32(LumaG)));
+  y = _mm_add_epi32(y,_mm_mullo_epi32(b,_mm_set1_epi32(LumaB)));
+  y = _mm_add_epi32(y,_mm_set1_epi32(1 << (shift - 1)));
+
+  return _mm_srli_epi32(y,shift);
+}
+///
+
+/// Grey8SSE42
+__attribute__((target("sse4.2")))
+static UWORD Grey8SSE42(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  __m128i max = _mm_setzero_si128();
+  WORD *d     = dst[0];
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m128i v  = _mm_loadu_si128((const __m128i *)(src + x));
+    __m128i l0 = _mm_cvtepu8_epi16(v);
+    __m128i l1 = _mm_cvtepu8_epi16(_mm_srli_si128(v,8));
+    max = _mm_max_epu16(max,_mm_max_epu16(l0,l1));
+    _mm_storeu_si128((__m128i *)(d + x    ),l0);
+    _mm_storeu_si128((__m128i *)(d + x + 8),l1);
+  }
+
+  return Grey8Range(src,x,count,dst,MaxOf128(max));
+}
+///
+
+/// Grey16SSE42
+__attribute__((target("sse4.2")))
+static UWORD Grey16SSE42(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  const __m128i swap = _mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  __m128i max        = _mm_setzero_si128();
+  WORD *d            = dst[0];
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + (x << 1))),swap);
+    max = _mm_max_epu16(max,v);
+    _mm_storeu_si128((__m128i *)(d + x),v);
+  }
+
+  return Grey16Range(src,x,count,dst,MaxOf128(max));
+}
+///
+
+/// RGB8SSE42
+// Eight pixels take 24 bytes, which are covered by two overlapping
+// loads at offset 0 and 8.
+__attribute__((target("sse4.2")))
+static UWORD RGB8SSE42(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  const __m128i rlo = _mm_setr_epi8( 0,-1, 3,-1, 6,-1, 9,-1,12,-1,15,-1,-1,-1,-1,-1);
+  const __m128i rhi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,10,-1,13,-1);
+  const __m128i glo = _mm_setr_epi8( 1,-1, 4,-1, 7,-1,10,-1,13,-1,-1,-1,-1,-1,-1,-1);
+  const __m128i ghi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 8,-1,11,-1,14,-1);
+  const __m128i blo = _mm_setr_epi8( 2,-1, 5,-1, 8,-1,11,-1,14,-1,-1,-1,-1,-1,-1,-1);
+  const __m128i bhi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 9,-1,12,-1,15,-1);
+  __m128i max       = _mm_setzero_si128();
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)(src + x * 3));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(src + x * 3 + 8));
+    __m128i r  = _mm_or_si128(_mm_shuffle_epi8(lo,rlo),_mm_shuffle_epi8(hi,rhi));
+    __m128i g  = _mm_or_si128(_mm_shuffle_epi8(lo,glo),_mm_shuffle_epi8(hi,ghi));
+    __m128i b  = _mm_or_si128(_mm_shuffle_epi8(lo,blo),_mm_shuffle_epi8(hi,bhi));
+    max = _mm_max_epu16(max,_mm_max_epu16(r,_mm_max_epu16(g,b)));
+    _mm_storeu_si128((__m128i *)(dst[0] + x),r);
+    _mm_storeu_si128((__m128i *)(dst[1] + x),g);
+    _mm_storeu_si128((__m128i *)(dst[2] + x),b);
+  }
+
+  return RGB8Range(src,x,count,dst,MaxOf128(max));
+}
+///
+
+/// RGB16SSE42
+// Four pixels take 24 bytes, which are covered by two overlapping
+// loads at offset 0 and 8. Only the last pixel comes from the second.
+// The samples are gathered into 32-bit lanes first, and two groups of
+// four pixels are packed into one vector then.
+__attribute__((target("sse4.2")))
+static UWORD RGB16SSE42(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  const __m128i rlo = _mm_setr_epi8( 1, 0,-1,-1, 7, 6,-1,-1,13,12,-1,-1,-1,-1,-1,-1);
+  const __m128i rhi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,11,10,-1,-1);
+  const __m128i glo = _mm_setr_epi8( 3, 2,-1,-1, 9, 8,-1,-1,15,14,-1,-1,-1,-1,-1,-1);
+  const __m128i ghi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,13,12,-1,-1);
+  const __m128i blo = _mm_setr_epi8( 5, 4,-1,-1,11,10,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+  const __m128i bhi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1, 9, 8,-1,-1,15,14,-1,-1);
+  __m128i max       = _mm_setzero_si128();
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m128i r[2],g[2],b[2];
+    int i;
+    for(i = 0;i < 2;i++) {
+      __m128i lo = _mm_loadu_si128((const __m128i *)(src + x * 6 + i * 24));
+      __m128i hi = _mm_loadu_si128((const __m128i *)(src + x * 6 + i * 24 + 8));
+      r[i] = _mm_or_si128(_mm_shuffle_epi8(lo,rlo),_mm_shuffle_epi8(hi,rhi));
+      g[i] = _mm_or_si128(_mm_shuffle_epi8(lo,glo),_mm_shuffle_epi8(hi,ghi));
+      b[i] = _mm_or_si128(_mm_shuffle_epi8(lo,blo),_mm_shuffle_epi8(hi,bhi));
+    }
+    r[0] = _mm_packus_epi32(r[0],r[1]);
+    g[0] = _mm_packus_epi32(g[0],g[1]);
+    b[0] = _mm_packus_epi32(b[0],b[1]);
+    max  = _mm_max_epu16(max,_mm_max_epu16(r[0],_mm_max_epu16(g[0],b[0])));
+    _mm_storeu_si128((__m128i *)(dst[0] + x),r[0]);
+    _mm_storeu_si128((__m128i *)(dst[1] + x),g[0]);
+    _mm_storeu_si128((__m128i *)(dst[2] + x),b[0]);
+  }
+
+  return RGB16Range(src,x,count,dst,MaxOf128(max));
+}
+///
+
+/// Luma8SSE42
+// Gathers the samples as RGB8SSE42 does, then widens them to 32-bit
+// lanes for the weighted sum.
+__attribute__((target("sse4.2")))
+static UWORD Luma8SSE42(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  const __m128i rlo = _mm_setr_epi8( 0,-1, 3,-1, 6,-1, 9,-1,12,-1,15,-1,-1,-1,-1,-1);
+  const __m128i rhi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,10,-1,13,-1);
+  const __m128i glo = _mm_setr_epi8( 1,-1, 4,-1, 7,-1,10,-1,13,-1,-1,-1,-1,-1,-1,-1);
+  const __m128i ghi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 8,-1,11,-1,14,-1);
+  const __m128i blo = _mm_setr_epi8( 2,-1, 5,-1, 8,-1,11,-1,14,-1,-1,-1,-1,-1,-1,-1);
+  const __m128i bhi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 9,-1,12,-1,15,-1);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i max       = _mm_setzero_si128();
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)(src + x * 3));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(src + x * 3 + 8));
+    __m128i r  = _mm_or_si128(_mm_shuffle_epi8(lo,rlo),_mm_shuffle_epi8(hi,rhi));
+    __m128i g  = _mm_or_si128(_mm_shuffle_epi8(lo,glo),_mm_shuffle_epi8(hi,ghi));
+    __m128i b  = _mm_or_si128(_mm_shuffle_epi8(lo,blo),_mm_shuffle_epi8(hi,bhi));
+    __m128i y0 = Luma128(_mm_unpacklo_epi16(r,zero),_mm_unpacklo_epi16(g,zero),_mm_unpacklo_epi16(b,zero),
+			 Luma8Shift);
+    __m128i y1 = Luma128(_mm_unpackhi_epi16(r,zero),_mm_unpackhi_epi16(g,zero),_mm_unpackhi_epi16(b,zero),
+			 Luma8Shift);
+    max = _mm_max_epu16(max,_mm_max_epu16(r,_mm_max_epu16(g,b)));
+    _mm_storeu_si128((__m128i *)(dst[0] + x),_mm_packus_epi32(y0,y1));
+  }
+
+  return Luma8Range(src,x,count,dst,MaxOf128(max));
+}
+///
+
+/// Luma16SSE42
+// Gathers the samples into 32-bit lanes as RGB16SSE42 does, which is
+// where the weighted sum is computed.
+__attribute__((target("sse4.2")))
+static UWORD Luma16SSE42(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  const __m128i rlo = _mm_setr_epi8( 1, 0,-1,-1, 7, 6,-1,-1,13,12,-1,-1,-1,-1,-1,-1);
+  const __m128i rhi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,11,10,-1,-1);
+  const __m128i glo = _mm_setr_epi8( 3, 2,-1,-1, 9, 8,-1,-1,15,14,-1,-1,-1,-1,-1,-1);
+  const __m128i ghi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,13,12,-1,-1);
+  const __m128i blo = _mm_setr_epi8( 5, 4,-1,-1,11,10,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+  const __m128i bhi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1, 9, 8,-1,-1,15,14,-1,-1);
+  __m128i max       = _mm_setzero_si128();
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m128i y[2];
+    int i;
+    for(i = 0;i < 2;i++) {
+      __m128i lo = _mm_loadu_si128((const __m128i *)(src + x * 6 + i * 24));
+      __m128i hi = _mm_loadu_si128((const __m128i *)(src + x * 6 + i * 24 + 8));
+      __m128i r  = _mm_or_si128(_mm_shuffle_epi8(lo,rlo),_mm_shuffle_epi8(hi,rhi));
+      __m128i g  = _mm_or_si128(_mm_shuffle_epi8(lo,glo),_mm_shuffle_epi8(hi,ghi));
+      __m128i b  = _mm_or_si128(_mm_shuffle_epi8(lo,blo),_mm_shuffle_epi8(hi,bhi));
+      // The upper halves of the lanes are zero, hence do not affect the maximum.
+      max  = _mm_max_epu16(max,_mm_max_epu16(r,_mm_max_epu16(g,b)));
+      y[i] = Luma128(r,g,b,LumaShift);
+    }
+    _mm_storeu_si128((__m128i *)(dst[0] + x),_mm_packus_epi32(y[0],y[1]));
+  }
+
+  return Luma16Range(src,x,count,dst,MaxOf128(max));
+}
+///
+///
+
+/// AVX2 kernels
+// The AVX2 shuffles work within 128-bit lanes, hence the RGB kernels
+// load the upper half of the vector separately and apply the SSE masks
+// to both halves.
+
+/// MaxOf256
+__attribute__((target("avx2")))
+static inline UWORD MaxOf256(__m256i max)
+{
+  return MaxOf128(_mm_max_epu16(_mm256_castsi256_si128(max),_mm256_extracti128_si256(max,1)));
+}
+///
+
+/// Load2x128
+// Load two unaligned 128-bit vectors into the lower and upper half.
+__attribute__((target("avx2")))
+static inline __m256i Load2x128(const UBYTE *lo,const UBYTE *hi)
+{
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)lo)),
+				 _mm_loadu_si128((const __m128i *)hi),1);
+}
+///
+
+/// Luma256
+// Compute the luma of eight pixels whose samples are in 32-bit lanes,
+// shifted down by the given shift.
+__attribute__((target("avx2")))
+static inline __m256i Luma256(__m256i r,__m256i g,__m256i b,int shift)
+{
+  __m256i y = _mm256_add_epi32(_mm256_mullo_epi32(r,_mm256_set1_epi32(LumaR)),
+			       _mm256_mullo_epi32(g,_mm256_set1_epi32(LumaG)));
+  y = _mm256_add_epi32(y,_mm256_mullo_epi32(b,_mm256_set1_epi32(LumaB)));
+  y = _mm256_add_epi32(y,_mm256_set1_epi32(1 << (shift - 1)));
+
+  return _mm256_srli_epi32(y,shift);
+}
+///
+
+/// Grey8AVX2
+__attribute__((target("avx2")))
+static UWORD Grey8AVX2(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  __m256i max = _mm256_setzero_si256();
+  WORD *d     = dst[0];
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + x)));
+    max = _mm256_max_epu16(max,v);
+    _mm256_storeu_si256((__m256i *)(d + x),v);
+  }
+
+  return Grey8Range(src,x,count,dst,MaxOf256(max));
+}
+///
+
+/// Grey16AVX2
+__attribute__((target("avx2")))
+static UWORD Grey16AVX2(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  const __m256i swap = _mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,
+					1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  __m256i max        = _mm256_setzero_si256();
+  WORD *d            = dst[0];
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src + (x << 1))),swap);
+    max = _mm256_max_epu16(max,v);
+    _mm256_storeu_si256((__m256i *)(d + x),v);
+  }
+
+  return Grey16Range(src,x,count,dst,MaxOf256(max));
+}
+///
+
+/// RGB8AVX2
+__attribute__((target("avx2")))
+static UWORD RGB8AVX2(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  const __m256i rlo = _mm256_broadcastsi128_si256(_mm_setr_epi8( 0,-1, 3,-1, 6,-1, 9,-1,12,-1,15,-1,-1,-1,-1,-1));
+  const __m256i rhi = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,10,-1,13,-1));
+  const __m256i glo = _mm256_broadcastsi128_si256(_mm_setr_epi8( 1,-1, 4,-1, 7,-1,10,-1,13,-1,-1,-1,-1,-1,-1,-1));
+  const __m256i ghi = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 8,-1,11,-1,14,-1));
+  const __m256i blo = _mm256_broadcastsi128_si256(_mm_setr_epi8( 2,-1, 5,-1, 8,-1,11,-1,14,-1,-1,-1,-1,-1,-1,-1));
+  const __m256i bhi = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 9,-1,12,-1,15,-1));
+  __m256i max       = _mm256_setzero_si256();
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    const UBYTE *s = src + x * 3;
+    __m256i lo = Load2x128(s    ,s + 24);
+    __m256i hi = Load2x128(s + 8,s + 32);
+    __m256i r  = _mm256_or_si256(_mm256_shuffle_epi8(lo,rlo),_mm256_shuffle_epi8(hi,rhi));
+    __m256i g  = _mm256_or_si256(_mm256_shuffle_epi8(lo,glo),_mm256_shuffle_epi8(hi,ghi));
+    __m256i b  = _mm256_or_si256(_mm256_shuffle_epi8(lo,blo),_mm256_shuffle_epi8(hi,bhi));
+    max = _mm256_max_epu16(max,_mm256_max_epu16(r,_mm256_max_epu16(g,b)));
+    _mm256_storeu_si256((__m256i *)(dst[0] + x),r);
+    _mm256_storeu_si256((__m256i *)(dst[1] + x),g);
+    _mm256_storeu_si256((__m256i *)(dst[2] + x),b);
+  }
+
+  return RGB8Range(src,x,count,dst,MaxOf256(max));
+}
+///
+
+/// RGB16AVX2
+// Each half of a vector gathers four pixels into 32-bit lanes as the
+// SSE kernel does. Sixteen pixels are then packed into one vector and
+// permuted back into pixel order.
+__attribute__((target("avx2")))
+static UWORD RGB16AVX2(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  const __m256i rlo = _mm256_broadcastsi128_si256(_mm_setr_epi8( 1, 0,-1,-1, 7, 6,-1,-1,13,12,-1,-1,-1,-1,-1,-1));
+  const __m256i rhi = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,11,10,-1,-1));
+  const __m256i glo = _mm256_broadcastsi128_si256(_mm_setr_epi8( 3, 2,-1,-1, 9, 8,-1,-1,15,14,-1,-1,-1,-1,-1,-1));
+  const __m256i ghi = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,13,12,-1,-1));
+  const __m256i blo = _mm256_broadcastsi128_si256(_mm_setr_epi8( 5, 4,-1,-1,11,10,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1));
+  const __m256i bhi = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1, 9, 8,-1,-1,15,14,-1,-1));
+  __m256i max       = _mm256_setzero_si256();
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m256i r[2],g[2],b[2];
+    int i;
+    for(i = 0;i < 2;i++) {
+      const UBYTE *s = src + x * 6 + i * 48;
+      __m256i lo = Load2x128(s    ,s + 24);
+      __m256i hi = Load2x128(s + 8,s + 32);
+      r[i] = _mm256_or_si256(_mm256_shuffle_epi8(lo,rlo),_mm256_shuffle_epi8(hi,rhi));
+      g[i] = _mm256_or_si256(_mm256_shuffle_epi8(lo,glo),_mm256_shuffle_epi8(hi,ghi));
+      b[i] = _mm256_or_si256(_mm256_shuffle_epi8(lo,blo),_mm256_shuffle_epi8(hi,bhi));
+    }
+    r[0] = _mm256_permute4x64_epi64(_mm256_packus_epi32(r[0],r[1]),_MM_SHUFFLE(3,1,2,0));
+    g[0] = _mm256_permute4x64_epi64(_mm256_packus_epi32(g[0],g[1]),_MM_SHUFFLE(3,1,2,0));
+    b[0] = _mm256_permute4x64_epi64(_mm256_packus_epi32(b[0],b[1]),_MM_SHUFFLE(3,1,2,0));
+    max  = _mm256_max_epu16(max,_mm256_max_epu16(r[0],_mm256_max_epu16(g[0],b[0])));
+    _mm256_storeu_si256((__m256i *)(dst[0] + x),r[0]);
+    _mm256_storeu_si256((__m256i *)(dst[1] + x),g[0]);
+    _mm256_storeu_si256((__m256i *)(dst[2] + x),b[0]);
+  }
+
+  return RGB16Range(src,x,count,dst,MaxOf256(max));
+}
+///
+
+/// Luma8AVX2
+// Unpacking to 32-bit lanes and packing back works within 128-bit lanes,
+// hence restores the pixel order.
+__attribute__((target("avx2")))
+static UWORD Luma8AVX2(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  const __m256i rlo  = _mm256_broadcastsi128_si256(_mm_setr_epi8( 0,-1, 3,-1, 6,-1, 9,-1,12,-1,15,-1,-1,-1,-1,-1));
+  const __m256i rhi  = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,10,-1,13,-1));
+  const __m256i glo  = _mm256_broadcastsi128_si256(_mm_setr_epi8( 1,-1, 4,-1, 7,-1,10,-1,13,-1,-1,-1,-1,-1,-1,-1));
+  const __m256i ghi  = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 8,-1,11,-1,14,-1));
+  const __m256i blo  = _mm256_broadcastsi128_si256(_mm_setr_epi8( 2,-1, 5,-1, 8,-1,11,-1,14,-1,-1,-1,-1,-1,-1,-1));
+  const __m256i bhi  = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 9,-1,12,-1,15,-1));
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i max        = _mm256_setzero_si256();
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    const UBYTE *s = src + x * 3;
+    __m256i lo = Load2x128(s    ,s + 24);
+    __m256i hi = Load2x128(s + 8,s + 32);
+    __m256i r  = _mm256_or_si256(_mm256_shuffle_epi8(lo,rlo),_mm256_shuffle_epi8(hi,rhi));
+    __m256i g  = _mm256_or_si256(_mm256_shuffle_epi8(lo,glo),_mm256_shuffle_epi8(hi,ghi));
+    __m256i b  = _mm256_or_si256(_mm256_shuffle_epi8(lo,blo),_mm256_shuffle_epi8(hi,bhi));
+    __m256i y0 = Luma256(_mm256_unpacklo_epi16(r,zero),_mm256_unpacklo_epi16(g,zero),
+			 _mm256_unpacklo_epi16(b,zero),Luma8Shift);
+    __m256i y1 = Luma256(_mm256_unpackhi_epi16(r,zero),_mm256_unpackhi_epi16(g,zero),
+			 _mm256_unpackhi_epi16(b,zero),Luma8Shift);
+    max = _mm256_max_epu16(max,_mm256_max_epu16(r,_mm256_max_epu16(g,b)));
+    _mm256_storeu_si256((__m256i *)(dst[0] + x),_mm256_packus_epi32(y0,y1));
+  }
+
+  return Luma8Range(src,x,count,dst,MaxOf256(max));
+}
+///
+
+/// Luma16AVX2
+__attribute__((target("avx2")))
+static UWORD Luma16AVX2(const UBYTE *src,ULONG count,WORD *const *dst)
+{
+  const __m256i rlo = _mm256_broadcastsi128_si256(_mm_setr_epi8( 1, 0,-1,-1, 7, 6,-1,-1,13,12,-1,-1,-1,-1,-1,-1));
+  const __m256i rhi = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,11,10,-1,-1));
+  const __m256i glo = _mm256_broadcastsi128_si256(_mm_setr_epi8( 3, 2,-1,-1, 9, 8,-1,-1,15,14,-1,-1,-1,-1,-1,-1));
+  const __m256i ghi = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,13,12,-1,-1));
+  const __m256i blo = _mm256_broadcastsi128_si256(_mm_setr_epi8( 5, 4,-1,-1,11,10,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1));
+  const __m256i bhi = _mm256_broadcastsi128_si256(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1, 9, 8,-1,-1,15,14,-1,-1));
+  __m256i max       = _mm256_setzero_si256();
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m256i y[2];
+    int i;
+    for(i = 0;i < 2;i++) {
+      const UBYTE *s = src + x * 6 + i * 48;
+      __m256i lo = Load2x128(s    ,s + 24);
+      __m256i hi = Load2x128(s + 8,s + 32);
+      __m256i r  = _mm256_or_si256(_mm256_shuffle_epi8(lo,rlo),_mm256_shuffle_epi8(hi,rhi));
+      __m256i g  = _mm256_or_si256(_mm256_shuffle_epi8(lo,glo),_mm256_shuffle_epi8(hi,ghi));
+      __m256i b  = _mm256_or_si256(_mm256_shuffle_epi8(lo,blo),_mm256_shuffle_epi8(hi,bhi));
+      max  = _mm256_max_epu16(max,_mm256_max_epu16(r,_mm256_max_epu16(g,b)));
+      y[i] = Luma256(r,g,b,LumaShift);
+    }
+    _mm256_storeu_si256((__m256i *)(dst[0] + x),
+			_mm256_permute4x64_epi64(_mm256_packus_epi32(y[0],y[1]),_MM_SHUFFLE(3,1,2,0)));
+  }
+
+  return Luma16Range(src,x,count,dst,MaxOf256(max));
+}
+///
+///
+#endif
+
+/// Kernel tables
+// AVX-512 foundation does not provide byte shuffles, and unpacking is
+// bound by the memory bandwidth anyhow, hence AVX-512 CPUs use the
+// AVX2 kernels.
+static const PixelKernels ScalarKernels = {
+  &Grey8Scalar,&Grey16Scalar,&RGB8Scalar,&RGB16Scalar,&Luma8Scalar,&Luma16Scalar
+};
+#ifdef USE_X86_SIMD
+static const PixelKernels SSE42Kernels = {
+  &Grey8SSE42,&Grey16SSE42,&RGB8SSE42,&RGB16SSE42,&Luma8SSE42,&Luma16SSE42
+};
+static const PixelKernels AVX2Kernels = {
+  &Grey8AVX2,&Grey16AVX2,&RGB8AVX2,&RGB16AVX2,&Luma8AVX2,&Luma16AVX2
+};
+#endif
+///
+
+/// PixelKernels::KernelsOf
+// Return the kernels for the given extension.
+const PixelKernels &PixelKernels::KernelsOf(CPU::Extension ext)
+{
+#ifdef USE_X86_SIMD
+  switch(ext) {
+  case CPU::AVX512:
+  case CPU::AVX2:
+    return AVX2Kernels;
+  case CPU::SSE42:
+    return SSE42Kernels;
+  case CPU::Scalar:
+    break;
+  }
+#else
+  (void)ext;
+#endif
+  return ScalarKernels;
+}
+///
@@ -0,0 +1,104 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+#ifndef IMG_PIXELKERNELS_HPP
+#define IMG_PIXELKERNELS_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/cpu.hpp"
+///
+
+/// class PixelKernels
+// This class collects the kernels that unpack one raw row of a binary
+// PNM file into the line buffers of the components. Samples are either
+// bytes or big-endian 16-bit words, and either grey or RGB interleaved.
+// RGB rows may also be reduced to their luma on the fly, such that only
+// a single component needs to be decomposed.
+//
+// Rather than checking each sample, the kernels return the maximum
+// sample of the row, which the caller compares against the maximum
+// value of the file.
+class PixelKernels {
+public:
+  //
+  // Unpack count pixels from the raw row src into the component lines
+  // dst, i.e. dst[c][x] receives component c of pixel x. Return
+  // the maximum sample value found.
+  typedef UWORD (*UnpackFunc)(const UBYTE *src,ULONG count,WORD *const *dst);
+  //
+  UnpackFunc Grey8;
+  UnpackFunc Grey16;
+  UnpackFunc RGB8;
+  UnpackFunc RGB16;
+  //
+  // Unpack the luma Y = 0.299 R + 0.587 G + 0.114 B of RGB pixels into
+  // dst[0]. The maximum is that of the RGB samples. The luma of 8-bit
+  // samples keeps Luma8Fraction fractional bits, i.e. is scaled by
+  // 1 << Luma8Fraction, as the wavelet would otherwise decompose the
+  // rounding error of the luma. The luma of 16-bit samples is rounded
+  // to the nearest integer, as there are no bits to spare.
+  UnpackFunc Luma8;
+  UnpackFunc Luma16;
+  //
+  enum {
+    Luma8Fraction = 4
+  };
+  //
+  // Return the kernel for the given number of components (1 or 3)
+  // and bytes per sample (1 or 2).
+  UnpackFunc UnpackOf(UWORD components,UBYTE bytes) const
+  {
+    if (components == 1)
+      return (bytes == 1)?(Grey8):(Grey16);
+    return (bytes == 1)?(RGB8):(RGB16);
+  }
+  //
+  // Return the luma kernel for the given bytes per sample.
+  UnpackFunc LumaOf(UBYTE bytes) const
+  {
+    return (bytes == 1)?(Luma8):(Luma16);
+  }
+  //
+  // Return the number of fractional bits of the luma kernel for the
+  // given bytes per sample.
+  static UBYTE LumaFractionOf(UBYTE bytes)
+  {
+    return (bytes == 1)?(Luma8Fraction):(0);
+  }
+  //
+  // Return the kernels for the given extension. If the extension is not
+  // supported by this build, the next narrower one is returned.
+  static const PixelKernels &KernelsOf(CPU::Extension ext);
+  //
+  // Return the kernels for the widest extension available.
+  static const PixelKernels &KernelsOf(void)
+  {
+    return KernelsOf(CPU::ExtensionOf());
+  }
+};
+///
+
+///
+#endif
@@ -68,6 +68,21 @@ LONG ByteStream::Read(UBYTE *buffer,ULONG size)
 }
 ///
 
+/// ByteStream::ReadInPlace
+const UBYTE *ByteStream::ReadInPlace(ULONG size)
+{
+  const UBYTE *data = m_pucBufPtr;
+
+  if (size > m_ulBufBytes)
+    return NULL;
+
+  m_pucBufPtr  += size;
+  m_ulBufBytes -= size;
+
+  return data;
+}
+///
+
 /// ByteStream::Write
 LONG ByteStream::Write(const UBYTE *buffer,ULONG size)
 {
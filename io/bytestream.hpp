@@ -88,6 +88,12 @@ public:
   LONG Read(UBYTE *buffer,ULONG size);          // read from buffer
   LONG Write(const UBYTE *buffer,ULONG size);   // write to buffer
   //
+  // Return a pointer to the next size bytes of the stream and skip over
+  // them, provided they are available in one piece in the buffer. This
+  // avoids copying the data out of the buffer. Returns NULL and leaves
+  // the stream untouched otherwise, the caller should then use Read.
+  virtual const UBYTE *ReadInPlace(ULONG size);
+  //
   // Reset the byte counter. This *MUST* be matched by a flush or a refill
   // or otherwise the result is undesirable.
   void ResetCounter(void)
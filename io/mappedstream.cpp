@@ -0,0 +1,170 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+/// Includes
+#include "io/mappedstream.hpp"
+#include "std/assert.hpp"
+#include "std/errno.hpp"
+#include "global/exceptions.hpp"
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES > 0
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#define USE_MMAP 1
+#endif
+///
+
+/// Defines
+// Pages are released in chunks of this size, and only once the read
+// position is this far ahead such that un-reading a byte never touches
+// a released page.
+#define RELEASE_CHUNK (1UL << 20)
+///
+
+/// MappedStream::~MappedStream
+MappedStream::~MappedStream(void)
+{
+  Close();
+}
+///
+
+/// MappedStream::Fill
+// The complete file is in the buffer, hence reaching its end is EOF.
+LONG MappedStream::Fill(void)
+{
+  return 0;
+}
+///
+
+/// MappedStream::Flush
+void MappedStream::Flush(void)
+{
+  Throw(NotImplemented,"MappedStream::Flush","mapped streams cannot be written to");
+}
+///
+
+/// MappedStream::OpenForRead
+// Map the file for reading.
+bool MappedStream::OpenForRead(const char *path)
+{
+#if USE_MMAP
+  struct stat st;
+  void *map;
+  int fd;
+  //
+  assert(m_pucMapping == NULL);
+  //
+  fd = open(path,O_RDONLY);
+  if (fd < 0)
+    ThrowIo("MappedStream::OpenForRead","failed opening the file for reading");
+  //
+  // Only regular, non-empty files can be mapped, and their size must
+  // fit into the byte counter.
+  if (fstat(fd,&st) != 0 || !S_ISREG(st.st_mode) ||
+      st.st_size <= 0 || st.st_size >= 0x7fffffffL) {
+    close(fd);
+    return false;
+  }
+  //
+  map = mmap(NULL,size_t(st.st_size),PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd); // the mapping keeps the file alive.
+  if (map == MAP_FAILED)
+    return false;
+  //
+  // This is only a hint, hence failure is irrelevant.
+  madvise(map,size_t(st.st_size),MADV_SEQUENTIAL);
+  //
+  m_pucMapping = (UBYTE *)map;
+  m_ulMapSize  = ULONG(st.st_size);
+  m_ulReleased = 0;
+  m_pucBuffer  = m_pucMapping;
+  m_pucBufPtr  = m_pucMapping;
+  m_ulBufSize  = m_ulMapSize;
+  m_ulBufBytes = m_ulMapSize;
+  m_ulCounter  = 0;
+  //
+  return true;
+#else
+  (void)path;
+  return false;
+#endif
+}
+///
+
+/// MappedStream::Release
+// Release all complete pages sufficiently far behind the read position.
+// Their contents remain in the page cache, we only drop them from the
+// mapping.
+void MappedStream::Release(void)
+{
+#if USE_MMAP
+  ULONG pos  = ULONG(m_pucBufPtr - m_pucMapping);
+  ULONG page = ULONG(sysconf(_SC_PAGESIZE));
+  ULONG end;
+  //
+  if (pos < m_ulReleased + (RELEASE_CHUNK << 1))
+    return;
+  //
+  end = (pos - RELEASE_CHUNK) / page * page;
+  if (end > m_ulReleased) {
+    madvise(m_pucMapping + m_ulReleased,end - m_ulReleased,MADV_DONTNEED);
+    m_ulReleased = end;
+  }
+#endif
+}
+///
+
+/// MappedStream::ReadInPlace
+// Skip over the next size bytes and return a pointer to them.
+const UBYTE *MappedStream::ReadInPlace(ULONG size)
+{
+  const UBYTE *data = ByteStream::ReadInPlace(size);
+
+  if (data)
+    Release();
+
+  return data;
+}
+///
+
+/// MappedStream::Close
+// Remove the mapping.
+void MappedStream::Close(void)
+{
+#if USE_MMAP
+  if (m_pucMapping)
+    munmap(m_pucMapping,m_ulMapSize);
+#endif
+  m_pucMapping = NULL;
+  m_ulMapSize  = 0;
+  m_pucBuffer  = NULL;
+  m_pucBufPtr  = NULL;
+  m_ulBufSize  = 0;
+  m_ulBufBytes = 0;
+}
+///
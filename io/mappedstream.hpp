@@ -0,0 +1,83 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+#ifndef IO_MAPPEDSTREAM_HPP
+#define IO_MAPPEDSTREAM_HPP
+
+/// Includes
+#include "io/bytestream.hpp"
+///
+
+/// MappedStream
+// This class reads a file by mapping it into memory instead of copying
+// it through an IO buffer. The mapping itself serves as buffer, hence
+// ReadInPlace hands out pointers into the page cache. As the file is
+// read sequentially, pages behind the read position are returned to
+// the system as reading proceeds.
+//
+// Mapping is only available for regular files on systems that support
+// it. Otherwise, OpenForRead fails gracefully and the caller should
+// fall back to a FileStream.
+class MappedStream : public ByteStream {
+  //
+  // The start of the mapping, or NULL if the stream is not open.
+  UBYTE *m_pucMapping;
+  //
+  // The size of the mapping in bytes.
+  ULONG  m_ulMapSize;
+  //
+  // The number of bytes at the start of the mapping that have been
+  // released already.
+  ULONG  m_ulReleased;
+  //
+  // Release all complete pages sufficiently far behind the read position.
+  void Release(void);
+  //
+  // The mapping covers the complete file, hence there is nothing to fill.
+  virtual LONG Fill(void);
+  //
+  // The stream cannot be written to.
+  virtual void Flush(void);
+  //
+public:
+  MappedStream(void)
+    : ByteStream(0), m_pucMapping(NULL), m_ulMapSize(0), m_ulReleased(0)
+  { }
+  //
+  virtual ~MappedStream(void);
+  //
+  // Map the file for reading. Throws if the file cannot be opened, and
+  // returns false if it can be opened, but not mapped.
+  bool OpenForRead(const char *path);
+  //
+  // Skip over the next size bytes and return a pointer to them.
+  virtual const UBYTE *ReadInPlace(ULONG size);
+  //
+  // Remove the mapping (also happens on destruction)
+  void Close(void);
+};
+///
+
+///
+#endif
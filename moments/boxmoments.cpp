@@ -0,0 +1,210 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class computes the windowed moments of two images under a
+** uniform box window, at constant cost per window position.
+*/
+
+/// Includes
+#include "moments/boxmoments.hpp"
+#include "std/assert.hpp"
+#include "std/string.hpp"
+///
+
+/// BoxMoments::BoxMoments
+// Prepare the moment computation of the two images under a box window.
+BoxMoments::BoxMoments(const Matrix<FLOAT> &img1,const Matrix<FLOAT> &img2,ULONG w,ULONG h,ULONG period)
+  : m_pImg1(&img1), m_pImg2(&img2), m_ulWindowWidth(w), m_ulWindowHeight(h),
+    m_ulWidth(img1.WidthOf() - w + 1), m_ulImageWidth(img1.WidthOf()),
+    m_ulPeriod((period > 0)?(period):(1)), m_dScale(1.0 / (DOUBLE(w) * DOUBLE(h))),
+    m_pdRing(NULL), m_plRingRow(NULL), m_pdColumns(NULL), m_lColumnRow(-1), m_lRestartRow(-1),
+    m_pdProducts(NULL),
+    m_ppfRows1(NULL), m_ppfRows2(NULL),
+    m_Kernels(MomentKernels::KernelsOf())
+{
+  assert(img1.WidthOf()  == img2.WidthOf() && img1.HeightOf() == img2.HeightOf());
+  assert(img1.WidthOf()  >= w);
+  assert(img1.HeightOf() >= h);
+  //
+  CreateBuffers();
+  m_ppfRows1     = new const FLOAT *[m_ulWindowHeight];
+  m_ppfRows2     = new const FLOAT *[m_ulWindowHeight];
+}
+///
+
+/// BoxMoments::BoxMoments
+// Prepare the moment computation of two images of the given width
+// whose rows are provided by the caller.
+BoxMoments::BoxMoments(ULONG width,ULONG w,ULONG h,ULONG period)
+  : m_pImg1(NULL), m_pImg2(NULL), m_ulWindowWidth(w), m_ulWindowHeight(h),
+    m_ulWidth(width - w + 1), m_ulImageWidth(width),
+    m_ulPeriod((period > 0)?(period):(1)), m_dScale(1.0 / (DOUBLE(w) * DOUBLE(h))),
+    m_pdRing(NULL), m_plRingRow(NULL), m_pdColumns(NULL), m_lColumnRow(-1), m_lRestartRow(-1),
+    m_pdProducts(NULL),
+    m_ppfRows1(NULL), m_ppfRows2(NULL),
+    m_Kernels(MomentKernels::KernelsOf())
+{
+  assert(width >= w);
+  //
+  CreateBuffers();
+}
+///
+
+/// BoxMoments::CreateBuffers
+// Allocate the ring and the column sums.
+void BoxMoments::CreateBuffers(void)
+{
+  ULONG j;
+  //
+  m_pdRing     = new DOUBLE[m_ulWindowHeight * MomentCount * m_ulImageWidth];
+  m_plRingRow  = new LONG[m_ulWindowHeight];
+  m_pdColumns  = new DOUBLE[MomentCount * m_ulImageWidth];
+  m_pdProducts = new DOUBLE[MomentCount * m_ulImageWidth];
+  //
+  for(j = 0;j < m_ulWindowHeight;j++)
+    m_plRingRow[j] = -1;
+}
+///
+
+/// BoxMoments::~BoxMoments
+BoxMoments::~BoxMoments(void)
+{
+  delete[] m_pdRing;
+  delete[] m_plRingRow;
+  delete[] m_pdColumns;
+  delete[] m_pdProducts;
+  delete[] m_ppfRows1;
+  delete[] m_ppfRows2;
+}
+///
+
+/// BoxMoments::SumColumns
+// Sum the column sums over the window width into the targets. The five
+// running sums are advanced together, as each of them is a chain of
+// dependent additions.
+void BoxMoments::SumColumns(DOUBLE *const *target) const
+{
+  const DOUBLE *column[MomentCount];
+  DOUBLE sum[MomentCount];
+  ULONG w = m_ulWindowWidth;
+  ULONG x0,x,i,q;
+  //
+  for(q = 0;q < MomentCount;q++)
+    column[q] = m_pdColumns + q * m_ulImageWidth;
+  //
+  for(x0 = 0;x0 < m_ulWidth;x0 += Span) {
+    ULONG end = (m_ulWidth - x0 < ULONG(Span))?(m_ulWidth):(x0 + Span);
+    //
+    // Restart the running sums from the plain sum of the first window.
+    for(q = 0;q < MomentCount;q++) {
+      DOUBLE s = 0.0;
+      for(i = 0;i < w;i++)
+	s += column[q][x0 + i];
+      sum[q]          = s;
+      target[q][x0]   = s * m_dScale;
+    }
+    //
+    // Then add the column entering and remove the column leaving the window.
+    for(x = x0 + 1;x < end;x++) {
+      for(q = 0;q < MomentCount;q++) {
+	sum[q]       += column[q][x + w - 1] - column[q][x - 1];
+	target[q][x]  = sum[q] * m_dScale;
+      }
+    }
+  }
+}
+///
+
+/// BoxMoments::MomentsOf
+// Compute the moments of all windows whose top edge is at image row y.
+void BoxMoments::MomentsOf(ULONG y,DOUBLE *mu1,DOUBLE *mu2,DOUBLE *xx,DOUBLE *yy,DOUBLE *xy)
+{
+  ULONG j;
+  //
+  assert(m_pImg1 && m_pImg2);
+  assert(y + m_ulWindowHeight <= m_pImg1->HeightOf());
+  //
+  for(j = 0;j < m_ulWindowHeight;j++) {
+    m_ppfRows1[j] = &m_pImg1->At(0,y + j);
+    m_ppfRows2[j] = &m_pImg2->At(0,y + j);
+  }
+  MomentsOf(y,m_ppfRows1,m_ppfRows2,mu1,mu2,xx,yy,xy);
+}
+///
+
+/// BoxMoments::MomentsOf
+// Compute the moments of all windows whose top edge is at image row y,
+// from the image rows provided by the caller.
+void BoxMoments::MomentsOf(ULONG y,const FLOAT *const *rows1,const FLOAT *const *rows2,
+			   DOUBLE *mu1,DOUBLE *mu2,DOUBLE *xx,DOUBLE *yy,DOUBLE *xy)
+{
+  ULONG h    = m_ulWindowHeight;
+  ULONG size = MomentCount * m_ulImageWidth;
+  DOUBLE *target[MomentCount];
+  ULONG i,j;
+  //
+  if (m_lColumnRow >= 0 && ULONG(m_lColumnRow) + 1 == y && y - ULONG(m_lRestartRow) < m_ulPeriod) {
+    // Advance the column sums by one row. The row leaving the window
+    // shares its slot in the ring with the row entering it.
+    ULONG row    = y + h - 1;
+    ULONG pos    = row % h;
+    DOUBLE *slot = m_pdRing + pos * size;
+    //
+    assert(m_plRingRow[pos] == LONG(y - 1));
+    ProductsOf(rows1[h - 1],rows2[h - 1],m_pdProducts);
+    for(i = 0;i < size;i++) {
+      m_pdColumns[i] += m_pdProducts[i] - slot[i];
+      slot[i]         = m_pdProducts[i];
+    }
+    m_plRingRow[pos] = row;
+  } else {
+    // Restart the column sums from the products of the rows covered by
+    // the window, in window order. Rows kept from a previous window row
+    // are reused.
+    for(j = 0;j < h;j++) {
+      ULONG row = y + j;
+      ULONG pos = row % h;
+      if (m_plRingRow[pos] != LONG(row)) {
+	ProductsOf(rows1[j],rows2[j],m_pdRing + pos * size);
+	m_plRingRow[pos] = row;
+      }
+    }
+    memcpy(m_pdColumns,m_pdRing + (y % h) * size,size * sizeof(DOUBLE));
+    for(j = 1;j < h;j++) {
+      const DOUBLE *slot = m_pdRing + ((y + j) % h) * size;
+      for(i = 0;i < size;i++)
+	m_pdColumns[i] += slot[i];
+    }
+    m_lRestartRow = y;
+  }
+  m_lColumnRow = y;
+  //
+  target[0] = mu1;
+  target[1] = mu2;
+  target[2] = xx;
+  target[3] = yy;
+  target[4] = xy;
+  SumColumns(target);
+}
+///
@@ -0,0 +1,170 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class computes the windowed moments of two images under a
+** uniform box window, at constant cost per window position.
+*/
+
+#ifndef MOMENTS_BOXMOMENTS_HPP
+#define MOMENTS_BOXMOMENTS_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/matrix.hpp"
+#include "moments/momentkernels.hpp"
+///
+
+/// class BoxMoments
+// This class computes the same moments as SeparableMoments, i.e. the
+// local means mu1 and mu2, the second moments E[x^2], E[y^2] and the
+// correlation E[xy], for the same window positions, but for a uniform
+// w x h window. The window sums are taken from running sums as in a
+// summed area table: The products of the image rows are summed up per
+// column over the window height, and the column sums are updated by the
+// row entering and the row leaving the window when advancing to the next
+// window row. The window sums are then the running sums over w columns.
+// The cost per window position is thus constant, regardless of the size
+// of the window.
+//
+// Instead of a table over the whole image, whose sums grow with the
+// image and lose precision in the differences, the running sums only
+// extend over a window, and are restarted from the plain sums every
+// period window rows, and every Span window positions within a row. The rounding error is thus bounded by that of a few
+// additions, and the moments of a window row do not depend on the window
+// rows computed before it, except for those since the last restart.
+// In particular, the moments of a stripe of window rows do not depend on
+// whether the rows above it were computed by the same object, as long as
+// the stripe starts at a multiple of the period.
+// The image rows are either taken from two matrices, or handed in by
+// the caller, e.g. if the images are streamed and only the rows covered
+// by the window are available.
+class BoxMoments {
+  //
+  // The number of moments we compute.
+  enum {
+    MomentCount = 5
+  };
+  //
+  // The number of window positions after which the running sum along a
+  // row is restarted.
+  enum {
+    Span = 64
+  };
+  //
+  // The two images whose moments are computed, or NULL if the caller
+  // provides the image rows.
+  const Matrix<FLOAT> *m_pImg1;
+  const Matrix<FLOAT> *m_pImg2;
+  //
+  // Dimensions of the window.
+  ULONG   m_ulWindowWidth;
+  ULONG   m_ulWindowHeight;
+  //
+  // Number of window positions within a row.
+  ULONG   m_ulWidth;
+  //
+  // Width of the images.
+  ULONG   m_ulImageWidth;
+  //
+  // The number of window rows after which the column sums are restarted.
+  ULONG   m_ulPeriod;
+  //
+  // The inverse of the window area, turning sums into means.
+  DOUBLE  m_dScale;
+  //
+  // The products x,y,x^2,y^2,xy of the samples, one slot of MomentCount
+  // rows per image row, keeping the last m_ulWindowHeight image rows.
+  DOUBLE *m_pdRing;
+  //
+  // The image row kept in each slot of the ring, or -1 if the slot is
+  // not yet filled.
+  LONG   *m_plRingRow;
+  //
+  // The sums of the products over the window height, per column.
+  DOUBLE *m_pdColumns;
+  //
+  // The window row the column sums are valid for, or -1 if none, and
+  // the window row they were last restarted at.
+  LONG    m_lColumnRow;
+  LONG    m_lRestartRow;
+  //
+  // Products of the samples of the row entering the window.
+  DOUBLE *m_pdProducts;
+  //
+  // The image rows covered by the current window row if they are taken
+  // from the matrices.
+  const FLOAT  **m_ppfRows1;
+  const FLOAT  **m_ppfRows2;
+  //
+  // The inner loops, for the vector extension of this CPU.
+  const MomentKernels &m_Kernels;
+  //
+  // Allocate the ring and the column sums.
+  void CreateBuffers(void);
+  //
+  // Compute the products of the given image rows into the given slot.
+  void ProductsOf(const FLOAT *row1,const FLOAT *row2,DOUBLE *slot) const
+  {
+    ULONG width = m_ulImageWidth;
+    //
+    m_Kernels.Products(row1,row2,width,slot,slot + width,slot + 2 * width,slot + 3 * width,slot + 4 * width);
+  }
+  //
+  // Sum the column sums over the window width into the targets.
+  void SumColumns(DOUBLE *const *target) const;
+  //
+public:
+  // Prepare the moment computation of the two images under a w x h box
+  // window. The images must be at least as large as the window. The
+  // column sums are restarted every period window rows.
+  BoxMoments(const Matrix<FLOAT> &img1,const Matrix<FLOAT> &img2,ULONG w,ULONG h,ULONG period);
+  //
+  // Prepare the moment computation of two images of the given width
+  // whose rows are provided by the caller.
+  BoxMoments(ULONG width,ULONG w,ULONG h,ULONG period);
+  //
+  ~BoxMoments(void);
+  //
+  // Return the number of window positions within a row, i.e. the number
+  // of entries the moment rows require.
+  ULONG WidthOf(void) const
+  {
+    return m_ulWidth;
+  }
+  //
+  // Compute the moments of all windows whose top edge is at image row y.
+  // The first sample of each target is the window at the left edge.
+  void MomentsOf(ULONG y,DOUBLE *mu1,DOUBLE *mu2,DOUBLE *xx,DOUBLE *yy,DOUBLE *xy);
+  //
+  // Ditto, but the image rows covered by the window are provided by the
+  // caller: rows1[j] and rows2[j] are the rows y + j of the two images.
+  // Only rows that have not been accessed for a previous window row are
+  // accessed.
+  void MomentsOf(ULONG y,const FLOAT *const *rows1,const FLOAT *const *rows2,
+		 DOUBLE *mu1,DOUBLE *mu2,DOUBLE *xx,DOUBLE *yy,DOUBLE *xy);
+};
+///
+
+///
+#endif
@@ -0,0 +1,317 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class collects the inner loops of the contrast masking of the
+** SSIM, i.e. the centered power sums of the samples in a window.
+*/
+
+/// Includes
+#include "moments/maskingkernels.hpp"
+#include "std/math.hpp"
+#include "std/string.hpp"
+#ifdef USE_X86_SIMD
+#include <immintrin.h>
+#endif
+///
+
+/// Constants
+// The coefficients of log2(m) = t * \sum_k L[k] * t^(2k) with
+// t = (m-1)/(m+1), i.e. L[k] = 2/((2k+1) * ln(2)).
+static const DOUBLE L1  = 2.8853900817779268;
+static const DOUBLE L3  = 0.9617966939259757;
+static const DOUBLE L5  = 0.5770780163555853;
+static const DOUBLE L7  = 0.41219858311113244;
+static const DOUBLE L9  = 0.3205988979753252;
+static const DOUBLE L11 = 0.2623081892525388;
+//
+// The coefficients of 2^f = \sum_k E[k] * f^k, i.e. E[k] = ln(2)^k / k!.
+// For |f| <= 1/2, the terms beyond E9 are below 1e-11.
+static const DOUBLE E0  = 1.0;
+static const DOUBLE E1  = 0.6931471805599453;
+static const DOUBLE E2  = 0.2402265069591007;
+static const DOUBLE E3  = 0.055504108664821576;
+static const DOUBLE E4  = 0.009618129107628477;
+static const DOUBLE E5  = 0.0013333558146428441;
+static const DOUBLE E6  = 0.00015403530393381606;
+static const DOUBLE E7  = 1.5252733804059838e-05;
+static const DOUBLE E8  = 1.3215486790144305e-06;
+static const DOUBLE E9  = 1.0178086009239696e-07;
+//
+// The square root of two, the upper end of the mantissa range.
+static const DOUBLE Sqrt2       = 1.4142135623730951;
+// The smallest normal number.
+static const DOUBLE MinNormal   = 2.2250738585072014e-308;
+// The lowest power of two generated.
+static const DOUBLE MinExponent = -1020.0;
+// Adding this to an integer between -1023 and 1024 places its biased
+// exponent into the low bits of the mantissa, and the upper bits of a
+// double read as integer, with this bias added, are its exponent.
+static const DOUBLE ExpMagic    = 4503599627371519.0; // 2^52 + 1023
+static const UQUAD  ExpBias     = 0x4330000000000000ULL; // the bits of 2^52
+static const UQUAD  MantMask    = 0x000fffffffffffffULL;
+static const UQUAD  OneBits     = 0x3ff0000000000000ULL;
+///
+
+/// Scalar kernels
+// These are the reference implementations. The vector kernels below
+// must generate the same results for each sample, and use the scalar
+// kernels to process the windows that do not fill a complete vector.
+
+/// Power
+// Compute a^p for a >= 0 by the approximation.
+static inline DOUBLE Power(DOUBLE a,DOUBLE p)
+{
+  UQUAD bits,ebits;
+  DOUBLE m,e,t,t2,y,n,f,r,s;
+  //
+  if (a < MinNormal)
+    return 0.0;
+  //
+  // Split into exponent and mantissa in [1,2), then move the mantissa
+  // into [sqrt(1/2),sqrt(2)).
+  memcpy(&bits,&a,sizeof(bits));
+  ebits = (bits >> 52) | ExpBias;
+  bits  = (bits & MantMask) | OneBits;
+  memcpy(&e,&ebits,sizeof(e));
+  memcpy(&m,&bits,sizeof(m));
+  e    -= ExpMagic;
+  if (m > Sqrt2) {
+    m  *= 0.5;
+    e  += 1.0;
+  }
+  //
+  t  = (m - 1.0) / (m + 1.0);
+  t2 = t * t;
+  y  = p * (e + t * (L1 + t2 * (L3 + t2 * (L5 + t2 * (L7 + t2 * (L9 + t2 * L11))))));
+  if (y < MinExponent)
+    y = MinExponent;
+  //
+  // Split into integer and fractional part, |f| <= 1/2.
+  n  = floor(y + 0.5);
+  f  = y - n;
+  r  = E0 + f * (E1 + f * (E2 + f * (E3 + f * (E4 + f * (E5 + f * (E6 + f * (E7 + f * (E8 +
+       f * E9))))))));
+  //
+  // Scale by 2^n.
+  n += ExpMagic;
+  memcpy(&bits,&n,sizeof(bits));
+  bits <<= 52;
+  memcpy(&s,&bits,sizeof(s));
+  //
+  return r * s;
+}
+///
+
+/// PowerOf
+// Compute a^p for the given kind of exponent.
+template<int mode>
+static inline DOUBLE PowerOf(DOUBLE a,DOUBLE p)
+{
+  switch(mode) {
+  case MaskingKernels::Linear:
+    return a;
+  case MaskingKernels::ThreeHalves:
+    return a * sqrt(a);
+  default:
+    return Power(a,p);
+  }
+}
+///
+
+/// PowerSumsRange
+// Compute the power sums of the windows from i up to count.
+template<int mode>
+static void PowerSumsRange(const FLOAT *const *rows1,const FLOAT *const *rows2,ULONG x,
+			   const DOUBLE *taps,ULONG w,ULONG h,const DOUBLE *mu1,const DOUBLE *mu2,
+			   ULONG i,ULONG count,DOUBLE p,DOUBLE *lp1,DOUBLE *lp2)
+{
+  ULONG j,k;
+
+  for(;i < count;i++) {
+    DOUBLE m1 = mu1[i];
+    DOUBLE m2 = mu2[i];
+    DOUBLE s1 = 0.0;
+    DOUBLE s2 = 0.0;
+    for(j = 0;j < h;j++) {
+      const FLOAT  *row1 = rows1[j] + x + i;
+      const FLOAT  *row2 = rows2[j] + x + i;
+      const DOUBLE *tap  = taps + j * w;
+      for(k = 0;k < w;k++) {
+	s1 += PowerOf<mode>(fabs(row1[k] - m1),p) * tap[k];
+	s2 += PowerOf<mode>(fabs(row2[k] - m2),p) * tap[k];
+      }
+    }
+    lp1[i] = s1;
+    lp2[i] = s2;
+  }
+}
+///
+
+/// PowerSumsScalar
+template<int mode>
+static void PowerSumsScalar(const FLOAT *const *rows1,const FLOAT *const *rows2,ULONG x,
+			    const DOUBLE *taps,ULONG w,ULONG h,const DOUBLE *mu1,const DOUBLE *mu2,
+			    ULONG count,DOUBLE p,DOUBLE *lp1,DOUBLE *lp2)
+{
+  PowerSumsRange<mode>(rows1,rows2,x,taps,w,h,mu1,mu2,0,count,p,lp1,lp2);
+}
+///
+///
+
+#ifdef USE_X86_SIMD
+/// AVX2 kernels
+
+/// Power256
+// Compute a^p for four a >= 0 by the approximation, as above.
+__attribute__((target("avx2")))
+static inline __m256d Power256(__m256d a,__m256d p)
+{
+  __m256i bits  = _mm256_castpd_si256(a);
+  __m256d e     = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits,52),
+						      _mm256_set1_epi64x(ExpBias)));
+  __m256d m     = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits,_mm256_set1_epi64x(MantMask)),
+						      _mm256_set1_epi64x(OneBits)));
+  __m256d high  = _mm256_cmp_pd(m,_mm256_set1_pd(Sqrt2),_CMP_GT_OQ);
+  __m256d t,t2,y,n,f,r,s;
+  //
+  e  = _mm256_sub_pd(e,_mm256_set1_pd(ExpMagic));
+  m  = _mm256_blendv_pd(m,_mm256_mul_pd(m,_mm256_set1_pd(0.5)),high);
+  e  = _mm256_blendv_pd(e,_mm256_add_pd(e,_mm256_set1_pd(1.0)),high);
+  //
+  t  = _mm256_div_pd(_mm256_sub_pd(m,_mm256_set1_pd(1.0)),_mm256_add_pd(m,_mm256_set1_pd(1.0)));
+  t2 = _mm256_mul_pd(t,t);
+  y  = _mm256_add_pd(_mm256_set1_pd(L9),_mm256_mul_pd(t2,_mm256_set1_pd(L11)));
+  y  = _mm256_add_pd(_mm256_set1_pd(L7),_mm256_mul_pd(t2,y));
+  y  = _mm256_add_pd(_mm256_set1_pd(L5),_mm256_mul_pd(t2,y));
+  y  = _mm256_add_pd(_mm256_set1_pd(L3),_mm256_mul_pd(t2,y));
+  y  = _mm256_add_pd(_mm256_set1_pd(L1),_mm256_mul_pd(t2,y));
+  y  = _mm256_mul_pd(p,_mm256_add_pd(e,_mm256_mul_pd(t,y)));
+  y  = _mm256_max_pd(y,_mm256_set1_pd(MinExponent));
+  //
+  n  = _mm256_floor_pd(_mm256_add_pd(y,_mm256_set1_pd(0.5)));
+  f  = _mm256_sub_pd(y,n);
+  r  = _mm256_add_pd(_mm256_set1_pd(E8),_mm256_mul_pd(f,_mm256_set1_pd(E9)));
+  r  = _mm256_add_pd(_mm256_set1_pd(E7),_mm256_mul_pd(f,r));
+  r  = _mm256_add_pd(_mm256_set1_pd(E6),_mm256_mul_pd(f,r));
+  r  = _mm256_add_pd(_mm256_set1_pd(E5),_mm256_mul_pd(f,r));
+  r  = _mm256_add_pd(_mm256_set1_pd(E4),_mm256_mul_pd(f,r));
+  r  = _mm256_add_pd(_mm256_set1_pd(E3),_mm256_mul_pd(f,r));
+  r  = _mm256_add_pd(_mm256_set1_pd(E2),_mm256_mul_pd(f,r));
+  r  = _mm256_add_pd(_mm256_set1_pd(E1),_mm256_mul_pd(f,r));
+  r  = _mm256_add_pd(_mm256_set1_pd(E0),_mm256_mul_pd(f,r));
+  //
+  s  = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(n,_mm256_set1_pd(ExpMagic))),52));
+  r  = _mm256_mul_pd(r,s);
+  //
+  // Flush the denormals and zeros.
+  return _mm256_and_pd(r,_mm256_cmp_pd(a,_mm256_set1_pd(MinNormal),_CMP_GE_OQ));
+}
+///
+
+/// PowerOf256
+// Compute a^p of four samples for the given kind of exponent.
+template<int mode>
+__attribute__((target("avx2")))
+static inline __m256d PowerOf256(__m256d a,__m256d p)
+{
+  switch(mode) {
+  case MaskingKernels::Linear:
+    return a;
+  case MaskingKernels::ThreeHalves:
+    return _mm256_mul_pd(a,_mm256_sqrt_pd(a));
+  default:
+    return Power256(a,p);
+  }
+}
+///
+
+/// PowerSumsAVX2
+template<int mode>
+__attribute__((target("avx2")))
+static void PowerSumsAVX2(const FLOAT *const *rows1,const FLOAT *const *rows2,ULONG x,
+			  const DOUBLE *taps,ULONG w,ULONG h,const DOUBLE *mu1,const DOUBLE *mu2,
+			  ULONG count,DOUBLE p,DOUBLE *lp1,DOUBLE *lp2)
+{
+  __m256d sign = _mm256_set1_pd(-0.0);
+  __m256d vp   = _mm256_set1_pd(p);
+  ULONG i,j,k;
+
+  for(i = 0;i + 4 <= count;i += 4) {
+    __m256d m1 = _mm256_loadu_pd(mu1 + i);
+    __m256d m2 = _mm256_loadu_pd(mu2 + i);
+    __m256d s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd();
+    for(j = 0;j < h;j++) {
+      const FLOAT  *row1 = rows1[j] + x + i;
+      const FLOAT  *row2 = rows2[j] + x + i;
+      const DOUBLE *tap  = taps + j * w;
+      for(k = 0;k < w;k++) {
+	__m256d t  = _mm256_set1_pd(tap[k]);
+	__m256d v1 = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(row1 + k)),m1);
+	__m256d v2 = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(row2 + k)),m2);
+	s1 = _mm256_add_pd(s1,_mm256_mul_pd(PowerOf256<mode>(_mm256_andnot_pd(sign,v1),vp),t));
+	s2 = _mm256_add_pd(s2,_mm256_mul_pd(PowerOf256<mode>(_mm256_andnot_pd(sign,v2),vp),t));
+      }
+    }
+    _mm256_storeu_pd(lp1 + i,s1);
+    _mm256_storeu_pd(lp2 + i,s2);
+  }
+  PowerSumsRange<mode>(rows1,rows2,x,taps,w,h,mu1,mu2,i,count,p,lp1,lp2);
+}
+///
+///
+#endif
+
+/// Kernel tables
+static const MaskingKernels ScalarKernels = {
+  {&PowerSumsScalar<MaskingKernels::Linear>,&PowerSumsScalar<MaskingKernels::ThreeHalves>,
+   &PowerSumsScalar<MaskingKernels::General>}
+};
+#ifdef USE_X86_SIMD
+static const MaskingKernels AVX2Kernels = {
+  {&PowerSumsAVX2<MaskingKernels::Linear>,&PowerSumsAVX2<MaskingKernels::ThreeHalves>,
+   &PowerSumsAVX2<MaskingKernels::General>}
+};
+#endif
+///
+
+/// MaskingKernels::KernelsOf
+// Return the kernels for the given extension.
+const MaskingKernels &MaskingKernels::KernelsOf(CPU::Extension ext)
+{
+#ifdef USE_X86_SIMD
+  switch(ext) {
+  case CPU::AVX512:
+  case CPU::AVX2:
+    return AVX2Kernels;
+  case CPU::SSE42:
+  case CPU::Scalar:
+    break;
+  }
+#else
+  (void)ext;
+#endif
+  return ScalarKernels;
+}
+///
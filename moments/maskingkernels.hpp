@@ -0,0 +1,104 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class collects the inner loops of the contrast masking of the
+** SSIM, i.e. the centered power sums of the samples in a window.
+*/
+
+#ifndef MOMENTS_MASKINGKERNELS_HPP
+#define MOMENTS_MASKINGKERNELS_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/cpu.hpp"
+///
+
+/// class MaskingKernels
+// The masking term of the SSIM requires, for every window, the weighted
+// sums of |s - mu|^2 and |s - mu|^p over the samples s of the window,
+// where mu is the mean of the window. The former is the variance and
+// follows from the moments. The latter does not separate, hence it is
+// computed over the full window, for both images in the same pass and
+// vectorized over neighbouring windows.
+//
+// The exponents 1 and 1.5 are computed exactly as |v| and |v|*sqrt(|v|).
+// Other exponents use a polynomial approximation of 2^(p * log2|v|):
+// log2 of the mantissa in [sqrt(1/2),sqrt(2)) is expanded as
+// 2/ln(2) * atanh((m-1)/(m+1)) up to the 11th power, and 2^f for
+// |f| <= 1/2 up to the 9th power. The relative error of |v|^p is below
+// 1e-10 for all exponents between 0 and 2. Differences below the
+// smallest normal number, and powers below 2^-1020, are flushed to zero.
+//
+// Each kernel exists as scalar reference code and as AVX2 implementation
+// which computes the same operations in the same order, hence both are
+// bit-exact. SSE4.2 CPUs use the scalar code, AVX-512 CPUs the AVX2 code
+// as the compiler could otherwise contract the polynomials.
+class MaskingKernels {
+public:
+  //
+  // Compute the centered power sums of count windows of two images.
+  // rows1 and rows2 are the h image rows covered by the windows, the
+  // window i covers the samples from x + i onwards. taps are the w x h
+  // weights of the window in row-major order, mu1 and mu2 the means of
+  // the windows. For the window i, lp1[i] is the sum of
+  // taps * |s - mu1[i]|^p over the samples s of the first image, summed
+  // row by row, left to right, and lp2[i] the same for the second image.
+  typedef void (*PowerSumsFunc)(const FLOAT *const *rows1,const FLOAT *const *rows2,ULONG x,
+				const DOUBLE *taps,ULONG w,ULONG h,const DOUBLE *mu1,const DOUBLE *mu2,
+				ULONG count,DOUBLE p,DOUBLE *lp1,DOUBLE *lp2);
+  //
+  // The exponents with specialized kernels.
+  enum Exponent {
+    Linear,      // p = 1
+    ThreeHalves, // p = 1.5
+    General      // all others, approximated
+  };
+  //
+  // The kernels, indexed by the above.
+  PowerSumsFunc PowerSums[3];
+  //
+  // Return the kernel for the given exponent.
+  PowerSumsFunc PowerSumsOf(DOUBLE p) const
+  {
+    if (p == 1.0)
+      return PowerSums[Linear];
+    if (p == 1.5)
+      return PowerSums[ThreeHalves];
+    return PowerSums[General];
+  }
+  //
+  // Return the kernels for the given extension. If the extension is not
+  // supported by this build, the next narrower one is returned.
+  static const MaskingKernels &KernelsOf(CPU::Extension ext);
+  //
+  // Return the kernels for the widest extension available.
+  static const MaskingKernels &KernelsOf(void)
+  {
+    return KernelsOf(CPU::ExtensionOf());
+  }
+};
+///
+
+///
+#endif
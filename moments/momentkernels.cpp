@@ -0,0 +1,592 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+/// Includes
+#include "moments/momentkernels.hpp"
+#include "std/math.hpp"
+#ifdef USE_X86_SIMD
+#include <immintrin.h>
+#endif
+///
+
+/// Scalar kernels
+// These are the reference implementations. The vector kernels below
+// must generate the same results for each sample, and use the scalar
+// kernels to process the samples that do not fill a complete vector.
+// The filters take the number of taps as template argument if it is
+// fixed, such that the loops over the taps unroll, or zero to take it
+// from the arguments. The SSIM kernels are specialized for evaluating
+// the luminance term and for storing the local values, such that the
+// loops carry no branches.
+
+/// ProductsScalar
+static void ProductsScalar(const FLOAT *r1,const FLOAT *r2,ULONG count,
+			   DOUBLE *p1,DOUBLE *p2,DOUBLE *p11,DOUBLE *p22,DOUBLE *p12)
+{
+  ULONG x;
+
+  for(x = 0;x < count;x++) {
+    DOUBLE k1 = r1[x];
+    DOUBLE k2 = r2[x];
+    p1[x]     = k1;
+    p2[x]     = k2;
+    p11[x]    = k1 * k1;
+    p22[x]    = k2 * k2;
+    p12[x]    = k1 * k2;
+  }
+}
+///
+
+/// HorizontalScalar
+// Note that the loop over the taps is the outer loop such that the
+// summation order is fixed, even if the compiler vectorizes this.
+template<ULONG fixed>
+static void HorizontalScalar(const DOUBLE *src,DOUBLE *dst,ULONG count,
+			     const DOUBLE *taps,ULONG ntaps)
+{
+  ULONG x,i;
+  const ULONG n = (fixed)?(fixed):(ntaps);
+
+  for(x = 0;x < count;x++)
+    dst[x] = 0.0;
+
+  for(i = 0;i < n;i++) {
+    DOUBLE tap = taps[i];
+    for(x = 0;x < count;x++)
+      dst[x] += src[x + i] * tap;
+  }
+}
+///
+
+/// VerticalRange
+// Filter vertically over the given rows, for the samples from x up to count.
+template<ULONG fixed>
+static void VerticalRange(const DOUBLE *const *rows,DOUBLE *dst,ULONG x,ULONG count,
+			  const DOUBLE *taps,ULONG ntaps)
+{
+  ULONG i,j;
+  const ULONG n = (fixed)?(fixed):(ntaps);
+
+  for(i = x;i < count;i++)
+    dst[i] = 0.0;
+
+  for(j = 0;j < n;j++) {
+    const DOUBLE *src = rows[j];
+    DOUBLE tap        = taps[j];
+    for(i = x;i < count;i++)
+      dst[i] += src[i] * tap;
+  }
+}
+///
+
+/// VerticalScalar
+template<ULONG fixed>
+static void VerticalScalar(const DOUBLE *const *rows,DOUBLE *dst,ULONG count,
+			   const DOUBLE *taps,ULONG ntaps)
+{
+  VerticalRange<fixed>(rows,dst,0,count,taps,ntaps);
+}
+///
+
+/// LocalSSIM
+// Compute the SSIM of a single window from its raw moments.
+template<bool luminance>
+static inline DOUBLE LocalSSIM(DOUBLE mu1,DOUBLE mu2,DOUBLE xx,DOUBLE yy,DOUBLE xy,
+			       DOUBLE c1,DOUBLE c2,DOUBLE c3)
+{
+  DOUBLE var1 = xx - mu1 * mu1;
+  DOUBLE var2 = yy - mu2 * mu2;
+  DOUBLE cov  = xy - mu1 * mu2;
+  DOUBLE sd12,complum,compcon,compstruct;
+  //
+  // Fixup round-off errors. Variances should be positive.
+  if (var1 < 0.0)
+    var1 = 0.0;
+  if (var2 < 0.0)
+    var2 = 0.0;
+  sd12 = sqrt(var1 * var2);
+  //
+  if (luminance) {
+    complum = (2.0 * mu1 * mu2 + c1) / (mu1 * mu1 + mu2 * mu2 + c1);
+  } else {
+    complum = 1.0;
+  }
+  compcon    = (2.0 * sd12 + c2) / (var1 + var2 + c2);
+  compstruct = (cov + c3) / (sd12 + c3);
+  //
+  return complum * compcon * compstruct;
+}
+///
+
+/// SSIMTail
+// Compute the SSIM of the windows from x up to count, pool them into the
+// eight partial sums.
+template<bool luminance,bool store>
+static void SSIMTail(const DOUBLE *mu1,const DOUBLE *mu2,
+		     const DOUBLE *xx,const DOUBLE *yy,const DOUBLE *xy,ULONG x,ULONG count,
+		     DOUBLE c1,DOUBLE c2,DOUBLE c3,DOUBLE *ssim,DOUBLE *part)
+{
+  for(;x < count;x++) {
+    DOUBLE s = LocalSSIM<luminance>(mu1[x],mu2[x],xx[x],yy[x],xy[x],c1,c2,c3);
+    if (store)
+      ssim[x] = s;
+    part[x & 7] += s;
+  }
+}
+///
+
+/// PoolPartials
+// Pool the eight partial sums in a fixed order.
+static inline DOUBLE PoolPartials(const DOUBLE *part)
+{
+  return ((part[0] + part[1]) + (part[2] + part[3])) + ((part[4] + part[5]) + (part[6] + part[7]));
+}
+///
+
+/// SSIMScalar
+template<bool luminance,bool store>
+static DOUBLE SSIMScalar(const DOUBLE *mu1,const DOUBLE *mu2,
+			 const DOUBLE *xx,const DOUBLE *yy,const DOUBLE *xy,ULONG count,
+			 DOUBLE c1,DOUBLE c2,DOUBLE c3,DOUBLE *ssim)
+{
+  DOUBLE part[8] = {0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0};
+
+  SSIMTail<luminance,store>(mu1,mu2,xx,yy,xy,0,count,c1,c2,c3,ssim,part);
+
+  return PoolPartials(part);
+}
+///
+///
+
+#ifdef USE_X86_SIMD
+/// SSE4.2 kernels
+
+/// ProductsSSE42
+__attribute__((target("sse4.2")))
+static void ProductsSSE42(const FLOAT *r1,const FLOAT *r2,ULONG count,
+			  DOUBLE *p1,DOUBLE *p2,DOUBLE *p11,DOUBLE *p22,DOUBLE *p12)
+{
+  ULONG x;
+
+  for(x = 0;x + 2 <= count;x += 2) {
+    __m128d k1 = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)(r1 + x))));
+    __m128d k2 = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)(r2 + x))));
+    _mm_storeu_pd(p1  + x,k1);
+    _mm_storeu_pd(p2  + x,k2);
+    _mm_storeu_pd(p11 + x,_mm_mul_pd(k1,k1));
+    _mm_storeu_pd(p22 + x,_mm_mul_pd(k2,k2));
+    _mm_storeu_pd(p12 + x,_mm_mul_pd(k1,k2));
+  }
+  ProductsScalar(r1 + x,r2 + x,count - x,p1 + x,p2 + x,p11 + x,p22 + x,p12 + x);
+}
+///
+
+/// HorizontalSSE42
+template<ULONG fixed>
+__attribute__((target("sse4.2")))
+static void HorizontalSSE42(const DOUBLE *src,DOUBLE *dst,ULONG count,
+			    const DOUBLE *taps,ULONG ntaps)
+{
+  ULONG x,i;
+  const ULONG n = (fixed)?(fixed):(ntaps);
+
+  for(x = 0;x + 4 <= count;x += 4) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    for(i = 0;i < n;i++) {
+      __m128d tap = _mm_set1_pd(taps[i]);
+      acc0 = _mm_add_pd(acc0,_mm_mul_pd(_mm_loadu_pd(src + x + i    ),tap));
+      acc1 = _mm_add_pd(acc1,_mm_mul_pd(_mm_loadu_pd(src + x + i + 2),tap));
+    }
+    _mm_storeu_pd(dst + x    ,acc0);
+    _mm_storeu_pd(dst + x + 2,acc1);
+  }
+  HorizontalScalar<fixed>(src + x,dst + x,count - x,taps,ntaps);
+}
+///
+
+/// VerticalSSE42
+template<ULONG fixed>
+__attribute__((target("sse4.2")))
+static void VerticalSSE42(const DOUBLE *const *rows,DOUBLE *dst,ULONG count,
+			  const DOUBLE *taps,ULONG ntaps)
+{
+  ULONG x,j;
+  const ULONG n = (fixed)?(fixed):(ntaps);
+
+  for(x = 0;x + 4 <= count;x += 4) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    for(j = 0;j < n;j++) {
+      __m128d tap = _mm_set1_pd(taps[j]);
+      acc0 = _mm_add_pd(acc0,_mm_mul_pd(_mm_loadu_pd(rows[j] + x    ),tap));
+      acc1 = _mm_add_pd(acc1,_mm_mul_pd(_mm_loadu_pd(rows[j] + x + 2),tap));
+    }
+    _mm_storeu_pd(dst + x    ,acc0);
+    _mm_storeu_pd(dst + x + 2,acc1);
+  }
+  VerticalRange<fixed>(rows,dst,x,count,taps,ntaps);
+}
+///
+
+/// SSIMSSE42
+template<bool luminance,bool store>
+__attribute__((target("sse4.2")))
+static DOUBLE SSIMSSE42(const DOUBLE *mu1,const DOUBLE *mu2,
+			const DOUBLE *xx,const DOUBLE *yy,const DOUBLE *xy,ULONG count,
+			DOUBLE c1,DOUBLE c2,DOUBLE c3,DOUBLE *ssim)
+{
+  DOUBLE part[8];
+  __m128d acc[4];
+  __m128d zero = _mm_setzero_pd();
+  __m128d one  = _mm_set1_pd(1.0);
+  __m128d two  = _mm_set1_pd(2.0);
+  __m128d vc1  = _mm_set1_pd(c1);
+  __m128d vc2  = _mm_set1_pd(c2);
+  __m128d vc3  = _mm_set1_pd(c3);
+  ULONG x;
+  int k;
+
+  for(k = 0;k < 4;k++)
+    acc[k] = zero;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    for(k = 0;k < 4;k++) {
+      ULONG o      = x + (k << 1);
+      __m128d m1   = _mm_loadu_pd(mu1 + o);
+      __m128d m2   = _mm_loadu_pd(mu2 + o);
+      __m128d var1 = _mm_max_pd(zero,_mm_sub_pd(_mm_loadu_pd(xx + o),_mm_mul_pd(m1,m1)));
+      __m128d var2 = _mm_max_pd(zero,_mm_sub_pd(_mm_loadu_pd(yy + o),_mm_mul_pd(m2,m2)));
+      __m128d cov  = _mm_sub_pd(_mm_loadu_pd(xy + o),_mm_mul_pd(m1,m2));
+      __m128d sd12 = _mm_sqrt_pd(_mm_mul_pd(var1,var2));
+      __m128d lum  = one;
+      __m128d con,str,s;
+      if (luminance)
+	lum = _mm_div_pd(_mm_add_pd(_mm_mul_pd(_mm_mul_pd(two,m1),m2),vc1),
+			 _mm_add_pd(_mm_add_pd(_mm_mul_pd(m1,m1),_mm_mul_pd(m2,m2)),vc1));
+      con = _mm_div_pd(_mm_add_pd(_mm_mul_pd(two,sd12),vc2),_mm_add_pd(_mm_add_pd(var1,var2),vc2));
+      str = _mm_div_pd(_mm_add_pd(cov,vc3),_mm_add_pd(sd12,vc3));
+      s   = _mm_mul_pd(_mm_mul_pd(lum,con),str);
+      if (store)
+	_mm_storeu_pd(ssim + o,s);
+      acc[k] = _mm_add_pd(acc[k],s);
+    }
+  }
+  for(k = 0;k < 4;k++)
+    _mm_storeu_pd(part + (k << 1),acc[k]);
+
+  SSIMTail<luminance,store>(mu1,mu2,xx,yy,xy,x,count,c1,c2,c3,ssim,part);
+
+  return PoolPartials(part);
+}
+///
+///
+
+/// AVX2 kernels
+
+/// ProductsAVX2
+__attribute__((target("avx2")))
+static void ProductsAVX2(const FLOAT *r1,const FLOAT *r2,ULONG count,
+			 DOUBLE *p1,DOUBLE *p2,DOUBLE *p11,DOUBLE *p22,DOUBLE *p12)
+{
+  ULONG x;
+
+  for(x = 0;x + 4 <= count;x += 4) {
+    __m256d k1 = _mm256_cvtps_pd(_mm_loadu_ps(r1 + x));
+    __m256d k2 = _mm256_cvtps_pd(_mm_loadu_ps(r2 + x));
+    _mm256_storeu_pd(p1  + x,k1);
+    _mm256_storeu_pd(p2  + x,k2);
+    _mm256_storeu_pd(p11 + x,_mm256_mul_pd(k1,k1));
+    _mm256_storeu_pd(p22 + x,_mm256_mul_pd(k2,k2));
+    _mm256_storeu_pd(p12 + x,_mm256_mul_pd(k1,k2));
+  }
+  ProductsScalar(r1 + x,r2 + x,count - x,p1 + x,p2 + x,p11 + x,p22 + x,p12 + x);
+}
+///
+
+/// HorizontalAVX2
+template<ULONG fixed>
+__attribute__((target("avx2")))
+static void HorizontalAVX2(const DOUBLE *src,DOUBLE *dst,ULONG count,
+			   const DOUBLE *taps,ULONG ntaps)
+{
+  ULONG x,i;
+  const ULONG n = (fixed)?(fixed):(ntaps);
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    for(i = 0;i < n;i++) {
+      __m256d tap = _mm256_set1_pd(taps[i]);
+      acc0 = _mm256_add_pd(acc0,_mm256_mul_pd(_mm256_loadu_pd(src + x + i    ),tap));
+      acc1 = _mm256_add_pd(acc1,_mm256_mul_pd(_mm256_loadu_pd(src + x + i + 4),tap));
+    }
+    _mm256_storeu_pd(dst + x    ,acc0);
+    _mm256_storeu_pd(dst + x + 4,acc1);
+  }
+  HorizontalScalar<fixed>(src + x,dst + x,count - x,taps,ntaps);
+}
+///
+
+/// VerticalAVX2
+template<ULONG fixed>
+__attribute__((target("avx2")))
+static void VerticalAVX2(const DOUBLE *const *rows,DOUBLE *dst,ULONG count,
+			 const DOUBLE *taps,ULONG ntaps)
+{
+  ULONG x,j;
+  const ULONG n = (fixed)?(fixed):(ntaps);
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    for(j = 0;j < n;j++) {
+      __m256d tap = _mm256_set1_pd(taps[j]);
+      acc0 = _mm256_add_pd(acc0,_mm256_mul_pd(_mm256_loadu_pd(rows[j] + x    ),tap));
+      acc1 = _mm256_add_pd(acc1,_mm256_mul_pd(_mm256_loadu_pd(rows[j] + x + 4),tap));
+    }
+    _mm256_storeu_pd(dst + x    ,acc0);
+    _mm256_storeu_pd(dst + x + 4,acc1);
+  }
+  VerticalRange<fixed>(rows,dst,x,count,taps,ntaps);
+}
+///
+
+/// SSIMAVX2
+template<bool luminance,bool store>
+__attribute__((target("avx2")))
+static DOUBLE SSIMAVX2(const DOUBLE *mu1,const DOUBLE *mu2,
+		       const DOUBLE *xx,const DOUBLE *yy,const DOUBLE *xy,ULONG count,
+		       DOUBLE c1,DOUBLE c2,DOUBLE c3,DOUBLE *ssim)
+{
+  DOUBLE part[8];
+  __m256d acc[2];
+  __m256d zero = _mm256_setzero_pd();
+  __m256d one  = _mm256_set1_pd(1.0);
+  __m256d two  = _mm256_set1_pd(2.0);
+  __m256d vc1  = _mm256_set1_pd(c1);
+  __m256d vc2  = _mm256_set1_pd(c2);
+  __m256d vc3  = _mm256_set1_pd(c3);
+  ULONG x;
+  int k;
+
+  acc[0] = zero;
+  acc[1] = zero;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    for(k = 0;k < 2;k++) {
+      ULONG o      = x + (k << 2);
+      __m256d m1   = _mm256_loadu_pd(mu1 + o);
+      __m256d m2   = _mm256_loadu_pd(mu2 + o);
+      __m256d var1 = _mm256_max_pd(zero,_mm256_sub_pd(_mm256_loadu_pd(xx + o),_mm256_mul_pd(m1,m1)));
+      __m256d var2 = _mm256_max_pd(zero,_mm256_sub_pd(_mm256_loadu_pd(yy + o),_mm256_mul_pd(m2,m2)));
+      __m256d cov  = _mm256_sub_pd(_mm256_loadu_pd(xy + o),_mm256_mul_pd(m1,m2));
+      __m256d sd12 = _mm256_sqrt_pd(_mm256_mul_pd(var1,var2));
+      __m256d lum  = one;
+      __m256d con,str,s;
+      if (luminance)
+	lum = _mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two,m1),m2),vc1),
+			    _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m1,m1),_mm256_mul_pd(m2,m2)),vc1));
+      con = _mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(two,sd12),vc2),
+			  _mm256_add_pd(_mm256_add_pd(var1,var2),vc2));
+      str = _mm256_div_pd(_mm256_add_pd(cov,vc3),_mm256_add_pd(sd12,vc3));
+      s   = _mm256_mul_pd(_mm256_mul_pd(lum,con),str);
+      if (store)
+	_mm256_storeu_pd(ssim + o,s);
+      acc[k] = _mm256_add_pd(acc[k],s);
+    }
+  }
+  _mm256_storeu_pd(part    ,acc[0]);
+  _mm256_storeu_pd(part + 4,acc[1]);
+
+  SSIMTail<luminance,store>(mu1,mu2,xx,yy,xy,x,count,c1,c2,c3,ssim,part);
+
+  return PoolPartials(part);
+}
+///
+///
+
+/// AVX-512 kernels
+
+/// ProductsAVX512
+__attribute__((target("avx512f")))
+static void ProductsAVX512(const FLOAT *r1,const FLOAT *r2,ULONG count,
+			   DOUBLE *p1,DOUBLE *p2,DOUBLE *p11,DOUBLE *p22,DOUBLE *p12)
+{
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m512d k1 = _mm512_cvtps_pd(_mm256_loadu_ps(r1 + x));
+    __m512d k2 = _mm512_cvtps_pd(_mm256_loadu_ps(r2 + x));
+    _mm512_storeu_pd(p1  + x,k1);
+    _mm512_storeu_pd(p2  + x,k2);
+    _mm512_storeu_pd(p11 + x,_mm512_mul_pd(k1,k1));
+    _mm512_storeu_pd(p22 + x,_mm512_mul_pd(k2,k2));
+    _mm512_storeu_pd(p12 + x,_mm512_mul_pd(k1,k2));
+  }
+  ProductsScalar(r1 + x,r2 + x,count - x,p1 + x,p2 + x,p11 + x,p22 + x,p12 + x);
+}
+///
+
+/// HorizontalAVX512
+template<ULONG fixed>
+__attribute__((target("avx512f")))
+static void HorizontalAVX512(const DOUBLE *src,DOUBLE *dst,ULONG count,
+			     const DOUBLE *taps,ULONG ntaps)
+{
+  ULONG x,i;
+  const ULONG n = (fixed)?(fixed):(ntaps);
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    for(i = 0;i < n;i++) {
+      __m512d tap = _mm512_set1_pd(taps[i]);
+      acc0 = _mm512_add_pd(acc0,_mm512_mul_pd(_mm512_loadu_pd(src + x + i    ),tap));
+      acc1 = _mm512_add_pd(acc1,_mm512_mul_pd(_mm512_loadu_pd(src + x + i + 8),tap));
+    }
+    _mm512_storeu_pd(dst + x    ,acc0);
+    _mm512_storeu_pd(dst + x + 8,acc1);
+  }
+  HorizontalScalar<fixed>(src + x,dst + x,count - x,taps,ntaps);
+}
+///
+
+/// VerticalAVX512
+template<ULONG fixed>
+__attribute__((target("avx512f")))
+static void VerticalAVX512(const DOUBLE *const *rows,DOUBLE *dst,ULONG count,
+			   const DOUBLE *taps,ULONG ntaps)
+{
+  ULONG x,j;
+  const ULONG n = (fixed)?(fixed):(ntaps);
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    for(j = 0;j < n;j++) {
+      __m512d tap = _mm512_set1_pd(taps[j]);
+      acc0 = _mm512_add_pd(acc0,_mm512_mul_pd(_mm512_loadu_pd(rows[j] + x    ),tap));
+      acc1 = _mm512_add_pd(acc1,_mm512_mul_pd(_mm512_loadu_pd(rows[j] + x + 8),tap));
+    }
+    _mm512_storeu_pd(dst + x    ,acc0);
+    _mm512_storeu_pd(dst + x + 8,acc1);
+  }
+  VerticalRange<fixed>(rows,dst,x,count,taps,ntaps);
+}
+///
+
+/// SSIMAVX512
+template<bool luminance,bool store>
+__attribute__((target("avx512f")))
+static DOUBLE SSIMAVX512(const DOUBLE *mu1,const DOUBLE *mu2,
+			 const DOUBLE *xx,const DOUBLE *yy,const DOUBLE *xy,ULONG count,
+			 DOUBLE c1,DOUBLE c2,DOUBLE c3,DOUBLE *ssim)
+{
+  DOUBLE part[8];
+  __m512d acc  = _mm512_setzero_pd();
+  __m512d zero = _mm512_setzero_pd();
+  __m512d one  = _mm512_set1_pd(1.0);
+  __m512d two  = _mm512_set1_pd(2.0);
+  __m512d vc1  = _mm512_set1_pd(c1);
+  __m512d vc2  = _mm512_set1_pd(c2);
+  __m512d vc3  = _mm512_set1_pd(c3);
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m512d m1   = _mm512_loadu_pd(mu1 + x);
+    __m512d m2   = _mm512_loadu_pd(mu2 + x);
+    __m512d var1 = _mm512_max_pd(zero,_mm512_sub_pd(_mm512_loadu_pd(xx + x),_mm512_mul_pd(m1,m1)));
+    __m512d var2 = _mm512_max_pd(zero,_mm512_sub_pd(_mm512_loadu_pd(yy + x),_mm512_mul_pd(m2,m2)));
+    __m512d cov  = _mm512_sub_pd(_mm512_loadu_pd(xy + x),_mm512_mul_pd(m1,m2));
+    __m512d sd12 = _mm512_sqrt_pd(_mm512_mul_pd(var1,var2));
+    __m512d lum  = one;
+    __m512d con,str,s;
+    if (luminance)
+      lum = _mm512_div_pd(_mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two,m1),m2),vc1),
+			  _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(m1,m1),_mm512_mul_pd(m2,m2)),vc1));
+    con = _mm512_div_pd(_mm512_add_pd(_mm512_mul_pd(two,sd12),vc2),
+			_mm512_add_pd(_mm512_add_pd(var1,var2),vc2));
+    str = _mm512_div_pd(_mm512_add_pd(cov,vc3),_mm512_add_pd(sd12,vc3));
+    s   = _mm512_mul_pd(_mm512_mul_pd(lum,con),str);
+    if (store)
+      _mm512_storeu_pd(ssim + x,s);
+    acc = _mm512_add_pd(acc,s);
+  }
+  _mm512_storeu_pd(part,acc);
+
+  SSIMTail<luminance,store>(mu1,mu2,xx,yy,xy,x,count,c1,c2,c3,ssim,part);
+
+  return PoolPartials(part);
+}
+///
+///
+#endif
+
+/// Kernel tables
+static const MomentKernels ScalarKernels = {
+  &ProductsScalar,&HorizontalScalar<0>,&VerticalScalar<0>,
+  &HorizontalScalar<MomentKernels::FixedTaps>,&VerticalScalar<MomentKernels::FixedTaps>,
+  {&SSIMScalar<false,false>,&SSIMScalar<false,true>,&SSIMScalar<true,false>,&SSIMScalar<true,true>}
+};
+#ifdef USE_X86_SIMD
+static const MomentKernels SSE42Kernels = {
+  &ProductsSSE42,&HorizontalSSE42<0>,&VerticalSSE42<0>,
+  &HorizontalSSE42<MomentKernels::FixedTaps>,&VerticalSSE42<MomentKernels::FixedTaps>,
+  {&SSIMSSE42<false,false>,&SSIMSSE42<false,true>,&SSIMSSE42<true,false>,&SSIMSSE42<true,true>}
+};
+static const MomentKernels AVX2Kernels = {
+  &ProductsAVX2,&HorizontalAVX2<0>,&VerticalAVX2<0>,
+  &HorizontalAVX2<MomentKernels::FixedTaps>,&VerticalAVX2<MomentKernels::FixedTaps>,
+  {&SSIMAVX2<false,false>,&SSIMAVX2<false,true>,&SSIMAVX2<true,false>,&SSIMAVX2<true,true>}
+};
+static const MomentKernels AVX512Kernels = {
+  &ProductsAVX512,&HorizontalAVX512<0>,&VerticalAVX512<0>,
+  &HorizontalAVX512<MomentKernels::FixedTaps>,&VerticalAVX512<MomentKernels::FixedTaps>,
+  {&SSIMAVX512<false,false>,&SSIMAVX512<false,true>,&SSIMAVX512<true,false>,&SSIMAVX512<true,true>}
+};
+#endif
+///
+
+/// MomentKernels::KernelsOf
+// Return the kernels for the given extension.
+const MomentKernels &MomentKernels::KernelsOf(CPU::Extension ext)
+{
+#ifdef USE_X86_SIMD
+  switch(ext) {
+  case CPU::AVX512:
+    return AVX512Kernels;
+  case CPU::AVX2:
+    return AVX2Kernels;
+  case CPU::SSE42:
+    return SSE42Kernels;
+  case CPU::Scalar:
+    break;
+  }
+#else
+  (void)ext;
+#endif
+  return ScalarKernels;
+}
+///
@@ -0,0 +1,112 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+#ifndef MOMENTS_MOMENTKERNELS_HPP
+#define MOMENTS_MOMENTKERNELS_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/cpu.hpp"
+///
+
+/// class MomentKernels
+// This class collects the inner loops of the moment filter and the
+// SSIM evaluation. Each kernel exists as scalar reference code, and
+// as SSE4.2, AVX2 and AVX-512 implementation. The implementation is
+// picked at run time for the widest extension the CPU provides.
+//
+// All implementations vectorize over the sample position and keep the
+// order of operations per sample, hence the moments are bit-exact
+// regardless of the implementation. The SSIM sum is pooled in eight
+// partial sums, again in the same order for all implementations.
+class MomentKernels {
+public:
+  //
+  // Compute the sample products x,y,x^2,y^2 and xy of one row of both images.
+  typedef void (*ProductsFunc)(const FLOAT *r1,const FLOAT *r2,ULONG count,
+			       DOUBLE *p1,DOUBLE *p2,DOUBLE *p11,DOUBLE *p22,DOUBLE *p12);
+  //
+  // Filter a row horizontally, i.e. dst[x] = \sum_i src[x+i] * taps[i].
+  typedef void (*HorizontalFunc)(const DOUBLE *src,DOUBLE *dst,ULONG count,
+				 const DOUBLE *taps,ULONG ntaps);
+  //
+  // Filter vertically over the given rows, dst[x] = \sum_j rows[j][x] * taps[j].
+  typedef void (*VerticalFunc)(const DOUBLE *const *rows,DOUBLE *dst,ULONG count,
+			       const DOUBLE *taps,ULONG ntaps);
+  //
+  // Compute the local SSIM of count windows from their raw moments, return
+  // the sum of the local SSIM values. Depending on the kernel, the local
+  // values are stored in ssim, and the luminance term is included.
+  typedef DOUBLE (*SSIMFunc)(const DOUBLE *mu1,const DOUBLE *mu2,
+			     const DOUBLE *xx,const DOUBLE *yy,const DOUBLE *xy,ULONG count,
+			     DOUBLE c1,DOUBLE c2,DOUBLE c3,DOUBLE *ssim);
+  //
+  // The number of taps the fixed size filters are specialized for, the
+  // size of the SSIM window.
+  enum {
+    FixedTaps = 11
+  };
+  //
+  ProductsFunc   Products;
+  HorizontalFunc Horizontal;
+  VerticalFunc   Vertical;
+  //
+  // The filters for exactly FixedTaps taps, ntaps is ignored.
+  HorizontalFunc HorizontalFixed;
+  VerticalFunc   VerticalFixed;
+  //
+  // The SSIM kernels, indexed by 2 * luminance + store, see SSIMOf.
+  SSIMFunc       SSIM[4];
+  //
+  // Return the horizontal and vertical filter for the given number of taps.
+  HorizontalFunc HorizontalOf(ULONG ntaps) const
+  {
+    return (ntaps == FixedTaps)?(HorizontalFixed):(Horizontal);
+  }
+  VerticalFunc VerticalOf(ULONG ntaps) const
+  {
+    return (ntaps == FixedTaps)?(VerticalFixed):(Vertical);
+  }
+  //
+  // Return the SSIM kernel that includes the luminance term if luminance
+  // is set, and stores the local values if store is set.
+  SSIMFunc SSIMOf(bool luminance,bool store) const
+  {
+    return SSIM[((luminance)?(2):(0)) + ((store)?(1):(0))];
+  }
+  //
+  // Return the kernels for the given extension. If the extension is not
+  // supported by this build, the next narrower one is returned.
+  static const MomentKernels &KernelsOf(CPU::Extension ext);
+  //
+  // Return the kernels for the widest extension available.
+  static const MomentKernels &KernelsOf(void)
+  {
+    return KernelsOf(CPU::ExtensionOf());
+  }
+};
+///
+
+///
+#endif
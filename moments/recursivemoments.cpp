@@ -0,0 +1,300 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class computes the windowed moments of two images by a
+** recursive approximation of the gaussian window, for large windows.
+*/
+
+/// Includes
+#include "moments/recursivemoments.hpp"
+#include "std/assert.hpp"
+#include "std/math.hpp"
+#include "std/string.hpp"
+///
+
+/// RecursiveMoments::MinSigma
+// Below this, the filter no longer approximates the gaussian.
+const DOUBLE RecursiveMoments::MinSigma = 0.5;
+///
+
+/// RecursiveMoments::RecursiveMoments
+// Prepare the moments of the windows whose top edge is in the rows first..last-1.
+RecursiveMoments::RecursiveMoments(const Matrix<FLOAT> &img1,const Matrix<FLOAT> &img2,ULONG w,ULONG h,
+				   DOUBLE sigma,ULONG first,ULONG last)
+  : m_pImg1(&img1), m_pImg2(&img2), m_ulWindowWidth(w), m_ulWindowHeight(h),
+    m_ulWidth(img1.WidthOf() - w + 1), m_ulImageWidth(img1.WidthOf()), m_ulMargin(MarginOf(sigma)),
+    m_ulTop(0), m_ulRows(0), m_ulLeft(0), m_ulColumns(0),
+    m_pdPlanes(NULL), m_pdFiltered(NULL), m_pdHistory(NULL), m_pdEdge(NULL),
+    m_pdProducts(NULL), m_pdLine(NULL)
+{
+  ULONG margin  = m_ulMargin;
+  ULONG height  = img1.HeightOf();
+  ULONG bottom  = last - 1 + (h >> 1) + 1; // the row below the last window center
+  ULONG span    = BlockWidthOf() + 2 * margin;
+  ULONG slotsize;
+  //
+  assert(img1.WidthOf()  == img2.WidthOf() && img1.HeightOf() == img2.HeightOf());
+  assert(img1.WidthOf()  >= w && img1.HeightOf() >= h);
+  assert(first < last && last + h - 1 <= height);
+  assert(sigma >= MinSigma);
+  //
+  CreateFilter(sigma);
+  //
+  // The rows of the window centers, plus the margin the filter settles in.
+  m_ulTop      = (first + (h >> 1) > margin)?(first + (h >> 1) - margin):(0);
+  bottom       = (bottom + margin < height)?(bottom + margin):(height);
+  m_ulRows     = bottom - m_ulTop;
+  //
+  // The columns of the window centers of a block, plus the margin.
+  if (span > m_ulImageWidth)
+    span = m_ulImageWidth;
+  slotsize     = MomentCount * BlockWidthOf();
+  m_pdPlanes   = new DOUBLE[m_ulRows * slotsize];
+  m_pdFiltered = new DOUBLE[m_ulRows * slotsize];
+  m_pdHistory  = new DOUBLE[4 * slotsize];
+  m_pdEdge     = new DOUBLE[slotsize];
+  m_pdProducts = new DOUBLE[MomentCount * span];
+  m_pdLine     = new DOUBLE[MomentCount * span];
+}
+///
+
+/// RecursiveMoments::FilterBlock
+// Compute the moments of the windows whose left edge is in the columns
+// left..right-1.
+void RecursiveMoments::FilterBlock(ULONG left,ULONG right)
+{
+  const MomentKernels &kernels = MomentKernels::KernelsOf();
+  ULONG center = m_ulWindowWidth >> 1;
+  ULONG end    = right + center + m_ulMargin; // the column behind the last one filtered
+  ULONG x0,span,slotsize,r;
+  //
+  assert(left < right && right <= m_ulWidth && right - left <= BlockWidthOf());
+  //
+  m_ulLeft    = left;
+  m_ulColumns = right - left;
+  slotsize    = MomentCount * m_ulColumns;
+  x0          = (left + center > m_ulMargin)?(left + center - m_ulMargin):(0);
+  end         = (end < m_ulImageWidth)?(end):(m_ulImageWidth);
+  span        = end - x0;
+  //
+  // Filter the rows horizontally, and keep the moments at the window centers.
+  for(r = 0;r < m_ulRows;r++) {
+    DOUBLE *slot = m_pdPlanes + r * slotsize;
+    //
+    kernels.Products(&m_pImg1->At(x0,m_ulTop + r),&m_pImg2->At(x0,m_ulTop + r),span,
+		     m_pdProducts,m_pdProducts + span,m_pdProducts + 2 * span,
+		     m_pdProducts + 3 * span,m_pdProducts + 4 * span);
+    FilterRow(slot,x0,span);
+  }
+  //
+  FilterColumns();
+}
+///
+
+/// RecursiveMoments::~RecursiveMoments
+RecursiveMoments::~RecursiveMoments(void)
+{
+  delete[] m_pdPlanes;
+  delete[] m_pdFiltered;
+  delete[] m_pdHistory;
+  delete[] m_pdEdge;
+  delete[] m_pdProducts;
+  delete[] m_pdLine;
+}
+///
+
+/// RecursiveMoments::MarginOf
+// Return the number of image rows above and below the window rows
+// the vertical filter runs over to settle.
+ULONG RecursiveMoments::MarginOf(DOUBLE sigma)
+{
+  return ULONG(ceil(5.0 * sigma));
+}
+///
+
+/// RecursiveMoments::CreateFilter
+// Compute the coefficients for the standard deviation sigma, from
+// Deriche, "Recursively implementing the gaussian and its derivatives",
+// INRIA research report 1893, 1993.
+void RecursiveMoments::CreateFilter(DOUBLE sigma)
+{
+  const DOUBLE a0 = 1.680,a1 = 3.735,b0 = 1.783,b1 = 1.723;
+  const DOUBLE c0 = -0.6803,c1 = -0.2598,w0 = 0.6318,w1 = 1.997;
+  DOUBLE cw0 = cos(w0 / sigma),sw0 = sin(w0 / sigma);
+  DOUBLE cw1 = cos(w1 / sigma),sw1 = sin(w1 / sigma);
+  DOUBLE e0  = exp(-b0 / sigma),e1 = exp(-b1 / sigma);
+  DOUBLE nsum,msum,dsum,gain;
+  int k;
+  //
+  m_dN[0] = a0 + c0;
+  m_dN[1] = e1 * (c1 * sw1 - (c0 + 2.0 * a0) * cw1) + e0 * (a1 * sw0 - (2.0 * c0 + a0) * cw0);
+  m_dN[2] = 2.0 * e0 * e1 * ((a0 + c0) * cw1 * cw0 - a1 * cw1 * sw0 - c1 * cw0 * sw1) +
+    c0 * e0 * e0 + a0 * e1 * e1;
+  m_dN[3] = e1 * e0 * e0 * (c1 * sw1 - c0 * cw1) + e0 * e1 * e1 * (a1 * sw0 - a0 * cw0);
+  m_dD[0] = -2.0 * e1 * cw1 - 2.0 * e0 * cw0;
+  m_dD[1] = 4.0 * cw1 * cw0 * e0 * e1 + e1 * e1 + e0 * e0;
+  m_dD[2] = -2.0 * cw0 * e0 * e1 * e1 - 2.0 * cw1 * e1 * e0 * e0;
+  m_dD[3] = e0 * e0 * e1 * e1;
+  //
+  // The anti-causal filter mirrors the causal one, without the center tap.
+  for(k = 0;k < 3;k++)
+    m_dM[k] = m_dN[k + 1] - m_dD[k] * m_dN[0];
+  m_dM[3] = -m_dD[3] * m_dN[0];
+  //
+  // Normalize to a total gain of one.
+  nsum = m_dN[0] + m_dN[1] + m_dN[2] + m_dN[3];
+  msum = m_dM[0] + m_dM[1] + m_dM[2] + m_dM[3];
+  dsum = 1.0 + m_dD[0] + m_dD[1] + m_dD[2] + m_dD[3];
+  gain = (nsum + msum) / dsum;
+  for(k = 0;k < 4;k++) {
+    m_dN[k] /= gain;
+    m_dM[k] /= gain;
+  }
+  m_dCausalGain = nsum / gain / dsum;
+  m_dAntiGain   = msum / gain / dsum;
+}
+///
+
+/// RecursiveMoments::FilterRow
+// Run the causal and the anti-causal filter over the products of the
+// span image columns from x0 on in m_pdProducts, and place their sums at
+// the window centers of the current block into the slot. Samples beyond
+// the ends continue the edge samples. The products are filtered together,
+// as the recursions of the individual products depend on each other's
+// latency otherwise.
+void RecursiveMoments::FilterRow(DOUBLE *slot,ULONG x0,ULONG span)
+{
+  ULONG width  = span;
+  ULONG first  = m_ulLeft + (m_ulWindowWidth >> 1) - x0; // the column of the first window center
+  DOUBLE x1[MomentCount],x2[MomentCount],x3[MomentCount],x4[MomentCount];
+  DOUBLE y1[MomentCount],y2[MomentCount],y3[MomentCount],y4[MomentCount];
+  DOUBLE *line = m_pdLine;
+  ULONG i,q;
+  //
+  // The causal filter, into the line buffer, interleaved.
+  for(q = 0;q < MomentCount;q++) {
+    DOUBLE x0 = m_pdProducts[q * width];
+    x1[q] = x2[q] = x3[q] = x0;
+    y1[q] = y2[q] = y3[q] = y4[q] = x0 * m_dCausalGain;
+  }
+  for(i = 0;i < width;i++) {
+    for(q = 0;q < MomentCount;q++) {
+      DOUBLE x0 = m_pdProducts[q * width + i];
+      DOUBLE v  = m_dN[0] * x0 + m_dN[1] * x1[q] + m_dN[2] * x2[q] + m_dN[3] * x3[q]
+	- m_dD[0] * y1[q] - m_dD[1] * y2[q] - m_dD[2] * y3[q] - m_dD[3] * y4[q];
+      x3[q] = x2[q];x2[q] = x1[q];x1[q] = x0;
+      y4[q] = y3[q];y3[q] = y2[q];y2[q] = y1[q];y1[q] = v;
+      line[i * MomentCount + q] = v;
+    }
+  }
+  //
+  // The anti-causal filter, added to the causal one.
+  for(q = 0;q < MomentCount;q++) {
+    DOUBLE xn = m_pdProducts[q * width + width - 1];
+    x1[q] = x2[q] = x3[q] = x4[q] = xn;
+    y1[q] = y2[q] = y3[q] = y4[q] = xn * m_dAntiGain;
+  }
+  for(i = width;i > 0;i--) {
+    for(q = 0;q < MomentCount;q++) {
+      DOUBLE v  = m_dM[0] * x1[q] + m_dM[1] * x2[q] + m_dM[2] * x3[q] + m_dM[3] * x4[q]
+	- m_dD[0] * y1[q] - m_dD[1] * y2[q] - m_dD[2] * y3[q] - m_dD[3] * y4[q];
+      x4[q] = x3[q];x3[q] = x2[q];x2[q] = x1[q];x1[q] = m_pdProducts[q * width + i - 1];
+      y4[q] = y3[q];y3[q] = y2[q];y2[q] = y1[q];y1[q] = v;
+      if (i - 1 >= first && i - 1 < first + m_ulColumns)
+	slot[q * m_ulColumns + i - 1 - first] = line[(i - 1) * MomentCount + q] + v;
+    }
+  }
+}
+///
+
+/// RecursiveMoments::FilterColumns
+// Run the causal and the anti-causal filter vertically over the kept
+// rows. All columns of the block of all moments are filtered at once,
+// row by row. Rows beyond the kept rows continue the edge rows.
+void RecursiveMoments::FilterColumns(void)
+{
+  ULONG slotsize = MomentCount * m_ulColumns;
+  ULONG last     = m_ulRows - 1;
+  const DOUBLE *x[4],*y[4];
+  ULONG r,i;
+  int k;
+  //
+  // The causal filter, from top to bottom. Its output above the first
+  // row is that of a constant input.
+  for(i = 0;i < slotsize;i++)
+    m_pdEdge[i] = m_pdPlanes[i] * m_dCausalGain;
+  for(r = 0;r < m_ulRows;r++) {
+    DOUBLE *out      = m_pdFiltered + r * slotsize;
+    const DOUBLE *in = m_pdPlanes + r * slotsize;
+    for(k = 0;k < 4;k++) {
+      x[k] = m_pdPlanes   + ((r > ULONG(k))?(r - k - 1):(0)) * slotsize;
+      y[k] = (r > ULONG(k))?(m_pdFiltered + (r - k - 1) * slotsize):(m_pdEdge);
+    }
+    for(i = 0;i < slotsize;i++)
+      out[i] = m_dN[0] * in[i] + m_dN[1] * x[0][i] + m_dN[2] * x[1][i] + m_dN[3] * x[2][i]
+	- m_dD[0] * y[0][i] - m_dD[1] * y[1][i] - m_dD[2] * y[2][i] - m_dD[3] * y[3][i];
+  }
+  //
+  // The anti-causal filter, from bottom to top. Its output of the last
+  // four rows is kept in the history, the row r in slot r modulo four.
+  for(i = 0;i < slotsize;i++)
+    m_pdEdge[i] = m_pdPlanes[last * slotsize + i] * m_dAntiGain;
+  for(r = m_ulRows;r > 0;r--) {
+    DOUBLE *out  = m_pdFiltered + (r - 1) * slotsize;
+    DOUBLE *hist = m_pdHistory  + ((r - 1) & 3) * slotsize;
+    for(k = 0;k < 4;k++) {
+      x[k] = m_pdPlanes + ((r + k <= last)?(r + k):(last)) * slotsize;
+      y[k] = (r + k <= last)?(m_pdHistory + ((r + k) & 3) * slotsize):(m_pdEdge);
+    }
+    for(i = 0;i < slotsize;i++) {
+      // Note that hist is y[3], which is read before it is overwritten.
+      DOUBLE v = m_dM[0] * x[0][i] + m_dM[1] * x[1][i] + m_dM[2] * x[2][i] + m_dM[3] * x[3][i]
+	- m_dD[0] * y[0][i] - m_dD[1] * y[1][i] - m_dD[2] * y[2][i] - m_dD[3] * y[3][i];
+      hist[i]  = v;
+      out[i]  += v;
+    }
+  }
+}
+///
+
+/// RecursiveMoments::MomentsOf
+// Compute the moments of the windows of the current block whose top edge
+// is at image row y.
+void RecursiveMoments::MomentsOf(ULONG y,DOUBLE *mu1,DOUBLE *mu2,DOUBLE *xx,DOUBLE *yy,DOUBLE *xy) const
+{
+  ULONG slotsize      = MomentCount * m_ulColumns;
+  ULONG r             = y + (m_ulWindowHeight >> 1) - m_ulTop;
+  const DOUBLE *slot  = m_pdFiltered + r * slotsize;
+  ULONG bytes         = m_ulColumns * sizeof(DOUBLE);
+  //
+  assert(y + (m_ulWindowHeight >> 1) >= m_ulTop && r < m_ulRows);
+  assert(m_ulColumns > 0);
+  //
+  memcpy(mu1,slot,bytes);
+  memcpy(mu2,slot + m_ulColumns,bytes);
+  memcpy(xx ,slot + 2 * m_ulColumns,bytes);
+  memcpy(yy ,slot + 3 * m_ulColumns,bytes);
+  memcpy(xy ,slot + 4 * m_ulColumns,bytes);
+}
+///
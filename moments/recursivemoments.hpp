@@ -0,0 +1,178 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class computes the windowed moments of two images by a
+** recursive approximation of the gaussian window, for large windows.
+*/
+
+#ifndef MOMENTS_RECURSIVEMOMENTS_HPP
+#define MOMENTS_RECURSIVEMOMENTS_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/matrix.hpp"
+#include "moments/momentkernels.hpp"
+///
+
+/// class RecursiveMoments
+// This class computes the same moments as SeparableMoments, i.e. the
+// local means, the second moments and the correlation of two images,
+// for the same window positions, but the gaussian window is replaced
+// by the fourth order recursive filter of Deriche: The sum of a causal
+// and an anti-causal filter, run horizontally along the image rows and
+// then vertically along the columns. The cost per window position is
+// thus constant, regardless of the size of the window and its standard
+// deviation.
+//
+// The recursive filter approximates the untruncated gaussian, with a
+// largest deviation of about 5e-4 relative to the peak of its impulse
+// response, and is evaluated at the centers of the windows. The window
+// should cover at least three standard deviations to each side to
+// compare well. The filter is started at the image edges as if the
+// edge samples continued. The vertical recursion covers the rows of the
+// window rows to compute, plus MarginOf(sigma) rows to each side to let
+// the filter settle. To bound the memory, the moments are computed for
+// blocks of at most BlockColumns window columns at once, all window rows
+// of a block upfront. The horizontal recursion of a block likewise
+// covers MarginOf(sigma) columns to each side of the block.
+class RecursiveMoments {
+  //
+  // The number of moments we compute, and the number of window columns
+  // of a block.
+  enum {
+    MomentCount  = 5,
+    BlockColumns = 512
+  };
+  //
+  // The images.
+  const Matrix<FLOAT> *m_pImg1;
+  const Matrix<FLOAT> *m_pImg2;
+  //
+  // Dimensions of the window.
+  ULONG   m_ulWindowWidth;
+  ULONG   m_ulWindowHeight;
+  //
+  // Number of window positions within a row.
+  ULONG   m_ulWidth;
+  //
+  // Width of the images.
+  ULONG   m_ulImageWidth;
+  //
+  // The number of columns and rows to each side the filter settles in.
+  ULONG   m_ulMargin;
+  //
+  // The first image row kept, and the number of rows kept.
+  ULONG   m_ulTop;
+  ULONG   m_ulRows;
+  //
+  // The first window column of the current block, and its number of
+  // window columns.
+  ULONG   m_ulLeft;
+  ULONG   m_ulColumns;
+  //
+  // The coefficients of the causal filter on the input, n0..n3, and of
+  // the anti-causal filter on the input, m1..m4, both normalized to a
+  // total gain of one, and the feedback coefficients d1..d4 of both.
+  DOUBLE  m_dN[4];
+  DOUBLE  m_dM[4];
+  DOUBLE  m_dD[4];
+  //
+  // The output of the causal and the anti-causal filter on a constant
+  // input of one.
+  DOUBLE  m_dCausalGain;
+  DOUBLE  m_dAntiGain;
+  //
+  // The horizontally filtered moments, MomentCount rows of m_ulColumns
+  // entries per image row kept, sampled at the window centers of the
+  // current block, and the same filtered vertically.
+  DOUBLE *m_pdPlanes;
+  DOUBLE *m_pdFiltered;
+  //
+  // The output of the anti-causal filter for the last four rows, and
+  // the output of either filter beyond the kept rows.
+  DOUBLE *m_pdHistory;
+  DOUBLE *m_pdEdge;
+  //
+  // Products of the samples of the columns of a single image row the
+  // horizontal filter runs over, i.e. x,y,x^2,y^2,xy, and their causally
+  // filtered values, interleaved.
+  DOUBLE *m_pdProducts;
+  DOUBLE *m_pdLine;
+  //
+  // Compute the coefficients for the standard deviation sigma.
+  void CreateFilter(DOUBLE sigma);
+  //
+  // Run the causal and the anti-causal filter over the products of the
+  // span image columns starting at column x0, and place their sums at
+  // the window centers of the current block into the slot.
+  void FilterRow(DOUBLE *slot,ULONG x0,ULONG span);
+  //
+  // Run the causal and the anti-causal filter vertically over the kept
+  // rows of m_pdPlanes into m_pdFiltered.
+  void FilterColumns(void);
+  //
+public:
+  // Prepare the computation of the moments of the windows of the two
+  // images whose top edge is in the rows first..last-1. The window is
+  // w x h large, and the gaussian has the standard deviation sigma.
+  RecursiveMoments(const Matrix<FLOAT> &img1,const Matrix<FLOAT> &img2,ULONG w,ULONG h,DOUBLE sigma,
+		   ULONG first,ULONG last);
+  //
+  ~RecursiveMoments(void);
+  //
+  // The smallest standard deviation the filter is defined for.
+  static const DOUBLE MinSigma;
+  //
+  // Return the number of image rows above and below the window rows
+  // the vertical filter runs over to settle.
+  static ULONG MarginOf(DOUBLE sigma);
+  //
+  // Return the number of window positions within a row, i.e. the number
+  // of entries the moment rows require.
+  ULONG WidthOf(void) const
+  {
+    return m_ulWidth;
+  }
+  //
+  // Return the largest number of window columns of a block, i.e. the
+  // number of entries the moment rows of a block require.
+  ULONG BlockWidthOf(void) const
+  {
+    return (m_ulWidth < ULONG(BlockColumns))?(m_ulWidth):(ULONG(BlockColumns));
+  }
+  //
+  // Compute the moments of the windows whose left edge is in the
+  // columns left..right-1, for all window rows. At most BlockWidthOf()
+  // columns can be computed at once.
+  void FilterBlock(ULONG left,ULONG right);
+  //
+  // Compute the moments of the windows of the current block whose top
+  // edge is at image row y, which must be in the rows the moments were
+  // computed for.
+  void MomentsOf(ULONG y,DOUBLE *mu1,DOUBLE *mu2,DOUBLE *xx,DOUBLE *yy,DOUBLE *xy) const;
+};
+///
+
+///
+#endif
@@ -0,0 +1,63 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class keeps the windowed moments of a reference image that
+** is compared against many distorted images.
+*/
+
+/// Includes
+#include "moments/referencemoments.hpp"
+#include "moments/separablemoments.hpp"
+#include "std/string.hpp"
+///
+
+/// ReferenceMoments::ReferenceMoments
+// Compute the moments of the given image under the given window.
+ReferenceMoments::ReferenceMoments(const Matrix<FLOAT> &img,const Matrix<DOUBLE> &window)
+{
+  ULONG w = window.WidthOf();
+  ULONG h = window.HeightOf();
+  //
+  if (img.WidthOf() >= w && img.HeightOf() >= h) {
+    // The moments of the image against itself provide the moments of
+    // the first image exactly as they are computed for a comparison.
+    SeparableMoments moments(img,img,window);
+    ULONG width  = moments.WidthOf();
+    ULONG height = img.HeightOf() - h + 1;
+    DOUBLE *mu   = new DOUBLE[3 * width];
+    DOUBLE *xx   = mu + width;
+    DOUBLE *tmp  = xx + width;
+    ULONG y;
+    //
+    m_Mean.Allocate(width,height);
+    m_Square.Allocate(width,height);
+    for(y = 0;y < height;y++) {
+      moments.MomentsOf(y,mu,tmp,xx,tmp,tmp);
+      memcpy(&m_Mean.At(0,y),mu,width * sizeof(DOUBLE));
+      memcpy(&m_Square.At(0,y),xx,width * sizeof(DOUBLE));
+    }
+    delete[] mu;
+  }
+}
+///
@@ -0,0 +1,76 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class keeps the windowed moments of a reference image that
+** is compared against many distorted images.
+*/
+
+#ifndef MOMENTS_REFERENCEMOMENTS_HPP
+#define MOMENTS_REFERENCEMOMENTS_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/matrix.hpp"
+///
+
+/// class ReferenceMoments
+// This class computes and keeps the local means and second moments
+// E[x^2] of a single image for all window positions, such that
+// subsequent comparisons only have to compute the moments that depend
+// on the distorted image. The moments are identical to those computed
+// by SeparableMoments, hence results do not depend on whether the
+// cached moments are used or not.
+class ReferenceMoments {
+  //
+  // The local means, one entry per window position.
+  Matrix<DOUBLE> m_Mean;
+  //
+  // The local second moments E[x^2].
+  Matrix<DOUBLE> m_Square;
+  //
+public:
+  // Compute the moments of the given image under the given window. If
+  // the image is smaller than the window, no moments are kept.
+  ReferenceMoments(const Matrix<FLOAT> &img,const Matrix<DOUBLE> &window);
+  //
+  ~ReferenceMoments(void)
+  { }
+  //
+  // Return the local means of the windows whose top edge is at row y.
+  const DOUBLE *MeanOf(ULONG y) const
+  {
+    return &m_Mean.At(0,y);
+  }
+  //
+  // Return the local second moments of the windows whose top edge is
+  // at row y.
+  const DOUBLE *SquareOf(ULONG y) const
+  {
+    return &m_Square.At(0,y);
+  }
+};
+///
+
+///
+#endif
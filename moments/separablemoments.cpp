@@ -0,0 +1,197 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+/// Includes
+#include "moments/separablemoments.hpp"
+#include "std/assert.hpp"
+#include "std/math.hpp"
+///
+
+/// SeparableMoments::SeparableMoments
+// Prepare the moment computation of the two images under the given window.
+SeparableMoments::SeparableMoments(const Matrix<FLOAT> &img1,const Matrix<FLOAT> &img2,
+				   const Matrix<DOUBLE> &window,bool crossonly)
+  : m_pImg1(&img1), m_pImg2(&img2),
+    m_ulWindowWidth(window.WidthOf()), m_ulWindowHeight(window.HeightOf()),
+    m_ulWidth(img1.WidthOf() - window.WidthOf() + 1), m_ulImageWidth(img1.WidthOf()),
+    m_pdHorizontal(NULL), m_pdVertical(NULL), m_pdRing(NULL), m_plRingRow(NULL), m_pdProducts(NULL),
+    m_ppdRows(NULL), m_ppfRows1(NULL), m_ppfRows2(NULL),
+    m_Kernels(MomentKernels::KernelsOf()),
+    m_pHorizontal(m_Kernels.HorizontalOf(m_ulWindowWidth)), m_pVertical(m_Kernels.VerticalOf(m_ulWindowHeight)),
+    m_bCrossOnly(crossonly)
+{
+  assert(img1.WidthOf()  == img2.WidthOf() && img1.HeightOf() == img2.HeightOf());
+  assert(img1.WidthOf()  >= m_ulWindowWidth);
+  assert(img1.HeightOf() >= m_ulWindowHeight);
+  //
+  CreateFilters(window);
+  m_ppfRows1     = new const FLOAT *[m_ulWindowHeight];
+  m_ppfRows2     = new const FLOAT *[m_ulWindowHeight];
+}
+///
+
+/// SeparableMoments::SeparableMoments
+// Prepare the moment computation of two images of the given width
+// whose rows are provided by the caller.
+SeparableMoments::SeparableMoments(ULONG width,const Matrix<DOUBLE> &window,bool crossonly)
+  : m_pImg1(NULL), m_pImg2(NULL),
+    m_ulWindowWidth(window.WidthOf()), m_ulWindowHeight(window.HeightOf()),
+    m_ulWidth(width - window.WidthOf() + 1), m_ulImageWidth(width),
+    m_pdHorizontal(NULL), m_pdVertical(NULL), m_pdRing(NULL), m_plRingRow(NULL), m_pdProducts(NULL),
+    m_ppdRows(NULL), m_ppfRows1(NULL), m_ppfRows2(NULL),
+    m_Kernels(MomentKernels::KernelsOf()),
+    m_pHorizontal(m_Kernels.HorizontalOf(m_ulWindowWidth)), m_pVertical(m_Kernels.VerticalOf(m_ulWindowHeight)),
+    m_bCrossOnly(crossonly)
+{
+  assert(width >= m_ulWindowWidth);
+  //
+  CreateFilters(window);
+}
+///
+
+/// SeparableMoments::CreateFilters
+// Allocate the ring and compute the marginals of the window.
+void SeparableMoments::CreateFilters(const Matrix<DOUBLE> &window)
+{
+  ULONG x,y;
+  //
+  m_pdHorizontal = new DOUBLE[m_ulWindowWidth];
+  m_pdVertical   = new DOUBLE[m_ulWindowHeight];
+  m_pdRing       = new DOUBLE[m_ulWindowHeight * MomentCount * m_ulWidth];
+  m_plRingRow    = new LONG[m_ulWindowHeight];
+  m_pdProducts   = new DOUBLE[MomentCount * m_ulImageWidth];
+  m_ppdRows      = new const DOUBLE *[m_ulWindowHeight];
+  //
+  // The window is normalized to one, and separable, hence it is the product
+  // of its marginals.
+  for(x = 0;x < m_ulWindowWidth;x++) {
+    DOUBLE sum = 0.0;
+    for(y = 0;y < m_ulWindowHeight;y++)
+      sum += window.Get(x,y);
+    m_pdHorizontal[x] = sum;
+  }
+  for(y = 0;y < m_ulWindowHeight;y++) {
+    DOUBLE sum = 0.0;
+    for(x = 0;x < m_ulWindowWidth;x++)
+      sum += window.Get(x,y);
+    m_pdVertical[y] = sum;
+    m_plRingRow[y]  = -1;
+  }
+#if CHECK_LEVEL > 0
+  for(y = 0;y < m_ulWindowHeight;y++) {
+    for(x = 0;x < m_ulWindowWidth;x++) {
+      assert(fabs(m_pdHorizontal[x] * m_pdVertical[y] - window.Get(x,y)) < 1e-12);
+    }
+  }
+#endif
+}
+///
+
+/// SeparableMoments::~SeparableMoments
+SeparableMoments::~SeparableMoments(void)
+{
+  delete[] m_pdHorizontal;
+  delete[] m_pdVertical;
+  delete[] m_pdRing;
+  delete[] m_plRingRow;
+  delete[] m_pdProducts;
+  delete[] m_ppdRows;
+  delete[] m_ppfRows1;
+  delete[] m_ppfRows2;
+}
+///
+
+/// SeparableMoments::FilterRow
+// Filter the moments of the given image rows horizontally into the
+// given ring slot.
+void SeparableMoments::FilterRow(const FLOAT *row1,const FLOAT *row2,DOUBLE *slot)
+{
+  ULONG width = m_ulImageWidth;
+  ULONG q;
+  //
+  m_Kernels.Products(row1,row2,width,
+		     m_pdProducts,m_pdProducts + width,m_pdProducts + 2 * width,
+		     m_pdProducts + 3 * width,m_pdProducts + 4 * width);
+  //
+  for(q = 0;q < MomentCount;q++) {
+    if (IsComputed(q))
+      m_pHorizontal(m_pdProducts + q * width,slot + q * m_ulWidth,m_ulWidth,
+		    m_pdHorizontal,m_ulWindowWidth);
+  }
+}
+///
+
+/// SeparableMoments::MomentsOf
+// Compute the moments of all windows whose top edge is at image row y.
+void SeparableMoments::MomentsOf(ULONG y,DOUBLE *mu1,DOUBLE *mu2,DOUBLE *xx,DOUBLE *yy,DOUBLE *xy)
+{
+  ULONG j;
+  //
+  assert(m_pImg1 && m_pImg2);
+  assert(y + m_ulWindowHeight <= m_pImg1->HeightOf());
+  //
+  for(j = 0;j < m_ulWindowHeight;j++) {
+    m_ppfRows1[j] = &m_pImg1->At(0,y + j);
+    m_ppfRows2[j] = &m_pImg2->At(0,y + j);
+  }
+  MomentsOf(y,m_ppfRows1,m_ppfRows2,mu1,mu2,xx,yy,xy);
+}
+///
+
+/// SeparableMoments::MomentsOf
+// Compute the moments of all windows whose top edge is at image row y,
+// from the image rows provided by the caller.
+void SeparableMoments::MomentsOf(ULONG y,const FLOAT *const *rows1,const FLOAT *const *rows2,
+				 DOUBLE *mu1,DOUBLE *mu2,DOUBLE *xx,DOUBLE *yy,DOUBLE *xy)
+{
+  ULONG slotsize = MomentCount * m_ulWidth;
+  DOUBLE *target[MomentCount];
+  ULONG j,q;
+  //
+  // Make sure all image rows covered by the window are filtered
+  // horizontally. Rows filtered for the previous window row are reused.
+  for(j = 0;j < m_ulWindowHeight;j++) {
+    ULONG row = y + j;
+    ULONG pos = row % m_ulWindowHeight;
+    if (m_plRingRow[pos] != LONG(row)) {
+      FilterRow(rows1[j],rows2[j],m_pdRing + pos * slotsize);
+      m_plRingRow[pos] = row;
+    }
+  }
+  //
+  // Now run the vertical filter over the ring.
+  target[0] = mu1;
+  target[1] = mu2;
+  target[2] = xx;
+  target[3] = yy;
+  target[4] = xy;
+  for(q = 0;q < MomentCount;q++) {
+    if (!IsComputed(q))
+      continue;
+    for(j = 0;j < m_ulWindowHeight;j++)
+      m_ppdRows[j] = m_pdRing + ((y + j) % m_ulWindowHeight) * slotsize + q * m_ulWidth;
+    m_pVertical(m_ppdRows,target[q],m_ulWidth,m_pdVertical,m_ulWindowHeight);
+  }
+}
+///
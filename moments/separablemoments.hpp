@@ -0,0 +1,153 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+#ifndef MOMENTS_SEPARABLEMOMENTS_HPP
+#define MOMENTS_SEPARABLEMOMENTS_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/matrix.hpp"
+#include "moments/momentkernels.hpp"
+///
+
+/// class SeparableMoments
+// This class computes the windowed first and second order moments of
+// two images, i.e. the local means mu1 and mu2, the second moments
+// E[x^2], E[y^2] and the correlation E[xy], for all window positions
+// of a window row. The window function must be separable. Instead of
+// summing over all w*h taps per window position, image rows are first
+// filtered horizontally and kept in a ring buffer of h rows, from which
+// the vertical pass is then computed. This costs 5*(w+h) instead of
+// 5*w*h multiply-adds per window position.
+// If the moments of the first image are known already, e.g. because it
+// is the reference of many comparisons, the class can be restricted to
+// the moments that depend on the second image, i.e. mu2, E[y^2] and E[xy].
+// The image rows are either taken from two matrices, or handed in by
+// the caller, e.g. if the images are streamed and only the rows covered
+// by the window are available.
+class SeparableMoments {
+  //
+  // The number of moments we compute.
+  enum {
+    MomentCount = 5
+  };
+  //
+  // The two images whose moments are computed, or NULL if the caller
+  // provides the image rows.
+  const Matrix<FLOAT> *m_pImg1;
+  const Matrix<FLOAT> *m_pImg2;
+  //
+  // Dimensions of the window.
+  ULONG   m_ulWindowWidth;
+  ULONG   m_ulWindowHeight;
+  //
+  // Number of window positions within a row.
+  ULONG   m_ulWidth;
+  //
+  // Width of the images.
+  ULONG   m_ulImageWidth;
+  //
+  // The horizontal and vertical filter taps, the marginals of the window.
+  DOUBLE *m_pdHorizontal;
+  DOUBLE *m_pdVertical;
+  //
+  // Horizontally filtered moments, one slot of MomentCount rows
+  // per image row, keeping the last m_ulWindowHeight image rows.
+  DOUBLE *m_pdRing;
+  //
+  // The image row kept in each slot of the ring, or -1 if the slot is
+  // not yet filled.
+  LONG   *m_plRingRow;
+  //
+  // Products of the samples of a single image row, i.e. x,y,x^2,y^2,xy.
+  DOUBLE *m_pdProducts;
+  //
+  // The ring rows covered by the current window row, in window order.
+  const DOUBLE **m_ppdRows;
+  //
+  // The image rows covered by the current window row if they are taken
+  // from the matrices.
+  const FLOAT  **m_ppfRows1;
+  const FLOAT  **m_ppfRows2;
+  //
+  // The inner loops, for the vector extension of this CPU.
+  const MomentKernels &m_Kernels;
+  //
+  // The filters picked for the window size.
+  MomentKernels::HorizontalFunc m_pHorizontal;
+  MomentKernels::VerticalFunc   m_pVertical;
+  //
+  // If set, only the moments depending on the second image are computed.
+  bool    m_bCrossOnly;
+  //
+  // Check whether the moment with the given index is computed.
+  bool IsComputed(ULONG q) const
+  {
+    // The moments 0 and 2 are mu1 and E[x^2], depending on the first image only.
+    return !m_bCrossOnly || (q != 0 && q != 2);
+  }
+  //
+  // Allocate the ring and compute the marginals of the window.
+  void CreateFilters(const Matrix<DOUBLE> &window);
+  //
+  // Filter the moments of the given image rows horizontally into the
+  // given ring slot.
+  void FilterRow(const FLOAT *row1,const FLOAT *row2,DOUBLE *slot);
+  //
+public:
+  // Prepare the moment computation of the two images under the given
+  // window. The images must be at least as large as the window. If
+  // crossonly is set, mu1 and E[x^2] are not computed.
+  SeparableMoments(const Matrix<FLOAT> &img1,const Matrix<FLOAT> &img2,const Matrix<DOUBLE> &window,
+		   bool crossonly = false);
+  //
+  // Prepare the moment computation of two images of the given width
+  // whose rows are provided by the caller.
+  SeparableMoments(ULONG width,const Matrix<DOUBLE> &window,bool crossonly = false);
+  //
+  ~SeparableMoments(void);
+  //
+  // Return the number of window positions within a row, i.e. the number
+  // of entries the moment rows require.
+  ULONG WidthOf(void) const
+  {
+    return m_ulWidth;
+  }
+  //
+  // Compute the moments of all windows whose top edge is at image row y.
+  // The first sample of each target is the window at the left edge.
+  // In the cross-only mode, mu1 and xx remain untouched.
+  void MomentsOf(ULONG y,DOUBLE *mu1,DOUBLE *mu2,DOUBLE *xx,DOUBLE *yy,DOUBLE *xy);
+  //
+  // Ditto, but the image rows covered by the window are provided by the
+  // caller: rows1[j] and rows2[j] are the rows y + j of the two images.
+  // Only rows that have not been filtered for a previous window row are
+  // accessed.
+  void MomentsOf(ULONG y,const FLOAT *const *rows1,const FLOAT *const *rows2,
+		 DOUBLE *mu1,DOUBLE *mu2,DOUBLE *xx,DOUBLE *yy,DOUBLE *xy);
+};
+///
+
+///
+#endif
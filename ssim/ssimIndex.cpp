@@ -24,8 +24,14 @@
 
 #include "ssimIndex.hpp"
 #include "global/matrix.hpp"
+#include "moments/separablemoments.hpp"
+#include "moments/recursivemoments.hpp"
+#include "moments/boxmoments.hpp"
+#include "moments/momentkernels.hpp"
+#include "moments/maskingkernels.hpp"
 #include "std/math.hpp"
 #include "std/stdio.hpp"
+#include "std/string.hpp"
 
 #ifndef M_PI
 #define M_PI 3.14159326
@@ -37,21 +43,25 @@
 const DOUBLE ssimIndex::Weights[5] = {0.0448,0.2856,0.3001,0.2363,0.1333};
 const DOUBLE ssimIndex::K1 = 0.01;
 const DOUBLE ssimIndex::K2 = 0.03;
+//
+// The window function exp(-r^2/2.25) of the original SSIM.
+const DOUBLE ssimIndex::DefaultSigma = 1.0606601717798212;
 ///
 
 /// ssimIndex::CreateGaussFilter
 // Create the gauss windowing function
-Matrix<double> ssimIndex::CreateGaussFilter(ULONG w, ULONG h)
+Matrix<double> ssimIndex::CreateGaussFilter(ULONG w, ULONG h, DOUBLE sigma)
 {
   Matrix<double> gauss(w,h);
   ULONG d1    = w/2;
   ULONG d2    = h/2;
   ULONG x,y;
   double Norm = 0.0;
+  double var2 = 2.0 * sigma * sigma;
   
   for (x = 0;x<w;x++){
     for(y = 0;y<h;y++){
-      double g = exp(-(((x - d1) * (x - d1) + (y - d2) * (y - d2))/2.25));
+      double g = exp(-(((x - d1) * (x - d1) + (y - d2) * (y - d2))/var2));
       Norm    += g;
       gauss.Put(x,y,g);
     }
@@ -97,6 +107,23 @@ Matrix<DOUBLE> ssimIndex::CreateHammingWindow(ULONG w, ULONG h)
 }
 ///
 
+/// ssimIndex::CreateBoxFilter
+// This method creates a uniform window of the given size.
+Matrix<DOUBLE> ssimIndex::CreateBoxFilter(ULONG w, ULONG h)
+{
+  ULONG x,y;
+  Matrix<double> window(w,h);
+
+  for(y = 0;y < h;y++) {
+    for(x = 0;x < w;x++) {
+      window.At(x,y) = 1.0 / (w * h);
+    }
+  }
+
+  return window;
+}
+///
+
 /// ssimIndex::ssimFactor
 // compute the ssim index for a complete image
 double ssimIndex::ssimFactor(const Image& img1,const Image& img2,int ncpus,bool bylevel,Matrix<FLOAT> &err)
@@ -110,14 +137,14 @@ double ssimIndex::ssimFactor(const Image& img1,const Image& img2,int ncpus,bool
     err.CleanMatrix();
     // During the accumulation phase, err contains the logarithm of the probability of not detecting
     // an error. 0.0 means: log(1-p) = 0.0, thus p = 0.0 -> error detection probability p = 0.0: no error.
-    ncpus = 1; // requires single-CPU usage to pool up the error correctly.
   }
   
   for(i = 0;i < img1.ComponentCountOf();i++) {
     if (bylevel)
       printf("\n%s component:\n",img1.ComponentOf(i).NameOf());
     w = ssimFactor(img1.ComponentOf(i),img2.ComponentOf(i),img1.ComponentOf(i).ScaleOf(),ncpus,bylevel,
-		   img1.ComponentOf(i).WeightOf());
+		   img1.ComponentOf(i).WeightOf(),
+		   (&img1 == m_pReference)?(m_ppMoments + i * m_iScales):(NULL));
     ssim += img1.ComponentOf(i).WeightOf() * w;
   }
 
@@ -133,25 +160,28 @@ double ssimIndex::ssimFactor(const Image& img1,const Image& img2,int ncpus,bool
 }
 ///
 
-/// ssimIndex::pthread_entry
-// The entry point to start a SSIM thread.
-#ifndef NO_POSIX
-void *ssimIndex::pthread_entry(void *arg)
+/// ssimIndex::ssimTask::Run
+// Run a partial SSIM computation in the thread pool.
+void ssimIndex::ssimTask::Run(void)
 {
-  struct ssimTask *task = (struct ssimTask *)arg;
-
-  task->result = task->that->ssimFactor(*task->img1,*task->img2,task->scale,task->doluminance,
-					task->offset,task->interleave,
-					task->size,task->cweight,task->gamma);
+  result = that->ssimFactor(*img1,*img2,scale,doluminance,
+			    first,last,
+			    cweight,gamma,count,logprob,reference);
+}
+///
 
-  return task;
+/// ssimIndex::splatTask::Run
+// Splat the log probabilities into the rows of the error map owned by this job.
+void ssimIndex::splatTask::Run(void)
+{
+  that->SplatError(*logprob,size,profile,first,last);
 }
-#endif
 ///
 
 /// ssimIndex::ssimFactor
 // Compute the ssim factor for a multi-core CPU with potentially using threads.
-double ssimIndex::ssimFactor(Component& img1,Component& img2,DOUBLE scaling,int ncpus,bool bylevel,DOUBLE cweight) const
+double ssimIndex::ssimFactor(Component& img1,Component& img2,DOUBLE scaling,int ncpus,bool bylevel,DOUBLE cweight,
+			     class ReferenceMoments *const *reference) const
 {
   int scale,nscales = img1.ScalesOf();
   DOUBLE result = 1.0;
@@ -161,42 +191,80 @@ double ssimIndex::ssimFactor(Component& img1,Component& img2,DOUBLE scaling,int
     const Matrix<FLOAT> &c2 = img2.GetScale(scale);
     DOUBLE thissim;
 
-#ifdef NO_POSIX
-    thissim = ssimFactor(c1,c2,scaling,scale == nscales,0,1,scale-1,cweight,Weights[scale-1]);
-#else
-    if (ncpus == 1) {
-      thissim = ssimFactor(c1,c2,scaling,scale == nscales,0,1,scale-1,cweight,Weights[scale-1]);
-    } else {
-      int i;
-      struct ssimTask *tasks = new ssimTask[ncpus];
-      double sum = 0.0;
-      //
-      for(i = 0;i < ncpus;i++) {
-	tasks[i].that        = this;
-	tasks[i].img1        = &c1;
-	tasks[i].img2        = &c2;
-	tasks[i].offset      = i;
-	tasks[i].interleave  = ncpus;
-	tasks[i].scale       = scaling;
-	tasks[i].doluminance = (scale == nscales);
-	tasks[i].size        = scale-1;
-	tasks[i].nscales     = nscales;
-	tasks[i].cweight     = cweight;
-	tasks[i].gamma       = Weights[scale-1];
-	pthread_attr_init(&tasks[i].attr);
-	pthread_attr_setdetachstate(&tasks[i].attr,PTHREAD_CREATE_JOINABLE);
-	pthread_create(&tasks[i].pid,&tasks[i].attr,&ssimIndex::pthread_entry,tasks+i);
-      }
+    ULONG w      = m_Gauss.WidthOf();
+    ULONG h      = m_Gauss.HeightOf();
+    ULONG rows   = (c1.HeightOf() >= h && c1.WidthOf() >= w)?(c1.HeightOf() - h + 1):(0);
+    ULONG halo   = (m_iFilter == Recursive)?(h - 1 + 2 * RecursiveMoments::MarginOf(m_dSigma)):(h - 1);
+    ULONG stripe = ThreadPool::StripeHeightOf(rows,2 * c1.WidthOf() * sizeof(FLOAT),halo);
+    int stripes  = (rows + stripe - 1) / stripe;
+    int i;
+    struct ssimTask *tasks = new ssimTask[stripes];
+    class ThreadJob **jobs = new class ThreadJob *[stripes];
+    double sum   = 0.0;
+    ULONG count  = 0;
+    Matrix<DOUBLE> logprob;
+    //
+    // For the error map, the jobs first collect the log probabilities of not
+    // detecting an error for each window, which are then splat into the map.
+    if (m_pError && !m_pError->IsEmpty() && rows > 0)
+      logprob.Allocate(c1.WidthOf() - w + 1,rows);
+    //
+    // Partition the image into contiguous stripes of window rows, each job
+    // works on its own region of the image. The partitioning does not depend
+    // on the number of CPUs, hence neither does the result.
+    for(i = 0;i < stripes;i++) {
+      tasks[i].that        = this;
+      tasks[i].img1        = &c1;
+      tasks[i].img2        = &c2;
+      tasks[i].first       = i * stripe;
+      tasks[i].last        = (i + 1 < stripes)?((i + 1) * stripe):(rows);
+      tasks[i].scale       = scaling;
+      tasks[i].doluminance = (scale == nscales);
+      tasks[i].nscales     = nscales;
+      tasks[i].cweight     = cweight;
+      tasks[i].gamma       = Weights[scale-1];
+      tasks[i].logprob     = (logprob.IsEmpty())?(NULL):(&logprob);
+      tasks[i].reference   = (reference)?(reference[scale-1]):(NULL);
+      jobs[i]              = tasks + i;
+    }
+    //
+    // Run the jobs, and pool their results.
+    ThreadPool::Execute(jobs,stripes,ncpus);
+    for(i = 0;i < stripes;i++) {
+      sum   += tasks[i].result;
+      count += tasks[i].count;
+    }
+    delete[] jobs;
+    delete[] tasks;
+    //
+    // Splat into the error map. Each job owns a stripe of the map, and every
+    // pixel collects the windows in the same order as in a sequential run,
+    // hence the map does not depend on the number of CPUs.
+    if (!logprob.IsEmpty()) {
+      ULONG mheight = m_pError->HeightOf();
+      ULONG mstripe = ThreadPool::StripeHeightOf(mheight,m_pError->WidthOf() * sizeof(FLOAT),0);
+      int mstripes  = (mheight + mstripe - 1) / mstripe;
+      struct splatTask *splats = new splatTask[mstripes];
+      class ThreadJob **sjobs  = new class ThreadJob *[mstripes];
+      DOUBLE *profile          = CreateSplatProfile(scale-1);
       //
-      // Now wait for all threads to complete, and collect their results.
-      for(i = 0;i < ncpus;i++) {
-	pthread_join(tasks[i].pid,NULL);
-	sum += tasks[i].result;
+      for(i = 0;i < mstripes;i++) {
+	splats[i].that     = this;
+	splats[i].logprob  = &logprob;
+	splats[i].profile  = profile;
+	splats[i].size     = scale-1;
+	splats[i].first    = i * mstripe;
+	splats[i].last     = (i + 1 < mstripes)?((i + 1) * mstripe):(mheight);
+	sjobs[i]           = splats + i;
       }
-      delete[] tasks;
-      thissim = sum / ncpus;
+      ThreadPool::Execute(sjobs,mstripes,ncpus);
+      delete[] profile;
+      delete[] sjobs;
+      delete[] splats;
     }
-#endif
+    //
+    // Images smaller than the window do not contain a single window position.
+    thissim = (count > 0)?(sum / count):(1.0);
     if (bylevel)
       printf("log ssim value for scale %d: %f\n",scale,-20.0 * log(1.0 - thissim) / log(10.0));
     //
@@ -213,15 +281,15 @@ double ssimIndex::ssimFactor(Component& img1,Component& img2,DOUBLE scaling,int
 ///
 
 /// ssimIndex::ssimFactor
-// Compute the sim factor with a certain interleaving (only every n-th row) with the given start offset
-// from the start of the picture.
+// Compute the sum of the local sim factors of the windows whose top rows are in the stripe
+// first..last-1, and return the number of windows in count.
 double ssimIndex::ssimFactor(const Matrix<FLOAT>& img1,const Matrix<FLOAT>& img2,DOUBLE scale,bool doluminance,
-			     ULONG offset, ULONG interleave,
-			     int size,DOUBLE cweight,DOUBLE gamma) const
+			     ULONG first, ULONG last,
+			     DOUBLE cweight,DOUBLE gamma,ULONG &count,
+			     Matrix<DOUBLE> *logprob,const ReferenceMoments *reference) const
 {
   ULONG counter     = 0;
   double ssimsum    = 0.0;
-  bool includevis   = (m_dMasking < 2.0); // include the visibility coefficient.
 
   //the 2 images will be transform in a "float" matrix.
   ULONG width  = img1.WidthOf();
@@ -230,15 +298,11 @@ double ssimIndex::ssimFactor(const Matrix<FLOAT>& img1,const Matrix<FLOAT>& img2
   //The GaussFilter will be apply
   ULONG w = m_Gauss.WidthOf();
   ULONG h = m_Gauss.HeightOf();
-  
-  double C1 = (K1*scale)*(K1*scale);
-  double C2 = (K2*scale)*(K2*scale);
-  double C3 = C2/2;  
 
 #if 0
   {
     char name[256];
-    snprintf(name,255,"scale_%d.pgm",size);
+    snprintf(name,255,"scale_%lux%lu.pgm",(unsigned long)width,(unsigned long)height);
     FILE *out = fopen(name,"wb");
     fprintf(out,"P5\n%d\t%d\n255\n",width,height);
     for(ULONG y = 0;y < height;y++) {
@@ -251,64 +315,164 @@ double ssimIndex::ssimFactor(const Matrix<FLOAT>& img1,const Matrix<FLOAT>& img2
 #endif
 
 
-  for(ULONG y1 = offset;y1 <= height-h;y1 += interleave){
-    for(ULONG x1 = 0;x1 <= width-w;x1++){
-      ULONG x,y;
-      double lumvalue_1  = 0.0,lumvalue_2  = 0.0;
-      double con2value_1 = 0.0,con2value_2 = 0.0;
-      double corrvalue   = 0.0,con12value;
-      double visibility  = 1.0; // the new factor in SSIM
-      double complum;
-      double compcon;
-      double compstruct; 
-
-      // Collect moments. Note that we do that in one
-      // loop. The above code does in several, but this
-      // is definitely quicker.
-      for( y=0;y<h;y++){
-	for( x=0;x<w;x++){
-	  double k1    = img1.Get(x+x1,y+y1);
-	  double k2    = img2.Get(x+x1,y+y1);
-	  double valv  = m_Gauss.Get(x,y);
-	  lumvalue_1  += k1*valv;
-	  lumvalue_2  += k2*valv;
-	  con2value_1 += k1*k1*valv;
-	  con2value_2 += k2*k2*valv;
-	  corrvalue   += k1*k2*valv;
-	}
+  //
+  // Images smaller than the window do not contain a single window position.
+  if (width < w || height < h || first >= last) {
+    count = 0;
+    return 0.0;
+  }
+  //
+  // The moments are computed by a separable filter over the window,
+  // row by row, by the recursive filter for blocks of columns of the
+  // whole stripe at once, or by running sums over the uniform window,
+  // restarted at the stripes of the streaming computation. The moments of
+  // the reference may be cached already.
+  class SeparableMoments *separable = NULL;
+  class RecursiveMoments *recursive = NULL;
+  class BoxMoments       *box       = NULL;
+  ULONG mwidth,block;
+  if (m_iFilter == Recursive) {
+    recursive = new class RecursiveMoments(img1,img2,w,h,m_dSigma,first,last);
+    mwidth    = recursive->WidthOf();
+    block     = recursive->BlockWidthOf();
+  } else if (m_iFilter == Box) {
+    box       = new class BoxMoments(img1,img2,w,h,last - first);
+    mwidth    = box->WidthOf();
+    block     = mwidth;
+  } else {
+    separable = new class SeparableMoments(img1,img2,m_Gauss,reference != NULL);
+    mwidth    = separable->WidthOf();
+    block     = mwidth;
+  }
+  DOUBLE *mu1  = new DOUBLE[6 * block];
+  DOUBLE *mu2  = mu1 + block;
+  DOUBLE *mxx  = mu2 + block;
+  DOUBLE *myy  = mxx + block;
+  DOUBLE *mxy  = myy + block;
+  DOUBLE *local = mxy + block; // the local SSIM of the window row
+  const FLOAT **rows1 = new const FLOAT *[2 * h];
+  const FLOAT **rows2 = rows1 + h;
+  RowKernel kernel    = RowKernelOf(doluminance,logprob != NULL);
+
+  //
+  // Only the recursive filter computes more than one block of columns.
+  for(ULONG left = 0;left < mwidth;left += block) {
+    ULONG right = (left + block < mwidth)?(left + block):(mwidth);
+    ULONG bwidth = right - left;
+    if (recursive)
+      recursive->FilterBlock(left,right);
+    for(ULONG y1 = first;y1 < last;y1++){
+      for(ULONG y = 0;y < h;y++) {
+	rows1[y] = &img1.At(left,y1 + y);
+	rows2[y] = &img2.At(left,y1 + y);
+      }
+      if (recursive) {
+	recursive->MomentsOf(y1,mu1,mu2,mxx,myy,mxy);
+      } else if (box) {
+	box->MomentsOf(y1,rows1,rows2,mu1,mu2,mxx,myy,mxy);
+      } else {
+	separable->MomentsOf(y1,rows1,rows2,mu1,mu2,mxx,myy,mxy);
+      }
+      if (reference) {
+	memcpy(mu1,reference->MeanOf(y1) + left,bwidth * sizeof(DOUBLE));
+	memcpy(mxx,reference->SquareOf(y1) + left,bwidth * sizeof(DOUBLE));
       }
       //
-      if (includevis) {
-	double l2norm1 = 0.0;
-	double l2norm2 = 0.0;
-	double lpnorm1 = 0.0;
-	double lpnorm2 = 0.0;
-	double sscale  = w * h; // note that this is the l^2 norm, not the variance (which would be averaged)
-	double C3      = C2 * pow(sscale,2.0 / m_dMasking - 1.0); // the scaling of the stabilizer.
-	//
-	// Include the visibility mask. Note that the gaussian window
-	// has average 1.0, thus lumvalue is really the average (with weights)
-	//
-	for( y=0;y<h;y++){
-	  for( x=0;x<w;x++){
-	    double k1    = img1.Get(x+x1,y+y1);
-	    double k2    = img2.Get(x+x1,y+y1);
-	    double valv  = m_Gauss.Get(x,y) * sscale;
-	    double v1    = k1 - lumvalue_1; // value minus average
-	    double v2    = k2 - lumvalue_2;
-	    //
-	    l2norm1     += v1 * v1 * valv;
-	    l2norm2     += v2 * v2 * valv;
-	    lpnorm1     += pow(fabs(v1),m_dMasking) * valv;
-	    lpnorm2     += pow(fabs(v2),m_dMasking) * valv;
+      ssimsum += (this->*kernel)(rows1,rows2,mu1,mu2,mxx,myy,mxy,bwidth,scale,local);
+      counter += bwidth;
+      //
+      //
+      // Keep the log probability of not detecting an error for the error map.
+      if (logprob) {
+	for(ULONG x1 = 0;x1 < bwidth;x1++){
+	  DOUBLE p = (local[x1] + 1.0) * 0.5;
+	  if (p <= 0.0) {
+	    p = -HUGE_VAL; // In this simple model, the probabililty of *not* detecting an error.
+	    // Note that the local SSIM may get negative if source and reconstructed structure
+	    // are anti-correlated.
+	  } else {
+	    // However, we need the log since that accumulated additively.
+	    p = cweight * gamma * log(p);
 	  }
+	  logprob->At(left + x1,y1) = p;
 	}
+      }
+    }
+  }
+
+  delete[] rows1;
+  delete[] mu1;
+  delete separable;
+  delete recursive;
+  delete box;
+
+  count = counter;
+  return ssimsum;
+}
+///
+
+/// ssimIndex::WindowRowSSIM
+// Compute the local SSIM of all windows of a window row from their
+// moments, and return their sum. rows1 and rows2 are the image rows
+// covered by the window row, they are only required for masking.
+// If errormap is set, local receives the local SSIM of each window.
+template<bool masking,bool luminance,bool errormap>
+double ssimIndex::WindowRowSSIM(const FLOAT *const *rows1,const FLOAT *const *rows2,
+				DOUBLE *mu1,DOUBLE *mu2,DOUBLE *mxx,DOUBLE *myy,DOUBLE *mxy,ULONG mwidth,
+				DOUBLE scale,DOUBLE *local) const
+{
+  double ssimsum    = 0.0;
+  const ULONG w = m_Gauss.WidthOf();
+  const ULONG h = m_Gauss.HeightOf();
+  double C1 = (K1*scale)*(K1*scale);
+  double C2 = (K2*scale)*(K2*scale);
+  double C3 = C2/2;  
+
+  if (masking) {
+    MaskingKernels::PowerSumsFunc powersums = MaskingKernels::KernelsOf().PowerSumsOf(m_dMasking);
+    double sscale  = w * h; // note that this is the l^2 norm, not the variance (which would be averaged)
+    double CV      = C2 * pow(sscale,2.0 / m_dMasking - 1.0); // the scaling of the stabilizer.
+    DOUBLE lpnorm[2][MaskChunk];
+    //
+    for(ULONG x0 = 0;x0 < mwidth;x0 += MaskChunk) {
+      ULONG n = (mwidth - x0 < ULONG(MaskChunk))?(mwidth - x0):(ULONG(MaskChunk));
+      //
+      // Include the visibility mask. Note that the gaussian window
+      // has average 1.0, thus lumvalue is really the average (with weights).
+      // The lp norms of both images are computed for a chunk of windows in
+      // one pass, the window weights of m_pdMaskTaps are already scaled by
+      // sscale. The l2 norms are the variances, scaled alike.
+      powersums(rows1,rows2,x0,m_pdMaskTaps,w,h,mu1 + x0,mu2 + x0,n,m_dMasking,lpnorm[0],lpnorm[1]);
+      //
+      for(ULONG i = 0;i < n;i++){
+	ULONG x1           = x0 + i;
+	double lumvalue_1  = mu1[x1],lumvalue_2  = mu2[x1];
+	double con2value_1 = mxx[x1],con2value_2 = myy[x1];
+	double corrvalue   = mxy[x1],con12value;
+	double visibility  = 1.0; // the new factor in SSIM
+	double complum;
+	double compcon;
+	double compstruct; 
+	double l2norm1;
+	double l2norm2;
+	double lpnorm1 = pow(lpnorm[0][i],2.0 / m_dMasking);
+	double lpnorm2 = pow(lpnorm[1][i],2.0 / m_dMasking);
 	//
-	lpnorm1 = pow(lpnorm1,2.0 / m_dMasking);
-	lpnorm2 = pow(lpnorm2,2.0 / m_dMasking);
+	// Fixup the moments so we really get what is needed.
+	con2value_1     -= lumvalue_1 * lumvalue_1;
+	con2value_2     -= lumvalue_2 * lumvalue_2;
+	corrvalue       -= lumvalue_1 * lumvalue_2;
+	// Fixup round-off errors. Variances should be positive.
+	if (con2value_1  < 0.0)
+	  con2value_1    = 0.0;
+	if (con2value_2  < 0.0)
+	  con2value_2    = 0.0; 
+	con12value       = sqrt(con2value_1 * con2value_2);
+	l2norm1          = con2value_1 * sscale;
+	l2norm2          = con2value_2 * sscale;
 	//
 	// Plus stabilizer
-	visibility  = (l2norm1 + l2norm2 + C3) / (lpnorm1 + lpnorm2 + C3);
+	visibility  = (l2norm1 + l2norm2 + CV) / (lpnorm1 + lpnorm2 + CV);
 	visibility  = pow(visibility,m_dMasking / 2.0);
 	//printf("%g\t",visibility);
 	// Should almost never overrun. In case it is due to numerical problems,
@@ -318,102 +482,205 @@ double ssimIndex::ssimFactor(const Matrix<FLOAT>& img1,const Matrix<FLOAT>& img2
 	assert(visibility > 0.0 && visibility <= 1.0);
 	// This should scale like samples^(2/p - 1), thus multiply by that to bring it back into a useful range.
 	//visibility *= pow(scale,2.0 / m_dMasking - 1.0);
-      } else {
-	visibility = 1.0;
-      }
-      //
-      // Fixup the moments so we really get what is needed.
-      con2value_1     -= lumvalue_1 * lumvalue_1;
-      con2value_2     -= lumvalue_2 * lumvalue_2;
-      corrvalue       -= lumvalue_1 * lumvalue_2;
-      // Fixup round-off errors. Variances should be positive.
-      if (con2value_1  < 0.0)
-	con2value_1    = 0.0;
-      if (con2value_2  < 0.0)
-	con2value_2    = 0.0; 
-      con12value       = sqrt(con2value_1 * con2value_2);
-      
-      complum    = (2.0 * lumvalue_1 * lumvalue_2 + C1)/(lumvalue_1 * lumvalue_1 + lumvalue_2 * lumvalue_2 + C1);
-      compcon    = (2.0 * con12value + C2)/(con2value_1 + con2value_2 + C2);
-      compstruct = (corrvalue + C3)/(con12value + C3); 
-      //
-      // If the luminance is suppressed (on all but the smallest scale), set this contribution to 1.0.
-      if (!doluminance)
-	complum = 1.0;
-      //ssim index for a window:
-      /* NOTE: The following would be correct, but since Alpha = Beta = Gamma = 1.0, no sweat,
-      ** and we're in a hurry.
-      ** float locssim = pow(complum,Alpha) * pow(compcon,Beta) * pow(compstruct,Gamma);
-      */ 
-      //
-      // If visibility is included, modify accordingly. Note that the term is constructed in a way
-      // to reproduce the understood "classical" masking term.
-      if (includevis) {
+
+	complum    = (2.0 * lumvalue_1 * lumvalue_2 + C1)/(lumvalue_1 * lumvalue_1 + lumvalue_2 * lumvalue_2 + C1);
+	compcon    = (2.0 * con12value + C2)/(con2value_1 + con2value_2 + C2);
+	compstruct = (corrvalue + C3)/(con12value + C3); 
+	//
+	// If the luminance is suppressed (on all but the smallest scale), set this contribution to 1.0.
+	if (!luminance)
+	  complum = 1.0;
+	//ssim index for a window:
+	/* NOTE: The following would be correct, but since Alpha = Beta = Gamma = 1.0, no sweat,
+	** and we're in a hurry.
+	** float locssim = pow(complum,Alpha) * pow(compcon,Beta) * pow(compstruct,Gamma);
+	*/ 
+	//
+	// If visibility is included, modify accordingly. Note that the term is constructed in a way
+	// to reproduce the understood "classical" masking term.
 	//locssim = 1.0 - ((1.0 - locssim) * visibility);
 	//locssim = (1.0 - visibility) + locssim * visibility;
 	compstruct = (1.0 - visibility) + compstruct * visibility;
-      }
-      double locssim = complum * compcon * compstruct;
-      //
-      //sum of the ssim indexes for all windows.
-      ssimsum +=locssim;
-      counter++;
-      //
-      if (m_pError && !m_pError->IsEmpty()) {
-	int xmin,xmax,ymin,ymax,i,j;
-	int exponent = size;
-	DOUBLE xmid,ymid;
-	DOUBLE p = (locssim + 1.0) * 0.5,f;
-	if (p <= 0.0) {
-	  p = -HUGE_VAL; // In this simple model, the probabililty of *not* detecting an error.
-	  // Note that the local SSIM may get negative if source and reconstructed structure
-	  // are anti-correlated.
-	} else {
-	  // However, we need the log since that accumulated additively.
-	  p = cweight * gamma * log(p);
-	}
-	//p *= -1E+3;
-	//printf("%g\t",p);
+	double locssim = complum * compcon * compstruct;
 	//
-	if (exponent > 0) {
-	  xmin = ((x1 + (w >> 1)) << exponent) - ((1 << exponent) >> 1);
-	  ymin = ((y1 + (h >> 1)) << exponent) - ((1 << exponent) >> 1);
-	  xmax = xmin + (2 << exponent);
-	  ymax = ymin + (2 << exponent);
-	  xmid = (xmin + xmax - 1) * 0.5;
-	  ymid = (ymin + ymax - 1) * 0.5;
-	  f    = M_PI / (xmax - xmin);
-	  if (xmin < 0)
-	    xmin = 0;
-	  if (ymin < 0)
-	    ymin = 0;
-	  if (xmax > int(m_pError->WidthOf()))
-	    xmax = m_pError->WidthOf();
-	  if (ymax > int(m_pError->HeightOf()))
-	    ymax = m_pError->HeightOf();
-	  for(j = ymin;j < ymax;j++) {
-	    for(i = xmin;i < xmax;i++) {
-	      // Note that the following works only for single-CPU usage - no locking.
-	      m_pError->At(i,j) += p * cos(f * (i - xmid)) * cos(f * (j - ymid));
-	    }
-	  }
-	} else {
-	  m_pError->At(x1,y1) += p;
-	}
+	//sum of the ssim indexes for all windows.
+	if (errormap)
+	  local[x1] = locssim;
+	ssimsum  += locssim;
       }
     }
+  } else {
+    // Without masking, the local SSIM only depends on the moments.
+    ssimsum = MomentKernels::KernelsOf().SSIMOf(luminance,errormap)(mu1,mu2,mxx,myy,mxy,mwidth,C1,C2,C3,local);
   }
 
-  if (counter > 0)
-    return ssimsum / counter;
-  return 1.0;
+  return ssimsum;
+}
+///
+
+/// ssimIndex::SelectRowKernel
+// Return the instance of WindowRowSSIM for the given masking mode that
+// includes the luminance term and fills in the error map as requested.
+template<bool masking>
+ssimIndex::RowKernel ssimIndex::SelectRowKernel(bool doluminance,bool errormap)
+{
+  if (doluminance)
+    return (errormap)?(&ssimIndex::WindowRowSSIM<masking,true,true>):
+      (&ssimIndex::WindowRowSSIM<masking,true,false>);
+
+  return (errormap)?(&ssimIndex::WindowRowSSIM<masking,false,true>):
+    (&ssimIndex::WindowRowSSIM<masking,false,false>);
+}
+///
+
+/// ssimIndex::RowKernelOf
+// Return the kernel computing the local SSIM of a window row for the
+// masking of this index. Without masking, the local SSIM only depends
+// on the moments. With masking, the norms are computed by the masking
+// kernels, which take the window size at run time.
+ssimIndex::RowKernel ssimIndex::RowKernelOf(bool doluminance,bool errormap) const
+{
+  if (m_dMasking >= 2.0)
+    return SelectRowKernel<false>(doluminance,errormap);
+
+  return SelectRowKernel<true>(doluminance,errormap);
 }
 ///
 
 /// ssimIndex::ssimIndex
-ssimIndex::ssimIndex(double masking) 
-  : m_dMasking(masking), m_Gauss(CreateGaussFilter(11,11))
+ssimIndex::ssimIndex(double masking,ULONG window,double sigma,WindowFilter filter) 
+  : m_dMasking(masking), m_dSigma(sigma), m_iFilter(filter),
+    m_Gauss((filter == Box)?(CreateBoxFilter(window,window)):(CreateGaussFilter(window,window,sigma))),
+    m_pdMaskTaps(NULL),
+    m_pError(NULL), m_pReference(NULL), m_ppMoments(NULL), m_iComponents(0), m_iScales(0)
+{
+  ULONG w       = m_Gauss.WidthOf();
+  ULONG h       = m_Gauss.HeightOf();
+  double sscale = w * h;
+  ULONG x,y;
+
+  m_pdMaskTaps  = new DOUBLE[w * h];
+  for(y = 0;y < h;y++) {
+    for(x = 0;x < w;x++) {
+      m_pdMaskTaps[x + y * w] = m_Gauss.Get(x,y) * sscale;
+    }
+  }
+}
+///
+
+/// ssimIndex::CacheReference
+// Compute and keep the moments of a reference image that is compared against
+// many distorted images.
+void ssimIndex::CacheReference(const Image &ref)
 {
+  int i,scale;
+
+  ReleaseReference();
+  //
+  // The recursive filter and the running sums compute the moments of
+  // both images at once, nothing to gain here.
+  if (m_iFilter != Gaussian)
+    return;
+  //
+  m_iComponents = ref.ComponentCountOf();
+  m_iScales     = 0;
+  for(i = 0;i < m_iComponents;i++) {
+    if (ref.ComponentOf(i).ScalesOf() > m_iScales)
+      m_iScales = ref.ComponentOf(i).ScalesOf();
+  }
+  m_ppMoments = new class ReferenceMoments *[m_iComponents * m_iScales];
+  for(i = 0;i < m_iComponents * m_iScales;i++)
+    m_ppMoments[i] = NULL;
+  //
+  for(i = 0;i < m_iComponents;i++) {
+    for(scale = 1;scale <= ref.ComponentOf(i).ScalesOf();scale++) {
+      m_ppMoments[i * m_iScales + scale - 1] = new class ReferenceMoments(ref.ComponentOf(i).GetScale(scale),
+									  m_Gauss);
+    }
+  }
+  m_pReference = &ref;
+}
+///
+
+/// ssimIndex::ReleaseReference
+// Release the cached moments of the reference image.
+void ssimIndex::ReleaseReference(void)
+{
+  int i;
+
+  if (m_ppMoments) {
+    for(i = 0;i < m_iComponents * m_iScales;i++)
+      delete m_ppMoments[i];
+    delete[] m_ppMoments;
+    m_ppMoments = NULL;
+  }
+  m_pReference  = NULL;
+  m_iComponents = 0;
+  m_iScales     = 0;
+}
+///
+
+/// ssimIndex::CompareMoments
+// Print the largest deviations of the moments of the recursive filter
+// from those of the window function, for all components and scales.
+void ssimIndex::CompareMoments(const Image &img1,const Image &img2) const
+{
+  ULONG w = m_Gauss.WidthOf();
+  ULONG h = m_Gauss.HeightOf();
+  int i,scale;
+
+  for(i = 0;i < img1.ComponentCountOf();i++) {
+    for(scale = 1;scale <= img1.ComponentOf(i).ScalesOf();scale++) {
+      const Matrix<FLOAT> &c1 = img1.ComponentOf(i).GetScale(scale);
+      const Matrix<FLOAT> &c2 = img2.ComponentOf(i).GetScale(scale);
+      //
+      if (c1.WidthOf() < w || c1.HeightOf() < h)
+	continue;
+      //
+      ULONG rows   = c1.HeightOf() - h + 1;
+      SeparableMoments separable(c1,c2,m_Gauss);
+      RecursiveMoments recursive(c1,c2,w,h,m_dSigma,0,rows);
+      ULONG mwidth = separable.WidthOf();
+      ULONG block  = recursive.BlockWidthOf();
+      DOUBLE *fir  = new DOUBLE[5 * mwidth + 5 * block];
+      DOUBLE *iir  = fir + 5 * mwidth;
+      DOUBLE mean  = 0.0,dev = 0.0,cov = 0.0;
+      ULONG left,x,y;
+      //
+      // The recursive filter computes the moments in blocks of columns.
+      for(left = 0;left < mwidth;left += block) {
+	ULONG right = (left + block < mwidth)?(left + block):(mwidth);
+	recursive.FilterBlock(left,right);
+	for(y = 0;y < rows;y++) {
+	  separable.MomentsOf(y,fir,fir + mwidth,fir + 2 * mwidth,fir + 3 * mwidth,fir + 4 * mwidth);
+	  recursive.MomentsOf(y,iir,iir + block,iir + 2 * block,iir + 3 * block,iir + 4 * block);
+	  for(x = left;x < right;x++) {
+	    const DOUBLE *b = iir + x - left;
+	    DOUBLE m1  = fir[x],m2 = fir[x + mwidth];
+	    DOUBLE n1  = b[0],n2 = b[block];
+	    DOUBLE d1  = sqrt(fabs(fir[x + 2 * mwidth] - m1 * m1)) - sqrt(fabs(b[2 * block] - n1 * n1));
+	    DOUBLE d2  = sqrt(fabs(fir[x + 3 * mwidth] - m2 * m2)) - sqrt(fabs(b[3 * block] - n2 * n2));
+	    DOUBLE d12 = (fir[x + 4 * mwidth] - m1 * m2) - (b[4 * block] - n1 * n2);
+	    //
+	    if (fabs(m1 - n1) > mean)
+	      mean = fabs(m1 - n1);
+	    if (fabs(m2 - n2) > mean)
+	      mean = fabs(m2 - n2);
+	    if (fabs(d1) > dev)
+	      dev  = fabs(d1);
+	    if (fabs(d2) > dev)
+	      dev  = fabs(d2);
+	    if (fabs(d12) > cov)
+	      cov  = fabs(d12);
+	  }
+	}
+      }
+      delete[] fir;
+      //
+      printf("%s component, scale %d: largest error of mean %g, deviation %g, covariance %g\n",
+	     img1.ComponentOf(i).NameOf(),scale,mean,dev,cov);
+    }
+  }
 }
 ///
 
@@ -435,3 +702,83 @@ void PrintMatrix(const Matrix<double> &m)
   }
 }
 ///
+
+/// ssimIndex::CreateSplatProfile
+// Compute the one-dimensional cosine profile a window of a scale of the given
+// size is splat with.
+DOUBLE *ssimIndex::CreateSplatProfile(int size)
+{
+  int i,n = 2 << size;
+  DOUBLE *profile = new DOUBLE[n];
+  DOUBLE f        = M_PI / n;
+  DOUBLE mid      = (n - 1) * 0.5;
+
+  for(i = 0;i < n;i++) {
+    profile[i] = cos(f * (i - mid));
+  }
+
+  return profile;
+}
+///
+
+/// ssimIndex::SplatError
+// Accumulate the log probabilities of not detecting an error of a scale of
+// the given size into the rows first..last-1 of the error map.
+void ssimIndex::SplatError(const Matrix<DOUBLE> &logprob,int size,const DOUBLE *profile,
+			   ULONG first,ULONG last) const
+{
+  ULONG w      = m_Gauss.WidthOf();
+  ULONG h      = m_Gauss.HeightOf();
+  int exponent = size;
+  int n        = 2 << exponent; // the footprint of a window
+  int width    = m_pError->WidthOf();
+  DOUBLE *row  = NULL;
+
+  if (exponent > 0)
+    row = new DOUBLE[width];
+
+  for(ULONG y1 = 0;y1 < logprob.HeightOf();y1++){
+    if (exponent > 0) {
+      // The cosine footprint of the windows is separable: First accumulate the horizontal
+      // profiles of all windows in this row, then distribute the row vertically.
+      int ystart = ((y1 + (h >> 1)) << exponent) - ((1 << exponent) >> 1);
+      int ymin   = (ystart < int(first))?(int(first)):(ystart);
+      int ymax   = (ystart + n > int(last))?(int(last)):(ystart + n);
+      int xlo    = ((w >> 1) << exponent) - ((1 << exponent) >> 1);
+      int xhi    = xlo + ((logprob.WidthOf() - 1) << exponent) + n;
+      int i,j,k;
+      //
+      if (ymin >= ymax)
+	continue;
+      if (xlo < 0)
+	xlo = 0;
+      if (xhi > width)
+	xhi = width;
+      for(i = xlo;i < xhi;i++)
+	row[i] = 0.0;
+      //
+      for(ULONG x1 = 0;x1 < logprob.WidthOf();x1++){
+	int xstart = ((x1 + (w >> 1)) << exponent) - ((1 << exponent) >> 1);
+	DOUBLE p   = logprob.Get(x1,y1);
+	for(k = 0,i = xstart;k < n;k++,i++) {
+	  if (i >= 0 && i < width)
+	    row[i] += p * profile[k];
+	}
+      }
+      //
+      for(j = ymin;j < ymax;j++) {
+	DOUBLE v = profile[j - ystart];
+	for(i = xlo;i < xhi;i++) {
+	  m_pError->At(i,j) += row[i] * v;
+	}
+      }
+    } else if (y1 >= first && y1 < last) {
+      for(ULONG x1 = 0;x1 < logprob.WidthOf();x1++){
+	m_pError->At(x1,y1) += logprob.Get(x1,y1);
+      }
+    }
+  }
+
+  delete[] row;
+}
+///
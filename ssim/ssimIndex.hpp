@@ -36,14 +36,14 @@
 #include "global/matrix.hpp"
 #include "img/image.hpp"
 #include "img/component.hpp"
-#ifndef NO_POSIX
-extern "C" {
-#include <pthread.h>
-}
-#endif
+#include "global/threadpool.hpp"
+#include "moments/referencemoments.hpp"
 
 
 class ssimIndex {
+  //
+  // The streaming computation shares the window and the local SSIM.
+  friend class ssimStream;
   //
   static const DOUBLE K1,K2;
   //
@@ -52,16 +52,26 @@ class ssimIndex {
   static const DOUBLE Weights[5];
   //
   //This method represent the gausswindowfunction .
-  static Matrix<DOUBLE> CreateGaussFilter(ULONG w, ULONG h);
+  // sigma is the standard deviation of the gaussian.
+  static Matrix<DOUBLE> CreateGaussFilter(ULONG w, ULONG h, DOUBLE sigma);
   //
   // This method creates a Hamming window of the given size.
   static Matrix<DOUBLE> CreateHammingWindow(ULONG w, ULONG h);
   //
+  // This method creates a uniform window of the given size.
+  static Matrix<DOUBLE> CreateBoxFilter(ULONG w, ULONG h);
+  //
   // The masking value.
   double m_dMasking;
   //
-  // This structure is used to start a new thread with a partial ssim computation.
-  struct ssimTask {
+  // The standard deviation of the window function.
+  double m_dSigma;
+  //
+  // The window and how its moments are computed.
+  int    m_iFilter;
+  //
+  // This structure is used to run a partial ssim computation in the thread pool.
+  struct ssimTask : public ThreadJob {
     const  ssimIndex     *that;
     const  Matrix<FLOAT> *img1;
     const  Matrix<FLOAT> *img2;
@@ -69,52 +79,154 @@ class ssimIndex {
     Matrix <UBYTE>       *err;
     const Image          *pic1;
     const Image          *pic2;
-    ULONG  offset;
-    ULONG  interleave;
-    DOUBLE result;
+    ULONG  first;        // the first window row of the stripe
+    ULONG  last;         // the window row beyond the stripe
+    DOUBLE result;       // the sum of the local ssim values
+    ULONG  count;        // the number of windows summed up
     DOUBLE scale;
     BOOL   doluminance;
-    int    size;
     int    nscales;
     DOUBLE cweight;
     DOUBLE gamma;
+    Matrix<DOUBLE>       *logprob; // receives the log probabilities for the error map, if any
+    const ReferenceMoments *reference; // the cached moments of img1, if any
     //
-#ifndef NO_POSIX
-    // pthread helpers here.
-    pthread_attr_t attr;
-    pthread_t pid;
-#endif
+    // Run the partial computation.
+    virtual void Run(void);
+  };
+  //
+  // This structure is used to splat the log probabilities of a scale into the
+  // rows first..last-1 of the error map. As every job owns its rows, no locking
+  // is required.
+  struct splatTask : public ThreadJob {
+    const  ssimIndex      *that;
+    const  Matrix<DOUBLE> *logprob;
+    const  DOUBLE         *profile;
+    int    size;
+    ULONG  first;
+    ULONG  last;
+    //
+    // Run the partial splat.
+    virtual void Run(void);
   };
   //
   // The window function.
   const Matrix<DOUBLE> m_Gauss;
   //
+  // The window function in row-major order, scaled by the number of
+  // taps, for the norms of the masking term.
+  DOUBLE              *m_pdMaskTaps;
+  //
+  // The number of windows whose norms are computed at once for masking.
+  enum {
+    MaskChunk = 256
+  };
+  //
   // The error map.
   Matrix<FLOAT>       *m_pError;
   //
-#ifndef NO_POSIX
-  // The entry point to start a SSIM thread.
-  static void *pthread_entry(void *arg);
-#endif
+  // The reference image whose moments are cached, if any.
+  const Image         *m_pReference;
+  //
+  // The cached moments of the reference, one per component and scale,
+  // component major.
+  class ReferenceMoments **m_ppMoments;
   //
-  // Compute the sim factor with a certain interleaving (only every n-th row) with the given start offset
-  // from the start of the picture.
+  // Number of components and scales of the cached moments.
+  int                  m_iComponents;
+  int                  m_iScales;
+  //
+  // Compute the sum of the local sim factors of the windows whose top rows are in the stripe
+  // first..last-1, and return the number of windows in count.
   double ssimFactor(const Matrix<FLOAT>& img1,const Matrix<FLOAT>& img2,DOUBLE scale,bool doluminance,
-		    ULONG offset, ULONG interleave,int size,DOUBLE cweight,DOUBLE gamma) const;
+		    ULONG first, ULONG last,DOUBLE cweight,DOUBLE gamma,ULONG &count,
+		    Matrix<DOUBLE> *logprob,const ReferenceMoments *reference) const;
+  //
+  // Compute the local SSIM of all windows of a window row from their moments,
+  // and return their sum. rows1 and rows2 are the image rows covered by the
+  // window row, they are only required for masking. If errormap is set,
+  // local receives the local SSIM of each window.
+  template<bool masking,bool luminance,bool errormap>
+  double WindowRowSSIM(const FLOAT *const *rows1,const FLOAT *const *rows2,
+		       DOUBLE *mu1,DOUBLE *mu2,DOUBLE *mxx,DOUBLE *myy,DOUBLE *mxy,ULONG mwidth,
+		       DOUBLE scale,DOUBLE *local) const;
+  //
+  // An instance of the above.
+  typedef double (ssimIndex::*RowKernel)(const FLOAT *const *rows1,const FLOAT *const *rows2,
+					 DOUBLE *mu1,DOUBLE *mu2,DOUBLE *mxx,DOUBLE *myy,DOUBLE *mxy,
+					 ULONG mwidth,DOUBLE scale,DOUBLE *local) const;
+  //
+  // Return the instance for the given masking mode that includes the
+  // luminance term and fills in the error map as requested.
+  template<bool masking>
+  static RowKernel SelectRowKernel(bool doluminance,bool errormap);
+  //
+  // Return the instance of WindowRowSSIM for the window and the masking of
+  // this index, to be picked once per scale.
+  RowKernel RowKernelOf(bool doluminance,bool errormap) const;
+  //
+  // Compute the one-dimensional cosine profile a window of a scale of the given
+  // size is splat with. The profile has (2 << size) entries.
+  static DOUBLE *CreateSplatProfile(int size);
+  //
+  // Accumulate the log probabilities of not detecting an error of a scale of
+  // the given size into the rows first..last-1 of the error map, using the
+  // separable cosine profile computed above.
+  void SplatError(const Matrix<DOUBLE> &logprob,int size,const DOUBLE *profile,ULONG first,ULONG last) const;
   //
   //
   //This method give back the overall ssimindex for all the(with the gausswindowfunction) computed windows 
-  double ssimFactor(Component& img1,Component& img2,DOUBLE scaling,int ncpus,bool bylevel,DOUBLE cweight) const;
+  // If reference is non-NULL, it contains the cached moments of all scales of img1.
+  double ssimFactor(Component& img1,Component& img2,DOUBLE scaling,int ncpus,bool bylevel,DOUBLE cweight,
+		    class ReferenceMoments *const *reference) const;
   //
 public:
+  //
+  // The default size of the SSIM window.
+  enum {
+    WindowSize = 11
+  };
+  //
+  // The windows and how their moments are computed: The gaussian by
+  // the separable window function or by its recursive approximation,
+  // see RecursiveMoments, or the uniform window by running sums, see
+  // BoxMoments.
+  enum WindowFilter {
+    Gaussian,
+    Recursive,
+    Box
+  };
+  //
+  // The default standard deviation of the window function.
+  static const DOUBLE DefaultSigma;
   //
   // Global SIM including color with a naive color weighting.
+  // If img1 is the cached reference, only the moments of img2 are computed.
   double ssimFactor(const Image& img1,const Image& img2,int ncpus,bool bylevel,Matrix<FLOAT> &err);
   //
-  ssimIndex(double masking = 2.0);
+  // Compute and keep the moments of a reference image that is compared against
+  // many distorted images. The image must remain valid until the reference is
+  // released or replaced.
+  void CacheReference(const Image &ref);
+  //
+  // Release the cached moments of the reference image.
+  void ReleaseReference(void);
+  //
+  // Print the largest deviations of the moments of the recursive filter
+  // from those of the window function, for all components and scales.
+  void CompareMoments(const Image &img1,const Image &img2) const;
+  //
+  // The window is window x window large, a gaussian with the standard
+  // deviation sigma, or uniform for the box filter. Reference moments are
+  // only cached for the gaussian window function.
+  ssimIndex(double masking = 2.0,ULONG window = WindowSize,double sigma = DefaultSigma,
+	    WindowFilter filter = Gaussian);
   //
   ~ssimIndex()
-  { }
+  {
+    ReleaseReference();
+    delete[] m_pdMaskTaps;
+  }
 };
 
 #endif
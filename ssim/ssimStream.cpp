@@ -0,0 +1,326 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class computes the (multiscale) SSIM of two images whose
+** scales are streamed in row by row while the images are decomposed,
+** keeping only the rows of each scale covered by a window.
+*/
+
+/// Includes
+#include "ssim/ssimStream.hpp"
+#include "ssim/ssimIndex.hpp"
+#include "img/image.hpp"
+#include "img/component.hpp"
+#include "wavelet/line.hpp"
+#include "moments/separablemoments.hpp"
+#include "moments/boxmoments.hpp"
+#include "std/math.hpp"
+#include "std/stdio.hpp"
+#include "std/string.hpp"
+///
+
+/// ssimStream::ssimStream
+// Attach the stream to the components of the two images.
+ssimStream::ssimStream(const class ssimIndex &index,class Image &img1,class Image &img2,
+		       ColorTransformer::ColorSpace space)
+  : m_Index(index), m_Img1(img1), m_Img2(img2),
+    m_iComponents(img1.ComponentCountOf()), m_iScales(img1.ComponentOf(0).ScalesOf()),
+    m_pScales(NULL), m_pTasks(NULL), m_ppJobs(NULL)
+{
+  ULONG w      = index.m_Gauss.WidthOf();
+  ULONG h      = index.m_Gauss.HeightOf();
+  ULONG width  = img1.ComponentOf(0).WidthOf();
+  ULONG height = img1.ComponentOf(0).HeightOf();
+  int i,k,s;
+  //
+  assert(m_iComponents <= MaxComponents && m_iComponents == img2.ComponentCountOf());
+  //
+  // The transformation only defines the weights of the components here,
+  // the rows are transformed once they are complete.
+  m_Transformer[0].SpaceOf() = space;
+  m_Transformer[1].SpaceOf() = space;
+  m_bTransform = m_Transformer[0].PrepareTransform(&img1);
+  m_Transformer[1].PrepareTransform(&img2);
+  //
+  m_pScales = new struct streamScale[m_iScales];
+  m_pTasks  = new struct windowTask[m_iScales * m_iComponents];
+  m_ppJobs  = new class ThreadJob *[m_iScales * m_iComponents];
+  //
+  for(s = 0;s < m_iScales;s++) {
+    struct streamScale *scale = m_pScales + s;
+    //
+    scale->width   = width;
+    scale->height  = height;
+    scale->windows = (height >= h && width >= w)?(height - h + 1):(0);
+    scale->stripe  = (scale->windows > 0)?
+      (ThreadPool::StripeHeightOf(scale->windows,2 * width * sizeof(FLOAT),h - 1)):(1);
+    scale->ready   = 0;
+    scale->next    = 0;
+    for(i = 0;i < MaxComponents;i++) {
+      scale->moments[i] = NULL;
+      scale->box[i]     = NULL;
+      scale->buffer[i]  = NULL;
+      scale->sum[i]     = 0.0;
+      scale->partial[i] = 0.0;
+      scale->count[i]   = 0;
+      for(k = 0;k < 2;k++)
+	scale->received[k][i] = 0;
+    }
+    //
+    // Scales smaller than the window do not require their rows.
+    if (scale->windows > 0) {
+      for(i = 0;i < m_iComponents;i++) {
+	// The running sums restart at the stripes, as for the non-streaming
+	// computation.
+	if (index.m_iFilter == ssimIndex::Box) {
+	  scale->box[i]     = new class BoxMoments(width,w,h,scale->stripe);
+	} else {
+	  scale->moments[i] = new class SeparableMoments(width,index.m_Gauss);
+	}
+	scale->buffer[i]  = new DOUBLE[5 * (width - w + 1)];
+	for(k = 0;k < 2;k++)
+	  scale->ring[k][i].Allocate(width,2 * h);
+      }
+    }
+    //
+    width  = ((width  - 1) >> 1) + 1;
+    height = ((height - 1) >> 1) + 1;
+  }
+  //
+  for(k = 0;k < 2;k++) {
+    class Image &img = (k == 0)?(img1):(img2);
+    for(i = 0;i < m_iComponents;i++) {
+      m_Taps[k][i].that      = this;
+      m_Taps[k][i].image     = k;
+      m_Taps[k][i].component = i;
+      img.ComponentOf(i).StreamTo(&m_Taps[k][i]);
+    }
+  }
+}
+///
+
+/// ssimStream::~ssimStream
+ssimStream::~ssimStream(void)
+{
+  int i,s;
+
+  if (m_pScales) {
+    for(s = 0;s < m_iScales;s++) {
+      for(i = 0;i < MaxComponents;i++) {
+	delete m_pScales[s].moments[i];
+	delete m_pScales[s].box[i];
+	delete[] m_pScales[s].buffer[i];
+      }
+    }
+    delete[] m_pScales;
+  }
+  delete[] m_pTasks;
+  delete[] m_ppJobs;
+}
+///
+
+/// ssimStream::streamTap::ReceiveLine
+// Copy a line of a scale into its ring. The ring grows if the other
+// image or the other components lag behind by more rows than it holds.
+void ssimStream::streamTap::ReceiveLine(UBYTE resolution,ULONG y,const class Line *line,ULONG width)
+{
+  struct streamScale *scale = that->m_pScales + (that->m_iScales - 1 - resolution);
+  //
+  assert(y == scale->received[image][component]);
+  assert(width == scale->width);
+  //
+  if (scale->windows > 0) {
+    Matrix<FLOAT> &ring = scale->ring[image][component];
+    ULONG size          = ring.HeightOf();
+    //
+    if (y - scale->next >= size) {
+      Matrix<FLOAT> grown(width,size << 1);
+      ULONG r;
+      //
+      for(r = scale->next;r < y;r++)
+	memcpy(&grown.At(0,r % (size << 1)),&ring.At(0,r % size),width * sizeof(FLOAT));
+      ring = grown;
+    }
+    line->Store(&ring.At(0,y % ring.HeightOf()),0,width);
+  }
+  scale->received[image][component]++;
+}
+///
+
+/// ssimStream::windowTask::Run
+// Evaluate the window rows of a component in a scale.
+void ssimStream::windowTask::Run(void)
+{
+  that->EvaluateWindows(scale,level,component,first,last);
+}
+///
+
+/// ssimStream::EvaluateWindows
+// Evaluate the window rows first..last-1 of a component in a scale,
+// and sum them up in the stripes of the non-streaming computation.
+void ssimStream::EvaluateWindows(struct streamScale *scale,int level,int component,ULONG first,ULONG last)
+{
+  ULONG h                  = m_Index.m_Gauss.HeightOf();
+  class SeparableMoments *moments = scale->moments[component];
+  class BoxMoments *box    = scale->box[component];
+  ULONG mwidth             = scale->width - m_Index.m_Gauss.WidthOf() + 1;
+  DOUBLE *mu1              = scale->buffer[component];
+  DOUBLE *mu2              = mu1 + mwidth;
+  DOUBLE *mxx              = mu2 + mwidth;
+  DOUBLE *myy              = mxx + mwidth;
+  DOUBLE *mxy              = myy + mwidth;
+  Matrix<FLOAT> &ring1     = scale->ring[0][component];
+  Matrix<FLOAT> &ring2     = scale->ring[1][component];
+  DOUBLE scaling           = m_Img1.ComponentOf(component).ScaleOf();
+  bool doluminance         = (level == m_iScales - 1);
+  ssimIndex::RowKernel kernel = m_Index.RowKernelOf(doluminance,false);
+  const FLOAT **rows1      = new const FLOAT *[2 * h];
+  const FLOAT **rows2      = rows1 + h;
+  ULONG y,j;
+
+  for(y = first;y < last;y++) {
+    for(j = 0;j < h;j++) {
+      rows1[j] = &ring1.At(0,(y + j) % ring1.HeightOf());
+      rows2[j] = &ring2.At(0,(y + j) % ring2.HeightOf());
+    }
+    if (box) {
+      box->MomentsOf(y,rows1,rows2,mu1,mu2,mxx,myy,mxy);
+    } else {
+      moments->MomentsOf(y,rows1,rows2,mu1,mu2,mxx,myy,mxy);
+    }
+    scale->partial[component] += (m_Index.*kernel)(rows1,rows2,mu1,mu2,mxx,myy,mxy,mwidth,
+						    scaling,NULL);
+    scale->count[component]   += mwidth;
+    //
+    // Close the stripe.
+    if ((y + 1) % scale->stripe == 0 || y + 1 == scale->windows) {
+      scale->sum[component]     += scale->partial[component];
+      scale->partial[component]  = 0.0;
+    }
+  }
+
+  delete[] rows1;
+}
+///
+
+/// ssimStream::Advance
+// Evaluate all windows completed by the rows pushed into both images so far.
+void ssimStream::Advance(int ncpus)
+{
+  ULONG h = m_Index.m_Gauss.HeightOf();
+  int count = 0;
+  int i,k,s;
+
+  for(s = 0;s < m_iScales;s++) {
+    struct streamScale *scale = m_pScales + s;
+    ULONG ready               = scale->received[0][0];
+    ULONG y,last;
+    //
+    for(k = 0;k < 2;k++) {
+      for(i = 0;i < m_iComponents;i++) {
+	if (scale->received[k][i] < ready)
+	  ready = scale->received[k][i];
+      }
+    }
+    if (scale->windows == 0) {
+      scale->ready = ready;
+      continue;
+    }
+    //
+    // Transform the rows that are now complete in all components.
+    if (m_bTransform) {
+      for(y = scale->ready;y < ready;y++) {
+	for(k = 0;k < 2;k++) {
+	  Matrix<FLOAT> &r = scale->ring[k][0];
+	  Matrix<FLOAT> &g = scale->ring[k][1];
+	  Matrix<FLOAT> &b = scale->ring[k][2];
+	  Matrix<FLOAT> rm(r,0,y % r.HeightOf(),scale->width,1);
+	  Matrix<FLOAT> gm(g,0,y % g.HeightOf(),scale->width,1);
+	  Matrix<FLOAT> bm(b,0,y % b.HeightOf(),scale->width,1);
+	  m_Transformer[k].ForwardsTransform(rm,gm,bm);
+	}
+      }
+    }
+    scale->ready = ready;
+    //
+    // Window rows whose bottom row is complete can be evaluated.
+    last = (ready >= h)?(ready - h + 1):(0);
+    if (last > scale->next) {
+      for(i = 0;i < m_iComponents;i++) {
+	m_pTasks[count].that      = this;
+	m_pTasks[count].scale     = scale;
+	m_pTasks[count].level     = s;
+	m_pTasks[count].component = i;
+	m_pTasks[count].first     = scale->next;
+	m_pTasks[count].last      = last;
+	m_ppJobs[count]           = m_pTasks + count;
+	count++;
+      }
+    }
+  }
+  //
+  // The components and scales are independent of each other.
+  ThreadPool::Execute(m_ppJobs,count,ncpus);
+  for(i = 0;i < count;i++)
+    m_pTasks[i].scale->next = m_pTasks[i].last;
+}
+///
+
+/// ssimStream::ResultOf
+// Return the SSIM once all rows have been pushed and advanced.
+double ssimStream::ResultOf(bool bylevel) const
+{
+  DOUBLE ssim = 0.0;
+  int i,s;
+
+  for(i = 0;i < m_iComponents;i++) {
+    const class Component &comp = m_Img1.ComponentOf(i);
+    DOUBLE result = 1.0;
+    //
+    if (bylevel)
+      printf("\n%s component:\n",comp.NameOf());
+    for(s = 0;s < m_iScales;s++) {
+      const struct streamScale *scale = m_pScales + s;
+      DOUBLE thissim;
+      //
+      assert(scale->ready == scale->height && scale->next == scale->windows);
+      //
+      // Images smaller than the window do not contain a single window position.
+      thissim = (scale->count[i] > 0)?(scale->sum[i] / scale->count[i]):(1.0);
+      if (bylevel)
+	printf("log ssim value for scale %d: %f\n",s + 1,-20.0 * log(1.0 - thissim) / log(10.0));
+      //
+      // If this is a single-scale ssim, no exponent.
+      if (m_iScales > 1) {
+	result *= pow(thissim,ssimIndex::Weights[s]);
+      } else {
+	result *= thissim;
+      }
+    }
+    ssim += comp.WeightOf() * result;
+  }
+
+  return ssim;
+}
+///
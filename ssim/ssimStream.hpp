@@ -0,0 +1,182 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class computes the (multiscale) SSIM of two images whose
+** scales are streamed in row by row while the images are decomposed,
+** keeping only the rows of each scale covered by a window.
+*/
+
+#ifndef SSIM_SSIMSTREAM_HPP
+#define SSIM_SSIMSTREAM_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/matrix.hpp"
+#include "global/threadpool.hpp"
+#include "wavelet/linesink.hpp"
+#include "ctrafo/colortransformer.hpp"
+///
+
+/// Forwards
+class Image;
+class ssimIndex;
+class SeparableMoments;
+///
+
+/// class ssimStream
+// The stream attaches itself to the components of two images opened
+// by Image::OpenPNM, before their rows are pushed. Each scale of each
+// component then hands its lines over as soon as the band produces
+// them, and the stream keeps them in a ring of a few rows more than
+// the window height. Once a row is available in all components of
+// both images, it is color transformed, and all window rows it
+// completes are evaluated. Memory is thus proportional to the width
+// of the images times the window height, instead of their area.
+//
+// The partitioning of the window rows into stripes is reproduced,
+// hence the result is identical to that of ssimIndex on the fully
+// decomposed images. Error maps and cached reference moments are
+// not supported.
+class ssimStream {
+  //
+  enum {
+    MaxComponents = 3
+  };
+  //
+  // The sink of one component of one of the images.
+  struct streamTap : public LineSink {
+    class ssimStream *that;
+    int               image;
+    int               component;
+    //
+    // Copy the line into the ring of its scale.
+    virtual void ReceiveLine(UBYTE resolution,ULONG y,const class Line *line,ULONG width);
+  };
+  //
+  // The rows and the running SSIM of one scale of all components.
+  struct streamScale {
+    //
+    // Dimensions of the scale.
+    ULONG          width;
+    ULONG          height;
+    //
+    // The number of window rows of the scale, zero if the scale
+    // is smaller than the window.
+    ULONG          windows;
+    //
+    // The height of the stripes the window rows are summed up in.
+    ULONG          stripe;
+    //
+    // The rings of image rows, per image and component. Row y is kept
+    // at y modulo the height of the ring.
+    Matrix<FLOAT>  ring[2][MaxComponents];
+    //
+    // The number of rows received per image and component.
+    ULONG          received[2][MaxComponents];
+    //
+    // The number of rows received by all components of both images,
+    // and color transformed.
+    ULONG          ready;
+    //
+    // The next window row to evaluate. Rows above it are no longer
+    // required.
+    ULONG          next;
+    //
+    // The moments of the windows, per component, either by the window
+    // function or by running sums over the uniform window.
+    class SeparableMoments *moments[MaxComponents];
+    class BoxMoments       *box[MaxComponents];
+    //
+    // Buffers for the moments of a window row, per component.
+    DOUBLE        *buffer[MaxComponents];
+    //
+    // The sum of the local SSIM of all completed stripes, the sum of
+    // the current stripe, and the number of windows, per component.
+    DOUBLE         sum[MaxComponents];
+    DOUBLE         partial[MaxComponents];
+    ULONG          count[MaxComponents];
+  };
+  //
+  // Evaluates the window rows first..last-1 of a component in a scale.
+  struct windowTask : public ThreadJob {
+    class ssimStream   *that;
+    struct streamScale *scale;
+    int                 level;
+    int                 component;
+    ULONG               first;
+    ULONG               last;
+    //
+    virtual void Run(void);
+  };
+  //
+  // The index providing the window and the masking.
+  const class ssimIndex &m_Index;
+  //
+  // The two images.
+  class Image          &m_Img1;
+  class Image          &m_Img2;
+  //
+  // The number of components and scales.
+  int                   m_iComponents;
+  int                   m_iScales;
+  //
+  // The sinks, per image and component.
+  struct streamTap      m_Taps[2][MaxComponents];
+  //
+  // The scales, the original scale first.
+  struct streamScale   *m_pScales;
+  //
+  // The jobs evaluating the window rows.
+  struct windowTask    *m_pTasks;
+  class ThreadJob     **m_ppJobs;
+  //
+  // The color transformations of the rows, one per image.
+  class ColorTransformer m_Transformer[2];
+  bool                  m_bTransform;
+  //
+  // Evaluate the window rows first..last-1 of a component in a scale.
+  void EvaluateWindows(struct streamScale *scale,int level,int component,ULONG first,ULONG last);
+  //
+public:
+  // Attach the stream to the components of the two images. The images
+  // must have the same dimensions, and no rows must have been pushed.
+  // The stream must remain alive while the rows are pushed. Color
+  // images are transformed into the given color space.
+  ssimStream(const class ssimIndex &index,class Image &img1,class Image &img2,
+	     ColorTransformer::ColorSpace space = ColorTransformer::YCbCr);
+  //
+  ~ssimStream(void);
+  //
+  // Evaluate all windows completed by the rows pushed into both images
+  // so far, on up to ncpus CPUs.
+  void Advance(int ncpus);
+  //
+  // Return the SSIM once all rows have been pushed and advanced.
+  // Optionally print the SSIM of the individual scales.
+  double ResultOf(bool bylevel) const;
+};
+///
+
+///
+#endif
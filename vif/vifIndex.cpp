@@ -24,6 +24,8 @@
 
 #include "vifIndex.hpp"
 #include "global/matrix.hpp"
+#include "moments/separablemoments.hpp"
+#include "moments/boxmoments.hpp"
 #include "std/math.hpp"
 #include "std/stdio.hpp"
 
@@ -138,20 +140,14 @@ double vifIndex::vifFactor(const Image& img1,const Image& img2,int ncpus,bool by
 }
 ///
 
-/// vifIndex::pthread_entry
-// The entry point to start a vif thread.
-#ifndef NO_POSIX
-void *vifIndex::pthread_entry(void *arg)
+/// vifIndex::vifTask::Run
+// Run a partial vif computation in the thread pool.
+void vifIndex::vifTask::Run(void)
 {
-  struct vifTask *task = (struct vifTask *)arg;
-
-  task->that->vifFactor(*task->img1,*task->img2,task->scale,
-			task->offset,task->interleave,task->var,
-			task->numerator,task->denominator);
-
-  return task;
+  that->vifFactor(*img1,*img2,scale,
+		  first,last,var,noise,
+		  numerator,denominator);
 }
-#endif
 ///
 
 /// vifIndex::vifFactor
@@ -161,13 +157,17 @@ void vifIndex::vifFactorScales(Component& img1,Component& img2,DOUBLE scaling,in
 {
   int scale,nscales = img1.ScalesOf();
   int band;
+  //
+  // The noise variance is that of samples without fractional bits.
+  DOUBLE noise = ldexp(K,2 * img1.FractionOf());
   
   for(scale = 1;scale <= nscales;scale++) {
     if (scale == nscales) {
-      vifMultiCoreFactor(img1.GetScale(scale),img2.GetScale(scale),scaling,ncpus,numerator,denominator);
+      vifMultiCoreFactor(img1.GetScale(scale),img2.GetScale(scale),scaling,noise,ncpus,numerator,denominator);
     } else {
       for(band = 1;band <= 3;band++) {
-	vifMultiCoreFactor(img1.GetBand(scale,band),img2.GetBand(scale,band),scaling,ncpus,numerator,denominator);
+	vifMultiCoreFactor(img1.GetBand(scale,band),img2.GetBand(scale,band),scaling,noise,ncpus,
+			   numerator,denominator);
       }
     }
     if (bylevel)
@@ -178,44 +178,43 @@ void vifIndex::vifFactorScales(Component& img1,Component& img2,DOUBLE scaling,in
 
 /// vifIndex::vifMultiCoreFactor
 // Compute the vif factor for a multi-core CPU with potentially using threads.
-void vifIndex::vifMultiCoreFactor(const Matrix<FLOAT>& c1,const Matrix<FLOAT>& c2,DOUBLE scaling,int ncpus,
-				  double &numerator,double &denominator) const
+void vifIndex::vifMultiCoreFactor(const Matrix<FLOAT>& c1,const Matrix<FLOAT>& c2,DOUBLE scaling,DOUBLE noise,
+				  int ncpus,double &numerator,double &denominator) const
 {    
   double var = variance(c1);
 
-#ifdef NO_POSIX
-  vifFactor(c1,c2,scaling,0,1,var,numerator,denominator);
-#else
-  if (ncpus == 1) {
-    vifFactor(c1,c2,scaling,0,1,var,numerator,denominator);
-  } else {
-    int i;
-    struct vifTask *tasks = new vifTask[ncpus];
-    //
-    for(i = 0;i < ncpus;i++) {
-      tasks[i].that        = this;
-      tasks[i].img1        = &c1;
-      tasks[i].img2        = &c2;
-      tasks[i].offset      = i;
-      tasks[i].interleave  = ncpus;
-      tasks[i].scale       = scaling;
-      tasks[i].numerator   = 0.0;
-      tasks[i].denominator = 0.0;
-      tasks[i].var         = var;
-      pthread_attr_init(&tasks[i].attr);
-      pthread_attr_setdetachstate(&tasks[i].attr,PTHREAD_CREATE_JOINABLE);
-      pthread_create(&tasks[i].pid,&tasks[i].attr,&vifIndex::pthread_entry,tasks+i);
-    }
-    //
-    // Now wait for all threads to complete, and collect their results.
-    for(i = 0;i < ncpus;i++) {
-      pthread_join(tasks[i].pid,NULL);
-      numerator   += tasks[i].numerator;
-      denominator += tasks[i].denominator;
-    }
-    delete[] tasks;
+  ULONG h      = m_Gauss.HeightOf();
+  ULONG rows   = (c1.HeightOf() >= h)?(c1.HeightOf() - h + 1):(0);
+  ULONG stripe = ThreadPool::StripeHeightOf(rows,2 * c1.WidthOf() * sizeof(FLOAT),h - 1);
+  int stripes  = (rows + stripe - 1) / stripe;
+  int i;
+  struct vifTask *tasks = new vifTask[stripes];
+  class ThreadJob **jobs = new class ThreadJob *[stripes];
+  //
+  // Partition the image into contiguous stripes of window rows, each job
+  // works on its own region of the image.
+  for(i = 0;i < stripes;i++) {
+    tasks[i].that        = this;
+    tasks[i].img1        = &c1;
+    tasks[i].img2        = &c2;
+    tasks[i].first       = i * stripe;
+    tasks[i].last        = (i + 1 < stripes)?((i + 1) * stripe):(rows);
+    tasks[i].scale       = scaling;
+    tasks[i].noise       = noise;
+    tasks[i].numerator   = 0.0;
+    tasks[i].denominator = 0.0;
+    tasks[i].var         = var;
+    jobs[i]              = tasks + i;
   }
-#endif
+  //
+  // Run the jobs, and collect their results.
+  ThreadPool::Execute(jobs,stripes,ncpus);
+  for(i = 0;i < stripes;i++) {
+    numerator   += tasks[i].numerator;
+    denominator += tasks[i].denominator;
+  }
+  delete[] jobs;
+  delete[] tasks;
 }
 ///
 
@@ -249,66 +248,49 @@ double vifIndex::variance(const Matrix<FLOAT> &img)
 ///
 
 /// vifIndex::vifFactor
-// Compute the sim factor with a certain interleaving (only every n-th row) with the given start offset
-// from the start of the picture.
+// Compute vif for the windows whose top rows are in the stripe first..last-1,
+// return numerator and denominator.
 void vifIndex::vifFactor(const Matrix<FLOAT>& img1,const Matrix<FLOAT>& img2,DOUBLE scale,
-			 ULONG offset, ULONG interleave,double var,
+			 ULONG first, ULONG last,double var,double noise,
 			 double &numerator,double &denominator) const
 {
   //the 2 images will be transform in a "float" matrix.
   ULONG width  = img1.WidthOf();
-  ULONG height = img1.HeightOf();
   
   //The GaussFilter will be apply
   ULONG w  = m_Gauss.WidthOf();
   ULONG h  = m_Gauss.HeightOf();
-  ULONG sz = w * h;
   ULONG ct = 0;
   
   double C2 = (K2*scale)*(K2*scale);
   double C3 = C2 / 2.0; //* C2 / 4.0; // Note that we need s^2 here, not s.
   double C4 = K; // according to the VIF matlab code, this value of K is already scaled to 8bpp.
 
-  for(ULONG y1 = offset;y1 <= height-h;y1 += interleave){
-    for(ULONG x1 = 0;x1 <= width-w;x1++){
-      ULONG x,y;
-      double lumvalue_1  = 0.0,lumvalue_2  = 0.0;
-      double con2value_1 = 0.0,con2value_2 = 0.0;
-      double corrvalue   = 0.0;
-      double numadd,denadd;
-      double gv,vv;
-      
-      // Collect moments. Note that we do that in one
-      // loop. The above code does in several, but this
-      // is definitely quicker.
-      for( y=0;y<h;y++){
-	for( x=0;x<w;x++){
-	  double k1    = img1.Get(x+x1,y+y1);
-	  double k2    = img2.Get(x+x1,y+y1);
+  if (width < w || first >= last)
+    return;
+  //
+  // Collect the moments of a window row at once. Without the window
+  // function, the windows are uniform, and their sums are running sums
+  // at constant cost per window.
 #ifdef DO_WINDOWING
-	  double valv  = m_Gauss.Get(x,y);
-	  lumvalue_1  += k1*valv;
-	  lumvalue_2  += k2*valv;
-	  con2value_1 += k1*k1*valv;
-	  con2value_2 += k2*k2*valv;
-	  corrvalue   += k1*k2*valv;
+  class SeparableMoments moments(img1,img2,m_Gauss);
 #else
-	  lumvalue_1  += k1;
-	  lumvalue_2  += k2;
-	  con2value_1 += k1*k1;
-	  con2value_2 += k2*k2;
-	  corrvalue   += k1*k2;
-#endif
-	}
-      }
-#ifndef DO_WINDOWING
-      // m_Gauss normalized the values to one. We do this now manually.
-      lumvalue_1  /= sz;
-      lumvalue_2  /= sz;
-      con2value_1 /= sz;
-      con2value_2 /= sz;
-      corrvalue   /= sz;
+  class BoxMoments moments(img1,img2,w,h,last - first);
 #endif
+  ULONG mwidth = moments.WidthOf();
+  DOUBLE *mu1  = new DOUBLE[5 * mwidth];
+  DOUBLE *mu2  = mu1 + mwidth;
+  DOUBLE *mxx  = mu2 + mwidth;
+  DOUBLE *myy  = mxx + mwidth;
+  DOUBLE *mxy  = myy + mwidth;
+
+  for(ULONG y1 = first;y1 < last;y1++){
+    moments.MomentsOf(y1,mu1,mu2,mxx,myy,mxy);
+    for(ULONG x1 = 0;x1 < mwidth;x1++){
+      double lumvalue_1  = mu1[x1],lumvalue_2  = mu2[x1];
+      double con2value_1 = mxx[x1],con2value_2 = myy[x1];
+      double corrvalue   = mxy[x1];
+      double gv,vv;
       //
       // Fixup the moments so we really get what is needed.
       con2value_1     -= lumvalue_1 * lumvalue_1;
@@ -338,13 +320,15 @@ void vifIndex::vifFactor(const Matrix<FLOAT>& img1,const Matrix<FLOAT>& img2,DOU
 	gv = 0.0;
       }
       //
-      numerator += log(1.0 + (gv * var) / (vv + K));
+      numerator += log(1.0 + (gv * var) / (vv + noise));
       ct++;
     }
   }
   //
   // The numerator does not depend on the samples at all.
-  denominator += ct * log(1.0 + var / K);
+  denominator += ct * log(1.0 + var / noise);
+
+  delete[] mu1;
 }
 ///
 
@@ -33,11 +33,7 @@
 #include "global/matrix.hpp"
 #include "img/image.hpp"
 #include "img/component.hpp"
-#ifndef NO_POSIX
-extern "C" {
-#include <pthread.h>
-}
-#endif
+#include "global/threadpool.hpp"
 
 
 class vifIndex {
@@ -56,8 +52,8 @@ class vifIndex {
   // This method creates a Hamming window of the given size.
   static Matrix<DOUBLE> CreateHammingWindow(ULONG w, ULONG h);
   //
-  // This structure is used to start a new thread with a partial ssim computation.
-  struct vifTask {
+  // This structure is used to run a partial vif computation in the thread pool.
+  struct vifTask : public ThreadJob {
     const  vifIndex      *that;
     const  Matrix<FLOAT> *img1;
     const  Matrix<FLOAT> *img2;
@@ -65,38 +61,32 @@ class vifIndex {
     Matrix <UBYTE>       *err;
     const Image          *pic1;
     const Image          *pic2;
-    ULONG  offset;
-    ULONG  interleave;
+    ULONG  first;        // the first window row of the stripe
+    ULONG  last;         // the window row beyond the stripe
     DOUBLE numerator;    // will return the numerator of the VIF, information capacity for distorted image
     DOUBLE denominator;  // information capacity for the reference image.
     DOUBLE scale;
     DOUBLE var;          // variance
+    DOUBLE noise;        // variance of the perception noise, in the scale of the samples
     //
-#ifndef NO_POSIX
-    // pthread helpers here.
-    pthread_attr_t attr;
-    pthread_t pid;
-#endif
+    // Run the partial computation.
+    virtual void Run(void);
   };
   //
   // The window function.
   const Matrix<DOUBLE> m_Gauss;
   //
-#ifndef NO_POSIX
-  // The entry point to start a SSIM thread.
-  static void *pthread_entry(void *arg);
-#endif
-  //
-  // Compute vif with a certain interleaving (only every n-th row) with the given start offset
-  // from the start of the picture, return numerator and denominator.
+  // Compute vif for the windows whose top rows are in the stripe first..last-1,
+  // return numerator and denominator. noise is the variance of the perception
+  // noise.
   void vifFactor(const Matrix<FLOAT>& img1,const Matrix<FLOAT>& img2,DOUBLE scale,
-		 ULONG offset, ULONG interleave,DOUBLE var,
+		 ULONG first, ULONG last,DOUBLE var,DOUBLE noise,
 		 DOUBLE &numerator,DOUBLE &denominator) const;
   //
   //
   // Compute the vif factor for a multi-core CPU with potentially using threads.
-  void vifMultiCoreFactor(const Matrix<FLOAT>& img1,const Matrix<FLOAT>& img2,DOUBLE scaling,int ncpus,
-			  double &numerator,double &denominator) const;
+  void vifMultiCoreFactor(const Matrix<FLOAT>& img1,const Matrix<FLOAT>& img2,DOUBLE scaling,DOUBLE noise,
+			  int ncpus,double &numerator,double &denominator) const;
   //
   // Return the global vif for the given images.
   void vifFactorScales(Component& img1,Component& img2,DOUBLE scaling,int ncpus,bool bylevel,
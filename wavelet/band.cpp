@@ -31,43 +31,48 @@
 #include "band.hpp"
 #include "line.hpp"
 #include "filter.hpp"
+#include "lineslab.hpp"
+#include "bandarena.hpp"
+#include "linesink.hpp"
 ///
 
 /// Band::Band
 // Setup a band of the given dimensions
-Band::Band(ULONG width,ULONG height,UBYTE reslvl,bool keephp)
+Band::Band(ULONG width,ULONG height,UBYTE reslvl,bool keephp,class LineSlab *slab)
   : m_ucResolution(reslvl),
     m_ulWidth(width), m_ulHeight(height),
-    m_Coefficients((keephp)?(0):(width),(keephp)?(0):(height)),
-    m_HL((keephp)?((width + 0) >> 1):(0),(keephp)?((height + 1) >> 1):(0)),
-    m_LH((keephp)?((width + 1) >> 1):(0),(keephp)?((height + 0) >> 1):(0)),
-    m_HH((keephp)?((width + 0) >> 1):(0),(keephp)?((height + 0) >> 1):(0)),
-    m_lY(0), m_ulYO(0), m_bExtend(true), m_bKeepHP(keephp) // starts with empty lines in the buffer.
+    m_lY(0), m_ulYO(0), m_ulLowPass(0), m_bExtend(true), m_bKeepHP(keephp) // starts with empty lines in the buffer.
 {
   int i;
   
   m_pSubBand = NULL;
+  m_pSlab    = slab;
+  m_pArena   = NULL;
+  m_pSink    = NULL;
+  m_iSpare   = 0;
 
   for(i = 0;i < RegisterSize;i++) {
     m_pRegister[i] = NULL;
     m_pMirrored[i] = NULL;
   }
+  //
+  // Only bands that are transformed require lines.
+  if (reslvl > 0) {
+    class Line *const *lines = slab->LinesOf(reslvl);
+    for(i = 0;i < RegisterSize;i++) {
+      m_pSpare[i] = lines[i];
+    }
+    m_iSpare = RegisterSize;
+  }
 }
 ///
 
 /// Band::~Band
-// Delete this band and the entire band hierarchy.
+// Delete this band and the entire band hierarchy. The lines
+// belong to the slab and are not deleted here.
 Band::~Band(void)
 {
-  int i;
-  
   delete m_pSubBand;
-  
-  // The mirrored pointers do not get deleted. No need to
-  // as they are just copies of the original line pointers.
-  for(i = 0;i < RegisterSize;i++) {
-    delete m_pRegister[i];
-  }
 }
 ///
 
@@ -78,34 +83,79 @@ class Band *Band::SubBandOf(void)
   if (m_ucResolution > 0 && m_pSubBand == NULL) {
     ULONG width  = ((WidthOf()  - 1) >> 1) + 1;
     ULONG height = ((HeightOf() - 1) >> 1) + 1;
-    m_pSubBand   = new Band(width,height,m_ucResolution - 1,(m_ucResolution == 1)?(false):(m_bKeepHP));
+    m_pSubBand   = new Band(width,height,m_ucResolution - 1,(m_ucResolution == 1)?(false):(m_bKeepHP),m_pSlab);
+    m_pSubBand->StreamTo(m_pSink);
+    m_pSubBand->UseArena(m_pArena);
   }
   return m_pSubBand;
 }
 ///
 
+/// Band::StreamTo
+// Stream the lines of this band and all its sub-bands into the given
+// sink instead of keeping them.
+void Band::StreamTo(class LineSink *sink)
+{
+  assert(m_lY == 0);
+  //
+  m_pSink = sink;
+  if (m_pSubBand)
+    m_pSubBand->StreamTo(sink);
+}
+///
+
+/// Band::UseArena
+// Take the matrices of this band and all its sub-bands from the given
+// arena. The matrices are assigned along with the first line.
+void Band::UseArena(class BandArena *arena)
+{
+  assert(m_lY == 0);
+  //
+  m_pArena = arena;
+  if (m_pSubBand)
+    m_pSubBand->UseArena(arena);
+}
+///
+
 /// Band::PushLine
 // Push a line for transformation into this band.
 void Band::PushLine(const class Line *data)
 {
   assert(m_lY < LONG(HeightOf()));
   //
-  // Store the data in the matrix before we proceed.
-  if (!m_bKeepHP)
-    data->Deinterleave(&m_Coefficients.At(0,m_lY),false);
+  // Get the matrices along with the first line.
+  if (m_lY == 0) {
+    assert(m_pArena);
+    if (m_bKeepHP) {
+      m_HL = m_pArena->MatrixOf(m_ucResolution,1);
+      m_LH = m_pArena->MatrixOf(m_ucResolution,2);
+      m_HH = m_pArena->MatrixOf(m_ucResolution,3);
+    } else if (m_pSink == NULL) {
+      m_Coefficients = m_pArena->MatrixOf(m_ucResolution,0);
+    }
+  }
+  //
+  // Store the data in the matrix before we proceed, or hand it over to
+  // the sink. The first pixels of the line are the pixels of this band,
+  // the low-pass of the parent.
+  if (m_pSink) {
+    m_pSink->ReceiveLine(m_ucResolution,m_lY,data,WidthOf());
+  } else if (!m_bKeepHP) {
+    data->Store(&m_Coefficients.At(0,m_lY),0,WidthOf());
+  }
   //
   if (m_ucResolution > 0) {
     if (HeightOf() == 1) {
       class Line *line = NewLine(m_lY);
       // Single line case. Do not transform.
-      data->Deinterleave(line->Origin(),false);
+      data->Store(line->Origin(),0,WidthOf());
       // Just push the data into the subbands.
       line->MirrorExtend();
       Filter::HLift(line);
       //
       // This is only the low-pass signal. Keep that in the filters if required.
       if (m_bKeepHP) {
-	line->Deinterleave(&m_HL.At(0,m_ulYO),true);
+	line->Store(&m_HL.At(0,m_ulYO),line->LowPassLengthOf(),WidthOf() >> 1);
 	m_ulYO++;
       }
       SubBandOf()->PushLine(line);
@@ -113,7 +163,7 @@ void Band::PushLine(const class Line *data)
     } else {
       bool cont;
       class Line *line = NewLine(m_lY);
-      data->Deinterleave(line->Origin(),false); // Extract only the low-pass pixels.
+      data->Store(line->Origin(),0,WidthOf()); // Extract only the low-pass pixels.
       //
       do {
 	//
@@ -157,7 +207,8 @@ void Band::PushLine(const class Line *data)
 	// If at end of buffer, cleanup.
 	if (cont && m_lY >= LONG(HeightOf())) {
 	  class Line *&line = NewLine(m_lY);
-	  delete line;
+	  // Return the line to the spares.
+	  m_pSpare[m_iSpare++] = line;
 	  line      = NULL;
 	  // We just inserted a NULL into the register,
 	  // turn mirroring back on.
@@ -189,7 +240,9 @@ bool Band::ShiftLineRegister(void)
   even = m_pRegister[0];
   odd  = m_pRegister[1];
   //
-  if ((res = (odd && even))) {
+  // For an odd height, the last even line comes without an odd partner,
+  // but still carries a low-pass line.
+  if (even) {
     // The odd line contains the high-pass. We do not need
     // them at all.
     //
@@ -198,22 +251,31 @@ bool Band::ShiftLineRegister(void)
     //
     // Keep the resulting lines.
     if (m_bKeepHP) {
-      even->Deinterleave(&m_HL.At(0,m_ulYO),true);
-      odd->MirrorExtend();
-      Filter::HLift(odd);
-      odd->Deinterleave(&m_LH.At(0,m_ulYO),false);
-      odd->Deinterleave(&m_HH.At(0,m_ulYO),true);
+      ULONG low  = even->LowPassLengthOf();
+      ULONG high = WidthOf() - low;
+      //
+      even->Store(&m_HL.At(0,m_ulYO),low,high);
+      if (odd) {
+	odd->MirrorExtend();
+	Filter::HLift(odd);
+	odd->Store(&m_LH.At(0,m_ulYO),0,low);
+	odd->Store(&m_HH.At(0,m_ulYO),low,high);
+      }
       m_ulYO++;
     }
     //
     // Now push into the low-pass.
     SubBandOf()->PushLine(even);
+    m_ulLowPass++;
     // Line is done.
     //
     // As we now removed lines from the top, extension is no longer necessary.
     m_bExtend = false;
   }
   //
+  // Lines remain in the register until the sub-band received all of them.
+  res = (m_ulLowPass < ((HeightOf() + 1) >> 1));
+  //
   // Move the lines up by two, make new room, insert old lines back into the bottom to
   // make them available as new buffers.
   for(i = 2;i < RegisterSize;i++) {
@@ -233,9 +295,11 @@ class Line *&Band::NewLine(LONG y)
   int pos = (y & 1) + RegisterSize - 2;;
   class Line *&line = m_pRegister[pos];
   //
-  // Is there one we can recycle?
-  if (line == NULL)
-    line = new Line(WidthOf());
+  // Is there one we can recycle? If not, take one of the spares.
+  if (line == NULL) {
+    assert(m_iSpare > 0);
+    line = m_pSpare[--m_iSpare];
+  }
   //
 #if CHECK_LEVEL > 0
   line->m_lY = y;
@@ -39,6 +39,9 @@
 
 /// Forwards
 class Line;
+class LineSlab;
+class LineSink;
+class BandArena;
 ///
 
 /// class Band
@@ -60,6 +63,20 @@ class Band {
   // The line shift register.
   class Line    *m_pRegister[RegisterSize];
   //
+  // The lines of the slab not in the register.
+  class Line    *m_pSpare[RegisterSize];
+  int            m_iSpare;
+  //
+  // The slab that provides the lines of the entire hierarchy.
+  class LineSlab *m_pSlab;
+  //
+  // The arena that provides the matrices of the entire hierarchy.
+  class BandArena *m_pArena;
+  //
+  // The sink receiving the lines of the hierarchy if it streams them,
+  // or NULL if the coefficients are kept in the matrix.
+  class LineSink *m_pSink;
+  //
   // The mirror-extended registers. Contains alternative
   // (mirrored) sources whenever the above contains NULL.
   class Line    *m_pMirrored[RegisterSize];
@@ -70,10 +87,11 @@ class Band {
   // Dimensions of the band.
   ULONG          m_ulWidth,m_ulHeight;
   //
-  // The coefficient matrix, if we need it.
+  // The coefficient matrix, if we need it. It is taken from the arena
+  // along with the first line unless the band streams its lines.
   Matrix<FLOAT>  m_Coefficients;
   //
-  // The subbands if we need it.
+  // The subbands if we need it, taken from the arena as well.
   Matrix<FLOAT>  m_HL;
   Matrix<FLOAT>  m_LH;
   Matrix<FLOAT>  m_HH;
@@ -84,6 +102,9 @@ class Band {
   // The output Y generated.
   ULONG          m_ulYO;
   //
+  // The number of low-pass lines pushed into the sub-band.
+  ULONG          m_ulLowPass;
+  //
   // Set in case empty lines are in the register that require
   // extension.
   bool           m_bExtend;
@@ -92,7 +113,8 @@ class Band {
   bool           m_bKeepHP;
   //
   // Advance the line shift register by two, push lines at the exit
-  // positions into the child bands, make room for new lines.
+  // positions into the child bands, make room for new lines. Returns
+  // true as long as the sub-band still expects lines.
   bool ShiftLineRegister(void);
   //
   // Accquire a new line for the indicated Y position, or recycle one.
@@ -110,7 +132,15 @@ class Band {
 public:
   //
   // Setup a band of the given dimensions and the given decomposition depth.
-  Band(ULONG width,ULONG height,UBYTE reslvl,bool keephp);
+  // The lines of the band and its sub-bands are taken from the slab.
+  Band(ULONG width,ULONG height,UBYTE reslvl,bool keephp,class LineSlab *slab);
+  //
+  // Return the number of lines each band with a sub-band takes from
+  // the slab.
+  static ULONG LinesPerBand(void)
+  {
+    return RegisterSize;
+  }
   //
   // Destroy this sub-band and the entire subband hierarchy.
   ~Band(void);
@@ -118,7 +148,23 @@ public:
   // Get the sub-band of this band or NULL in case there is none.
   class Band *SubBandOf(void);
   //
-  // Push a line for transformation into this band.
+  // Stream the lines of this band and all its sub-bands into the given
+  // sink instead of keeping them. This must be called before the first
+  // line is pushed.
+  void StreamTo(class LineSink *sink);
+  //
+  // Take the matrices of this band and all its sub-bands from the given
+  // arena. This must be called before the first line is pushed.
+  void UseArena(class BandArena *arena);
+  //
+  // Check whether the band streams its lines into a sink.
+  bool IsStreaming(void) const
+  {
+    return m_pSink != NULL;
+  }
+  //
+  // Push a line for transformation into this band. The pixels of
+  // the band are the first pixels of the line, the line may be longer.
   void PushLine(const class Line *data);
   //
   // Number of bands below this scale. For the topmost band, this
@@ -0,0 +1,194 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class provides the coefficient matrices of all bands of a band
+** hierarchy from a single block of memory, and keeps released arenas
+** for the next image of the same geometry.
+*/
+
+/// Includes
+#include "wavelet/bandarena.hpp"
+///
+
+/// Statics
+class BandArena *BandArena::m_pCache   = NULL;
+ULONG            BandArena::m_ulCached = 0;
+#ifndef NO_POSIX
+pthread_mutex_t  BandArena::m_Lock     = PTHREAD_MUTEX_INITIALIZER;
+#endif
+///
+
+/// BandArena::BandArena
+// Create an arena for a hierarchy with the given top dimensions and
+// number of resolution levels.
+BandArena::BandArena(ULONG width,ULONG height,UBYTE levels,bool keephp,bool stream)
+  : m_pNext(NULL), m_ulWidth(width), m_ulHeight(height), m_ucLevels(levels),
+    m_bKeepHP(keephp), m_bStream(stream), m_pMatrices(NULL)
+{
+  size_t size;
+  //
+  m_pMatrices = new Matrix<FLOAT>[(levels + 1) << 2];
+  //
+  // Size first, then allocate and carve.
+  size = Layout(false);
+  if (size > 0) {
+    if (size > size_t(ULONG(~0UL)))
+      Throw(OutOfRange,"BandArena::BandArena","image dimensions are too large");
+    m_Memory.Allocate(ULONG(size),1);
+    Layout(true);
+  }
+}
+///
+
+/// BandArena::~BandArena
+BandArena::~BandArena(void)
+{
+  delete[] m_pMatrices;
+}
+///
+
+/// BandArena::Layout
+// Run over the bands of the hierarchy and either sum up the memory the
+// matrices take, or carve them from the memory. This follows the
+// construction of the bands: the high-passes of a band have half its
+// size, rounded as the lifting steps split the samples, and the band
+// below keeps its high-passes if this band does, unless it is the
+// lowest.
+size_t BandArena::Layout(bool carve)
+{
+  ULONG w     = m_ulWidth;
+  ULONG h     = m_ulHeight;
+  bool keep   = m_bKeepHP;
+  UBYTE r     = m_ucLevels;
+  size_t size = 0;
+  //
+  do {
+    UBYTE o;
+    //
+    for(o = 0;o < 4;o++) {
+      ULONG bw,bh;
+      //
+      if (o == 0) {
+	if (keep || m_bStream)
+	  continue;
+	bw = w;
+	bh = h;
+      } else {
+	if (!keep)
+	  continue;
+	bw = (o == 2)?((w + 1) >> 1):(w >> 1);
+	bh = (o == 1)?((h + 1) >> 1):(h >> 1);
+      }
+      if (carve)
+	m_pMatrices[(r << 2) + o].Carve(m_Memory,size,bw,bh);
+      size += Matrix<FLOAT>::SizeOf(bw,bh);
+    }
+    //
+    if (r == 0)
+      break;
+    //
+    keep = (r == 1)?(false):(keep);
+    w    = ((w - 1) >> 1) + 1;
+    h    = ((h - 1) >> 1) + 1;
+    r--;
+  } while(true);
+  //
+  return size;
+}
+///
+
+/// BandArena::Acquire
+// Return an arena for a band hierarchy, from the cache if possible.
+class BandArena *BandArena::Acquire(ULONG width,ULONG height,UBYTE levels,bool keephp,bool stream)
+{
+  class BandArena *arena = NULL;
+  class BandArena **prev;
+  //
+#ifndef NO_POSIX
+  pthread_mutex_lock(&m_Lock);
+#endif
+  for(prev = &m_pCache;*prev;prev = &(*prev)->m_pNext) {
+    if ((*prev)->m_ulWidth == width && (*prev)->m_ulHeight == height &&
+	(*prev)->m_ucLevels == levels && (*prev)->m_bKeepHP == keephp &&
+	(*prev)->m_bStream == stream) {
+      arena  = *prev;
+      *prev  = arena->m_pNext;
+      m_ulCached--;
+      break;
+    }
+  }
+#ifndef NO_POSIX
+  pthread_mutex_unlock(&m_Lock);
+#endif
+  //
+  if (arena == NULL)
+    arena = new class BandArena(width,height,levels,keephp,stream);
+  //
+  arena->m_pNext = NULL;
+  return arena;
+}
+///
+
+/// BandArena::Recycle
+// Return an arena no longer used by its hierarchy to the cache.
+void BandArena::Recycle(class BandArena *arena)
+{
+  if (arena) {
+#ifndef NO_POSIX
+    pthread_mutex_lock(&m_Lock);
+#endif
+    if (m_ulCached < MaxCached) {
+      arena->m_pNext = m_pCache;
+      m_pCache       = arena;
+      m_ulCached++;
+      arena          = NULL;
+    }
+#ifndef NO_POSIX
+    pthread_mutex_unlock(&m_Lock);
+#endif
+    // The cache is full, drop the arena.
+    delete arena;
+  }
+}
+///
+
+/// BandArena::ReleaseCache
+// Release all cached arenas.
+void BandArena::ReleaseCache(void)
+{
+  class BandArena *arena;
+  //
+#ifndef NO_POSIX
+  pthread_mutex_lock(&m_Lock);
+#endif
+  while((arena = m_pCache)) {
+    m_pCache = arena->m_pNext;
+    delete arena;
+  }
+  m_ulCached = 0;
+#ifndef NO_POSIX
+  pthread_mutex_unlock(&m_Lock);
+#endif
+}
+///
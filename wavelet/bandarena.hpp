@@ -0,0 +1,128 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class provides the coefficient matrices of all bands of a band
+** hierarchy from a single block of memory, and keeps released arenas
+** for the next image of the same geometry.
+*/
+
+#ifndef WAVELET_BANDARENA_HPP
+#define WAVELET_BANDARENA_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/matrix.hpp"
+#include "std/assert.hpp"
+#ifndef NO_POSIX
+extern "C" {
+#include <pthread.h>
+}
+#endif
+///
+
+/// class BandArena
+// The matrices of all bands of one hierarchy, carved from one aligned
+// allocation. A band keeping its high-passes takes its three high-pass
+// matrices from here, all other bands their coefficient matrix unless
+// they stream their lines.
+//
+// As the slabs, arenas are not created and destroyed directly, but
+// acquired for a hierarchy and recycled once the hierarchy is gone,
+// such that a sequence of images of the same size, as the frames of
+// a video, allocates the coefficient memory only once.
+class BandArena {
+  //
+  // The next arena in the cache.
+  class BandArena *m_pNext;
+  //
+  // The dimensions of the topmost band, its resolution level and
+  // the mode of the hierarchy, i.e. the key of the arena in the cache.
+  ULONG            m_ulWidth;
+  ULONG            m_ulHeight;
+  UBYTE            m_ucLevels;
+  bool             m_bKeepHP;
+  bool             m_bStream;
+  //
+  // The memory of all matrices.
+  Matrix<FLOAT>    m_Memory;
+  //
+  // The matrices within, four per resolution level: the coefficients
+  // followed by the HL, LH and HH band. Matrices not required by the
+  // hierarchy remain empty.
+  Matrix<FLOAT>   *m_pMatrices;
+  //
+  // The cache of recycled arenas.
+  static class BandArena *m_pCache;
+  //
+  // The number of arenas in the cache.
+  static ULONG            m_ulCached;
+  //
+#ifndef NO_POSIX
+  // Protects the cache.
+  static pthread_mutex_t  m_Lock;
+#endif
+  //
+  // The maximum number of arenas kept in the cache.
+  enum {
+    MaxCached = 16
+  };
+  //
+  // Create an arena for a hierarchy with the given top dimensions and
+  // number of resolution levels.
+  BandArena(ULONG width,ULONG height,UBYTE levels,bool keephp,bool stream);
+  //
+  ~BandArena(void);
+  //
+  // Run over the bands of the hierarchy and either sum up the memory the
+  // matrices take, or carve them from the memory.
+  size_t Layout(bool carve);
+  //
+public:
+  //
+  // Return an arena for a band hierarchy whose top band has the given
+  // dimensions and resolution level. If keephp is set, the bands above
+  // the lowest keep their high-passes. If stream is set, the bands stream
+  // their lines and require no coefficient matrices. A cached arena is
+  // returned if available.
+  static class BandArena *Acquire(ULONG width,ULONG height,UBYTE levels,bool keephp,bool stream);
+  //
+  // Return an arena no longer used by its hierarchy to the cache.
+  static void Recycle(class BandArena *arena);
+  //
+  // Release all cached arenas.
+  static void ReleaseCache(void);
+  //
+  // Return the matrix of the band with the given resolution level and
+  // orientation, zero for the coefficients and one to three for the
+  // HL, LH and HH band.
+  Matrix<FLOAT> &MatrixOf(UBYTE level,UBYTE orientation)
+  {
+    assert(level <= m_ucLevels && orientation < 4);
+    return m_pMatrices[(level << 2) + orientation];
+  }
+};
+///
+
+///
+#endif
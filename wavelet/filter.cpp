@@ -30,34 +30,42 @@
 /// Includes
 #include "filter.hpp"
 #include "line.hpp"
+#include "liftkernels.hpp"
+#include "std/string.hpp"
 ///
 
 /// Filter::HLift
-// Perform the horizontal lifting steps on the given line.
+// Perform the horizontal lifting steps on the given line, which must
+// have been mirror-extended. The even and odd pixels, including the
+// boundary, are first split into two contiguous arrays, such that both
+// lifting steps run as vertical lifting kernels over them. The low-pass
+// result goes to the first half of the line, the high-pass result to
+// the second half.
 void Filter::HLift(class Line *line)
 {
-  WORD *p   = line->Origin();;
+  WORD *p   = line->Origin();
   ULONG len = line->LengthOf();
-  WORD *dp,*last;
   //
   // Special one-point case: Do not filter then.
   if (len > 1) {
+    const LiftKernels &kernels = LiftKernels::KernelsOf();
+    ULONG low  = line->LowPassLengthOf();
+    ULONG high = len - low;
+    // The even pixels from -3 to low + 2, the odd pixels from -3 to low + 1.
+    WORD *even = line->ScratchOf() + 3;
+    WORD *odd  = even + low + 2 + 1 + 3;
     //
-    // First the odd pixels.
-    dp   = p - 3;
-    last = p + len + 3;
-    do {
-      *dp += (dp[-3] - 9 * dp[-1] - 9 * dp[1] + dp[3]) >> 4;
-      dp  += 2;
-    } while(dp < last);
+    kernels.Split(p - 6,even - 3,odd - 3,low + 5);
+    even[low + 2] = p[(low + 2) << 1];
     //
-    // Then the even pixels.
-    dp   = p;
-    last = p + len;
-    do {
-      *dp += (-dp[-3] + 9 * dp[-1] + 9 * dp[1] - dp[3]) >> 5;
-      dp  += 2;
-    } while(dp < last);
+    // First the odd pixels, from -2 to low.
+    kernels.VLift1(even - 3,even - 2,odd - 2,even - 1,even,low + 3);
+    //
+    // Then the even pixels, from 0 to low - 1, directly in the target.
+    memcpy(p,even,low * sizeof(WORD));
+    kernels.VLift2(odd - 2,odd - 1,p,odd,odd + 1,low);
+    //
+    memcpy(p + low,odd,high * sizeof(WORD));
   }
 }
 ///
@@ -68,18 +76,11 @@ void Filter::VLift1(const class Line *top2,const class Line *top1,class Line *ta
 		    const class Line *bot1,const class Line *bot2)
 {  
   ULONG len       = target->LengthOf();
-  const WORD *t2  = top2->Origin();
-  const WORD *t1  = top1->Origin();
-  WORD *p         = target->Origin();
-  const WORD *b1  = bot1->Origin();
-  const WORD *b2  = bot2->Origin();
   
   assert(len == top2->LengthOf() && len == top1->LengthOf() && len == bot1->LengthOf() && len == bot2->LengthOf());
 
-  do {
-    *p += (*t2 - 9 * *t1 - 9 * *b1 + *b2) >> 4;
-    t2++,t1++,p++,b1++,b2++;
-  } while(--len);
+  LiftKernels::KernelsOf().VLift1(top2->Origin(),top1->Origin(),target->Origin(),
+				  bot1->Origin(),bot2->Origin(),len);
 }
 ///
 
@@ -89,17 +90,10 @@ void Filter::VLift2(const class Line *top2,const class Line *top1,class Line *ta
 		    const class Line *bot1,const class Line *bot2)
 {  
   ULONG len       = target->LengthOf();
-  const WORD *t2  = top2->Origin();
-  const WORD *t1  = top1->Origin();
-  WORD *p         = target->Origin();
-  const WORD *b1  = bot1->Origin();
-  const WORD *b2  = bot2->Origin();
   
   assert(len == top2->LengthOf() && len == top1->LengthOf() && len == bot1->LengthOf() && len == bot2->LengthOf());
 
-  do {
-    *p += (-*t2 + 9 * *t1 + 9 * *b1 - *b2) >> 5;
-    t2++,t1++,p++,b1++,b2++;
-  } while(--len);
+  LiftKernels::KernelsOf().VLift2(top2->Origin(),top1->Origin(),target->Origin(),
+				  bot1->Origin(),bot2->Origin(),len);
 }
 ///
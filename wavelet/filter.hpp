@@ -50,7 +50,8 @@ class Filter {
   //
 public:
   //
-  // Perform the horizontal lifting steps on the given line.
+  // Perform the horizontal lifting steps on the given line. Afterwards,
+  // the line holds the low-pass pixels followed by the high-pass pixels.
   static void HLift(class Line *line);
   //
   // Perform the first vertical lifting step on the given lines.
@@ -0,0 +1,364 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+/// Includes
+#include "wavelet/liftkernels.hpp"
+#ifdef USE_X86_SIMD
+#include <immintrin.h>
+#endif
+///
+
+/// Scalar kernels
+// These are the reference implementations. The vector kernels use them
+// for the samples that do not fill a complete vector, hence they start
+// at sample x.
+
+/// VLift1Range
+static void VLift1Range(const WORD *t2,const WORD *t1,WORD *p,
+			const WORD *b1,const WORD *b2,ULONG x,ULONG count)
+{
+  for(;x < count;x++)
+    p[x] += (t2[x] - 9 * t1[x] - 9 * b1[x] + b2[x]) >> 4;
+}
+///
+
+/// VLift2Range
+static void VLift2Range(const WORD *t2,const WORD *t1,WORD *p,
+			const WORD *b1,const WORD *b2,ULONG x,ULONG count)
+{
+  for(;x < count;x++)
+    p[x] += (-t2[x] + 9 * t1[x] + 9 * b1[x] - b2[x]) >> 5;
+}
+///
+
+/// SplitRange
+static void SplitRange(const WORD *src,WORD *even,WORD *odd,ULONG x,ULONG count)
+{
+  for(;x < count;x++) {
+    even[x] = src[x << 1];
+    odd[x]  = src[(x << 1) + 1];
+  }
+}
+///
+
+/// VLift1Scalar
+static void VLift1Scalar(const WORD *t2,const WORD *t1,WORD *p,
+			 const WORD *b1,const WORD *b2,ULONG count)
+{
+  VLift1Range(t2,t1,p,b1,b2,0,count);
+}
+///
+
+/// VLift2Scalar
+static void VLift2Scalar(const WORD *t2,const WORD *t1,WORD *p,
+			 const WORD *b1,const WORD *b2,ULONG count)
+{
+  VLift2Range(t2,t1,p,b1,b2,0,count);
+}
+///
+
+/// SplitScalar
+static void SplitScalar(const WORD *src,WORD *even,WORD *odd,ULONG count)
+{
+  SplitRange(src,even,odd,0,count);
+}
+///
+///
+
+#ifdef USE_X86_SIMD
+/// SSE4.2 kernels
+// The samples are sign-extended to 32 bits, and the update is computed
+// as in the scalar code, with 9 * x as (x << 3) + x. The low sixteen
+// bits of the update are then packed back and added to the target with
+// wrap-around, which is what the scalar code does.
+
+/// Half128
+// Compute the update of four samples, masked to the low sixteen bits.
+// The inner taps enter with a negative sign for the first step, and
+// the outer taps for the second.
+template<int shift,bool second>
+__attribute__((target("sse4.2")))
+static inline __m128i Half128(const WORD *t2,const WORD *t1,const WORD *b1,const WORD *b2)
+{
+  __m128i o2 = _mm_add_epi32(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)t2)),
+			     _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)b2)));
+  __m128i i1 = _mm_add_epi32(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)t1)),
+			     _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)b1)));
+  __m128i i9 = _mm_add_epi32(_mm_slli_epi32(i1,3),i1);
+  __m128i up = (second)?(_mm_sub_epi32(i9,o2)):(_mm_sub_epi32(o2,i9));
+
+  return _mm_and_si128(_mm_srai_epi32(up,shift),_mm_set1_epi32(0xffff));
+}
+///
+
+/// Update128
+// Compute the update of eight samples.
+template<int shift,bool second>
+__attribute__((target("sse4.2")))
+static inline __m128i Update128(const WORD *t2,const WORD *t1,const WORD *b1,const WORD *b2)
+{
+  return _mm_packus_epi32(Half128<shift,second>(t2    ,t1    ,b1    ,b2    ),
+			  Half128<shift,second>(t2 + 4,t1 + 4,b1 + 4,b2 + 4));
+}
+///
+
+/// VLift1SSE42
+__attribute__((target("sse4.2")))
+static void VLift1SSE42(const WORD *t2,const WORD *t1,WORD *p,
+			const WORD *b1,const WORD *b2,ULONG count)
+{
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m128i up = Update128<4,false>(t2 + x,t1 + x,b1 + x,b2 + x);
+    _mm_storeu_si128((__m128i *)(p + x),_mm_add_epi16(_mm_loadu_si128((const __m128i *)(p + x)),up));
+  }
+  VLift1Range(t2,t1,p,b1,b2,x,count);
+}
+///
+
+/// VLift2SSE42
+__attribute__((target("sse4.2")))
+static void VLift2SSE42(const WORD *t2,const WORD *t1,WORD *p,
+			const WORD *b1,const WORD *b2,ULONG count)
+{
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m128i up = Update128<5,true>(t2 + x,t1 + x,b1 + x,b2 + x);
+    _mm_storeu_si128((__m128i *)(p + x),_mm_add_epi16(_mm_loadu_si128((const __m128i *)(p + x)),up));
+  }
+  VLift2Range(t2,t1,p,b1,b2,x,count);
+}
+///
+
+/// SplitSSE42
+// The even pixels are the low halves of 32-bit lanes, the odd pixels the
+// high halves, both are packed without saturation as they are masked.
+__attribute__((target("sse4.2")))
+static void SplitSSE42(const WORD *src,WORD *even,WORD *odd,ULONG count)
+{
+  const __m128i mask = _mm_set1_epi32(0xffff);
+  ULONG x;
+
+  for(x = 0;x + 8 <= count;x += 8) {
+    __m128i v0 = _mm_loadu_si128((const __m128i *)(src + (x << 1)    ));
+    __m128i v1 = _mm_loadu_si128((const __m128i *)(src + (x << 1) + 8));
+    _mm_storeu_si128((__m128i *)(even + x),_mm_packus_epi32(_mm_and_si128(v0,mask),_mm_and_si128(v1,mask)));
+    _mm_storeu_si128((__m128i *)(odd  + x),_mm_packus_epi32(_mm_srli_epi32(v0,16),_mm_srli_epi32(v1,16)));
+  }
+  SplitRange(src,even,odd,x,count);
+}
+///
+///
+
+/// AVX2 kernels
+// As above, with sixteen samples per iteration. The pack instruction
+// works within 128-bit lanes, hence the result is permuted back into
+// sample order.
+
+/// Half256
+template<int shift,bool second>
+__attribute__((target("avx2")))
+static inline __m256i Half256(const WORD *t2,const WORD *t1,const WORD *b1,const WORD *b2)
+{
+  __m256i o2 = _mm256_add_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)t2)),
+				_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)b2)));
+  __m256i i1 = _mm256_add_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)t1)),
+				_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)b1)));
+  __m256i i9 = _mm256_add_epi32(_mm256_slli_epi32(i1,3),i1);
+  __m256i up = (second)?(_mm256_sub_epi32(i9,o2)):(_mm256_sub_epi32(o2,i9));
+
+  return _mm256_and_si256(_mm256_srai_epi32(up,shift),_mm256_set1_epi32(0xffff));
+}
+///
+
+/// Update256
+template<int shift,bool second>
+__attribute__((target("avx2")))
+static inline __m256i Update256(const WORD *t2,const WORD *t1,const WORD *b1,const WORD *b2)
+{
+  __m256i packed = _mm256_packus_epi32(Half256<shift,second>(t2    ,t1    ,b1    ,b2    ),
+				       Half256<shift,second>(t2 + 8,t1 + 8,b1 + 8,b2 + 8));
+
+  return _mm256_permute4x64_epi64(packed,_MM_SHUFFLE(3,1,2,0));
+}
+///
+
+/// VLift1AVX2
+__attribute__((target("avx2")))
+static void VLift1AVX2(const WORD *t2,const WORD *t1,WORD *p,
+		       const WORD *b1,const WORD *b2,ULONG count)
+{
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m256i up = Update256<4,false>(t2 + x,t1 + x,b1 + x,b2 + x);
+    _mm256_storeu_si256((__m256i *)(p + x),_mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(p + x)),up));
+  }
+  VLift1Range(t2,t1,p,b1,b2,x,count);
+}
+///
+
+/// VLift2AVX2
+__attribute__((target("avx2")))
+static void VLift2AVX2(const WORD *t2,const WORD *t1,WORD *p,
+		       const WORD *b1,const WORD *b2,ULONG count)
+{
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m256i up = Update256<5,true>(t2 + x,t1 + x,b1 + x,b2 + x);
+    _mm256_storeu_si256((__m256i *)(p + x),_mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(p + x)),up));
+  }
+  VLift2Range(t2,t1,p,b1,b2,x,count);
+}
+///
+
+/// SplitAVX2
+__attribute__((target("avx2")))
+static void SplitAVX2(const WORD *src,WORD *even,WORD *odd,ULONG count)
+{
+  const __m256i mask = _mm256_set1_epi32(0xffff);
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m256i v0 = _mm256_loadu_si256((const __m256i *)(src + (x << 1)     ));
+    __m256i v1 = _mm256_loadu_si256((const __m256i *)(src + (x << 1) + 16));
+    __m256i e  = _mm256_packus_epi32(_mm256_and_si256(v0,mask),_mm256_and_si256(v1,mask));
+    __m256i o  = _mm256_packus_epi32(_mm256_srli_epi32(v0,16),_mm256_srli_epi32(v1,16));
+    _mm256_storeu_si256((__m256i *)(even + x),_mm256_permute4x64_epi64(e,_MM_SHUFFLE(3,1,2,0)));
+    _mm256_storeu_si256((__m256i *)(odd  + x),_mm256_permute4x64_epi64(o,_MM_SHUFFLE(3,1,2,0)));
+  }
+  SplitRange(src,even,odd,x,count);
+}
+///
+///
+
+/// AVX-512 kernels
+// AVX-512 provides a truncating down-conversion from 32 to 16 bits,
+// hence sixteen samples are widened into one vector and narrowed again
+// without any masking or permutation.
+
+/// Update512
+template<int shift,bool second>
+__attribute__((target("avx512f")))
+static inline __m256i Update512(const WORD *t2,const WORD *t1,const WORD *b1,const WORD *b2)
+{
+  __m512i o2 = _mm512_add_epi32(_mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *)t2)),
+				_mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *)b2)));
+  __m512i i1 = _mm512_add_epi32(_mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *)t1)),
+				_mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *)b1)));
+  __m512i i9 = _mm512_add_epi32(_mm512_slli_epi32(i1,3),i1);
+  __m512i up = (second)?(_mm512_sub_epi32(i9,o2)):(_mm512_sub_epi32(o2,i9));
+
+  return _mm512_cvtepi32_epi16(_mm512_srai_epi32(up,shift));
+}
+///
+
+/// VLift1AVX512
+__attribute__((target("avx512f")))
+static void VLift1AVX512(const WORD *t2,const WORD *t1,WORD *p,
+			 const WORD *b1,const WORD *b2,ULONG count)
+{
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m256i up = Update512<4,false>(t2 + x,t1 + x,b1 + x,b2 + x);
+    _mm256_storeu_si256((__m256i *)(p + x),_mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(p + x)),up));
+  }
+  VLift1Range(t2,t1,p,b1,b2,x,count);
+}
+///
+
+/// VLift2AVX512
+__attribute__((target("avx512f")))
+static void VLift2AVX512(const WORD *t2,const WORD *t1,WORD *p,
+			 const WORD *b1,const WORD *b2,ULONG count)
+{
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m256i up = Update512<5,true>(t2 + x,t1 + x,b1 + x,b2 + x);
+    _mm256_storeu_si256((__m256i *)(p + x),_mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(p + x)),up));
+  }
+  VLift2Range(t2,t1,p,b1,b2,x,count);
+}
+///
+
+/// SplitAVX512
+__attribute__((target("avx512f")))
+static void SplitAVX512(const WORD *src,WORD *even,WORD *odd,ULONG count)
+{
+  ULONG x;
+
+  for(x = 0;x + 16 <= count;x += 16) {
+    __m512i v = _mm512_loadu_si512((const void *)(src + (x << 1)));
+    _mm256_storeu_si256((__m256i *)(even + x),_mm512_cvtepi32_epi16(v));
+    _mm256_storeu_si256((__m256i *)(odd  + x),_mm512_cvtepi32_epi16(_mm512_srli_epi32(v,16)));
+  }
+  SplitRange(src,even,odd,x,count);
+}
+///
+///
+#endif
+
+/// Kernel tables
+static const LiftKernels ScalarKernels = {
+  &VLift1Scalar,&VLift2Scalar,&SplitScalar
+};
+#ifdef USE_X86_SIMD
+static const LiftKernels SSE42Kernels = {
+  &VLift1SSE42,&VLift2SSE42,&SplitSSE42
+};
+static const LiftKernels AVX2Kernels = {
+  &VLift1AVX2,&VLift2AVX2,&SplitAVX2
+};
+static const LiftKernels AVX512Kernels = {
+  &VLift1AVX512,&VLift2AVX512,&SplitAVX512
+};
+#endif
+///
+
+/// LiftKernels::KernelsOf
+// Return the kernels for the given extension.
+const LiftKernels &LiftKernels::KernelsOf(CPU::Extension ext)
+{
+#ifdef USE_X86_SIMD
+  switch(ext) {
+  case CPU::AVX512:
+    return AVX512Kernels;
+  case CPU::AVX2:
+    return AVX2Kernels;
+  case CPU::SSE42:
+    return SSE42Kernels;
+  case CPU::Scalar:
+    break;
+  }
+#else
+  (void)ext;
+#endif
+  return ScalarKernels;
+}
+///
@@ -0,0 +1,75 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+
+#ifndef WAVELET_LIFTKERNELS_HPP
+#define WAVELET_LIFTKERNELS_HPP
+
+/// Includes
+#include "global/types.hpp"
+#include "global/cpu.hpp"
+///
+
+/// class LiftKernels
+// This class collects the inner loops of the lifting steps of the 13/7
+// filter. The horizontal lifting splits the line into even and odd
+// pixels and runs the vertical kernels over them. Each kernel exists as scalar reference code, and as SSE4.2,
+// AVX2 and AVX-512 implementation, picked at run time for the widest
+// extension the CPU provides.
+//
+// The scalar code computes the lifting update in integer precision and
+// truncates it to a WORD when adding it to the target. Sixteen bits are
+// not sufficient for the intermediate sum of sixteen bit images, hence
+// the vector kernels widen the samples to 32 bit lanes and truncate the
+// update the same way. All implementations are bit-exact.
+class LiftKernels {
+public:
+  //
+  // Perform a vertical lifting step on count samples, i.e.
+  // p[x] += (t2[x] - 9 * t1[x] - 9 * b1[x] + b2[x]) >> 4 for the first
+  // and p[x] += (-t2[x] + 9 * t1[x] + 9 * b1[x] - b2[x]) >> 5 for the
+  // second step.
+  typedef void (*VLiftFunc)(const WORD *t2,const WORD *t1,WORD *p,
+			    const WORD *b1,const WORD *b2,ULONG count);
+  //
+  // Split count pairs of pixels into the even pixels and the odd pixels.
+  typedef void (*SplitFunc)(const WORD *src,WORD *even,WORD *odd,ULONG count);
+  //
+  VLiftFunc VLift1;
+  VLiftFunc VLift2;
+  SplitFunc Split;
+  //
+  // Return the kernels for the given extension. If the extension is not
+  // supported by this build, the next narrower one is returned.
+  static const LiftKernels &KernelsOf(CPU::Extension ext);
+  //
+  // Return the kernels for the widest extension available.
+  static const LiftKernels &KernelsOf(void)
+  {
+    return KernelsOf(CPU::ExtensionOf());
+  }
+};
+///
+
+///
+#endif
@@ -30,6 +30,7 @@
 /// Includes
 #include "global/types.hpp"
 #include "std/assert.hpp"
+#include "std/string.hpp"
 #include "line.hpp"
 ///
 
@@ -55,65 +56,28 @@ void Line::MirrorExtend(void)
 }
 ///
 
-/// Line::Deinterleave
-// Extract the even/odd pixels from the line and copy them to the targets.
-// Both must be allocated already.
-void Line::Deinterleave(WORD *ep,WORD *op) const
-{
-  const WORD *sp  = Origin();
-  ULONG len       = LengthOf();
-
-  while(len) {
-    *ep++ = *sp++;
-    if (--len == 0)
-      break;
-    *op++ = *sp++;
-    --len;
-  }
-}
-///
-
-/// Line::Deinterleave
-// Deinterleave the even or odd part of the line into the buffer.
-void Line::Deinterleave(WORD *target,bool odd) const
+/// Line::Store
+// Store count pixels of the line, starting at the given offset, into
+// the buffer.
+void Line::Store(WORD *target,ULONG first,ULONG count) const
 {
-  const WORD *sp = Origin();
-  ULONG len      = LengthOf();
-
-  if (odd) {
-    sp++;
-    len--;
-  }
-
-  len = (len + 1) >> 1;
+  assert(first + count <= LengthOf());
 
-  while(len) {
-    *target++ = *sp++;
-    sp++;
-    len--;
-  }
+  memcpy(target,Origin() + first,count * sizeof(WORD));
 }
 ///
 
-/// Line::Deinterleave
-// Deinterleave the even or odd part of the line into the buffer.
-void Line::Deinterleave(FLOAT *target,bool odd) const
+/// Line::Store
+// The same, converting to floating point.
+void Line::Store(FLOAT *target,ULONG first,ULONG count) const
 {
-  const WORD *sp = Origin();
-  ULONG len      = LengthOf();
+  const WORD *sp = Origin() + first;
+  ULONG i;
 
-  if (odd) {
-    sp++;
-    len--;
-  }
+  assert(first + count <= LengthOf());
 
-  len = (len + 1) >> 1;
-
-  while(len) {
-    *target++ = *sp++;
-    sp++;
-    len--;
-  }
+  for(i = 0;i < count;i++)
+    target[i] = sp[i];
 }
 ///
 
@@ -53,16 +53,53 @@ class Line {
   // The nominal number of pixels, not inluding the boundary of the line.
   ULONG m_ulSize;
   //
+  // Scratch memory for the horizontal lifting, allocated on first use.
+  WORD *m_pScratch;
+  //
+  // Set if the line allocated its memory itself.
+  bool  m_bOwner;
+  //
+  // Lines in external storage place their first nominal pixel at this
+  // offset, and their scratch memory at a multiple of it.
+  enum {
+    Alignment = 32 // in WORDs, i.e. 64 bytes
+  };
+  //
+  // Round a number of WORDs up to the alignment.
+  static ULONG Align(ULONG words)
+  {
+    return (words + Alignment - 1) & ~ULONG(Alignment - 1);
+  }
   //
 public:
   // Create a new line of the given nominal size.
   Line(ULONG length)
-    : m_pData(new WORD[length + Support * 2]), m_pOrigin(m_pData + Support), m_ulSize(length)
+    : m_pData(new WORD[length + Support * 2]), m_pOrigin(m_pData + Support), m_ulSize(length),
+      m_pScratch(NULL), m_bOwner(true)
+  { }
+  //
+  // Create a line of the given nominal size in external storage of
+  // StorageOf(length) WORDs, aligned to 64 bytes. The first nominal
+  // pixel is then aligned as well. The storage is not released by
+  // the line.
+  Line(ULONG length,WORD *storage)
+    : m_pData(storage + Alignment - Support), m_pOrigin(storage + Alignment), m_ulSize(length),
+      m_pScratch(storage + Align(Alignment + length + Support)), m_bOwner(false)
   { }
   //
   ~Line()
   {
-    delete[] m_pData;
+    if (m_bOwner) {
+      delete[] m_pData;
+      delete[] m_pScratch;
+    }
+  }
+  //
+  // Return the number of WORDs of external storage a line of the given
+  // length requires, including its boundary and scratch memory.
+  static ULONG StorageOf(ULONG length)
+  {
+    return Align(Alignment + length + Support) + Align(length + Support * 4);
   }
   //
   // Get the first nominal pixel of the line.
@@ -90,18 +127,32 @@ public:
     return m_ulSize;
   }
   //
+  // After the horizontal lifting, the line holds the low-pass pixels
+  // first, followed by the high-pass pixels. Return the number of
+  // low-pass pixels.
+  ULONG LowPassLengthOf(void) const
+  {
+    return (m_ulSize + 1) >> 1;
+  }
+  //
+  // Return scratch memory for the lifting, large enough to hold the
+  // line including twice its boundary.
+  WORD *ScratchOf(void)
+  {
+    if (m_pScratch == NULL)
+      m_pScratch = new WORD[m_ulSize + Support * 4];
+    return m_pScratch;
+  }
+  //
   // Mirror-extend the line into the boundary region.
   void MirrorExtend(void);
   //
-  // Extract the even/odd pixels from the line and copy them to the targets.
-  // Both must be allocated already.
-  void Deinterleave(WORD *even,WORD *odd) const;
-  //
-  // Deinterleave the even or odd part of the line into the buffer.
-  void Deinterleave(WORD *target,bool odd) const;
+  // Store count pixels of the line, starting at the given offset, into
+  // the buffer.
+  void Store(WORD *target,ULONG first,ULONG count) const;
   //
-  // Deinterleave the even or odd part of the line into the buffer.
-  void Deinterleave(FLOAT *target,bool odd) const;
+  // The same, converting to floating point.
+  void Store(FLOAT *target,ULONG first,ULONG count) const;
   //
   // Store the line unmodified into the buffer
   void Store(FLOAT *target) const;
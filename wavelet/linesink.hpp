@@ -0,0 +1,60 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class receives the lines of a band hierarchy as soon as the
+** bands produce them, instead of keeping them in the coefficient
+** matrices of the bands.
+*/
+
+#ifndef WAVELET_LINESINK_HPP
+#define WAVELET_LINESINK_HPP
+
+/// Includes
+#include "global/types.hpp"
+///
+
+/// Forwards
+class Line;
+///
+
+/// class LineSink
+// A line sink is attached to a band hierarchy that streams its
+// coefficients. Each band then hands its lines, in top to bottom
+// order, to the sink instead of storing them. The lines are only
+// valid during the call, and a hierarchy calls its sink from a single
+// thread at a time.
+class LineSink {
+  //
+public:
+  virtual ~LineSink(void);
+  //
+  // Receive the line y of the band with the given resolution level, i.e.
+  // the number of decompositions below it. The samples of the band are
+  // the first width pixels of the line.
+  virtual void ReceiveLine(UBYTE resolution,ULONG y,const class Line *line,ULONG width) = 0;
+};
+///
+
+///
+#endif
@@ -0,0 +1,170 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class provides the lines of the shift registers of a band
+** hierarchy from a single slab of memory, and keeps released slabs
+** for the next image of the same size.
+*/
+
+/// Includes
+#include "wavelet/lineslab.hpp"
+#include "wavelet/line.hpp"
+#include "std/assert.hpp"
+///
+
+/// Statics
+class LineSlab *LineSlab::m_pCache   = NULL;
+ULONG           LineSlab::m_ulCached = 0;
+#ifndef NO_POSIX
+pthread_mutex_t LineSlab::m_Lock     = PTHREAD_MUTEX_INITIALIZER;
+#endif
+///
+
+/// LineSlab::LineSlab
+// Create a slab for a hierarchy with the given top width and number of
+// resolution levels. The band of resolution r has the width of the
+// band above, halved and rounded up.
+LineSlab::LineSlab(ULONG width,UBYTE levels,ULONG linesperband)
+  : m_pNext(NULL), m_ulWidth(width), m_ucLevels(levels), m_ulLinesPerBand(linesperband),
+    m_pucMemory(NULL), m_ppLines(NULL)
+{
+  ULONG words = 0;
+  ULONG w     = width;
+  ULONG i,n   = 0;
+  UBYTE r;
+  WORD *storage;
+  //
+  for(r = levels;r > 0;r--) {
+    words += linesperband * Line::StorageOf(w);
+    w      = ((w - 1) >> 1) + 1;
+  }
+  //
+  m_ppLines   = new class Line *[levels * linesperband];
+  for(i = 0;i < ULONG(levels * linesperband);i++)
+    m_ppLines[i] = NULL;
+  //
+  // Align the storage to 64 bytes.
+  m_pucMemory = new UBYTE[words * sizeof(WORD) + 64];
+  storage     = (WORD *)(m_pucMemory + ((64 - (ULONG(size_t(m_pucMemory)) & 63)) & 63));
+  //
+  // The topmost band is at resolution level "levels".
+  w = width;
+  for(r = levels;r > 0;r--) {
+    for(i = 0;i < linesperband;i++) {
+      m_ppLines[(r - 1) * linesperband + i] = new class Line(w,storage);
+      storage += Line::StorageOf(w);
+      n++;
+    }
+    w = ((w - 1) >> 1) + 1;
+  }
+  assert(n == ULONG(levels * linesperband));
+}
+///
+
+/// LineSlab::~LineSlab
+LineSlab::~LineSlab(void)
+{
+  if (m_ppLines) {
+    ULONG i;
+    for(i = 0;i < ULONG(m_ucLevels * m_ulLinesPerBand);i++)
+      delete m_ppLines[i];
+    delete[] m_ppLines;
+  }
+  delete[] m_pucMemory;
+}
+///
+
+/// LineSlab::Acquire
+// Return a slab for a band hierarchy, from the cache if possible.
+class LineSlab *LineSlab::Acquire(ULONG width,UBYTE levels,ULONG linesperband)
+{
+  class LineSlab *slab = NULL;
+  class LineSlab **prev;
+  //
+#ifndef NO_POSIX
+  pthread_mutex_lock(&m_Lock);
+#endif
+  for(prev = &m_pCache;*prev;prev = &(*prev)->m_pNext) {
+    if ((*prev)->m_ulWidth == width && (*prev)->m_ucLevels == levels &&
+	(*prev)->m_ulLinesPerBand == linesperband) {
+      slab   = *prev;
+      *prev  = slab->m_pNext;
+      m_ulCached--;
+      break;
+    }
+  }
+#ifndef NO_POSIX
+  pthread_mutex_unlock(&m_Lock);
+#endif
+  //
+  if (slab == NULL)
+    slab = new class LineSlab(width,levels,linesperband);
+  //
+  slab->m_pNext = NULL;
+  return slab;
+}
+///
+
+/// LineSlab::Recycle
+// Return a slab no longer used by its hierarchy to the cache.
+void LineSlab::Recycle(class LineSlab *slab)
+{
+  if (slab) {
+#ifndef NO_POSIX
+    pthread_mutex_lock(&m_Lock);
+#endif
+    if (m_ulCached < MaxCached) {
+      slab->m_pNext = m_pCache;
+      m_pCache      = slab;
+      m_ulCached++;
+      slab          = NULL;
+    }
+#ifndef NO_POSIX
+    pthread_mutex_unlock(&m_Lock);
+#endif
+    // The cache is full, drop the slab.
+    delete slab;
+  }
+}
+///
+
+/// LineSlab::ReleaseCache
+// Release all cached slabs.
+void LineSlab::ReleaseCache(void)
+{
+  class LineSlab *slab;
+  //
+#ifndef NO_POSIX
+  pthread_mutex_lock(&m_Lock);
+#endif
+  while((slab = m_pCache)) {
+    m_pCache = slab->m_pNext;
+    delete slab;
+  }
+  m_ulCached = 0;
+#ifndef NO_POSIX
+  pthread_mutex_unlock(&m_Lock);
+#endif
+}
+///
@@ -0,0 +1,118 @@
+/************************************************************************************
+ **  Copyright (C) 2005-2007 TU Berlin, Felix Oum, Thomas Richter                  **
+ **                                                                                **
+ **  This software is provided 'as-is', without any express or implied             **
+ **  warranty.  In no event will the authors be held liable for any damages        **
+ **  arising from the use of this software.                                        **
+ **                                                                                **
+ **  Permission is granted to anyone to use this software for any purpose,         **
+ **  including commercial applications, and to alter it and redistribute it        **
+ **  freely, subject to the following restrictions:                                **
+ **                                                                                **
+ **  1. The origin of this software must not be misrepresented; you must not       **
+ **     claim that you wrote the original software. If you use this software       **
+ **     in a product, an acknowledgment in the product documentation would be      **
+ **     appreciated but is not required.                                           **
+ **  2. Altered source versions must be plainly marked as such, and must not be    **
+ **     misrepresented as being the original software.                             **
+ **  3. This notice may not be removed or altered from any source distribution.    **
+ **                                                                                **
+ **	Felix Oum		Thomas Richter                                     **
+ **				thor@math.tu-berlin.de                             **
+ **                                                                                **
+ ************************************************************************************/
+/*
+** This class provides the lines of the shift registers of a band
+** hierarchy from a single slab of memory, and keeps released slabs
+** for the next image of the same size.
+*/
+
+#ifndef WAVELET_LINESLAB_HPP
+#define WAVELET_LINESLAB_HPP
+
+/// Includes
+#include "global/types.hpp"
+#ifndef NO_POSIX
+extern "C" {
+#include <pthread.h>
+}
+#endif
+///
+
+/// Forwards
+class Line;
+///
+
+/// class LineSlab
+// The lines of all bands of one hierarchy, carved from one aligned
+// allocation. Each band with a sub-band owns a fixed number of lines
+// of its width, the size of its shift register.
+//
+// Slabs are not created and destroyed directly, but acquired for a
+// hierarchy and recycled once the hierarchy is gone. Recycled slabs
+// are kept in a process wide cache, such that comparing many images
+// of the same size allocates the line memory only once.
+class LineSlab {
+  //
+  // The next slab in the cache.
+  class LineSlab  *m_pNext;
+  //
+  // The width of the topmost band and the number of its resolution
+  // levels, i.e. the key of the slab in the cache.
+  ULONG            m_ulWidth;
+  UBYTE            m_ucLevels;
+  //
+  // The number of lines per band.
+  ULONG            m_ulLinesPerBand;
+  //
+  // The allocated memory, and the lines within. The lines of the band
+  // with resolution r start at (r - 1) * m_ulLinesPerBand.
+  UBYTE           *m_pucMemory;
+  class Line     **m_ppLines;
+  //
+  // The cache of recycled slabs.
+  static class LineSlab *m_pCache;
+  //
+  // The number of slabs in the cache.
+  static ULONG           m_ulCached;
+  //
+#ifndef NO_POSIX
+  // Protects the cache.
+  static pthread_mutex_t m_Lock;
+#endif
+  //
+  // The maximum number of slabs kept in the cache.
+  enum {
+    MaxCached = 64
+  };
+  //
+  // Create a slab for a hierarchy with the given top width and number of
+  // resolution levels.
+  LineSlab(ULONG width,UBYTE levels,ULONG linesperband);
+  //
+  ~LineSlab(void);
+  //
+public:
+  //
+  // Return a slab for a band hierarchy whose top band has the given width
+  // and resolution level, and whose bands use linesperband lines. A cached
+  // slab is returned if available.
+  static class LineSlab *Acquire(ULONG width,UBYTE levels,ULONG linesperband);
+  //
+  // Return a slab no longer used by its hierarchy to the cache.
+  static void Recycle(class LineSlab *slab);
+  //
+  // Release all cached slabs.
+  static void ReleaseCache(void);
+  //
+  // Return the lines of the band with the given resolution level, which
+  // must be at least one.
+  class Line *const *LinesOf(UBYTE level) const
+  {
+    return m_ppLines + (level - 1) * m_ulLinesPerBand;
+  }
+};
+///
+
+///
+#endif